@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <stdexcept>
 #include <cstdint>
 
@@ -10,24 +11,50 @@ extern "C" {
 #include <libavutil/channel_layout.h>
 }
 
+#include "FrameAllocator.h"
+
 namespace MediaEncoder
 {
+    // Audio samples backed by reference-counted AVBufferRefs. Copies share
+    // the sample buffers; FillFrame(), ClearFrame() and MakeWritable()
+    // detach a shared frame before writing (copy-on-write). Sample memory
+    // comes from the frame's FrameAllocator (FrameAllocator::Default()
+    // unless one is given).
     class AudioFrame
     {
     private:
         AVFrame* m_avFrame;
         bool m_disposed;
         int m_channels;
+        std::shared_ptr<FrameAllocator> m_allocator;
 
         void CheckIfDisposed() const;
+        void Release() noexcept;
+
+        explicit AudioFrame(const AVFrame* source);
 
     public:
-        AudioFrame(int sampleRate, int channels, AVSampleFormat sampleFormat, int samples);
+        AudioFrame(int sampleRate, int channels, AVSampleFormat sampleFormat, int samples,
+                   std::shared_ptr<FrameAllocator> allocator = nullptr);
+        AudioFrame(const AudioFrame& other);
+        AudioFrame(AudioFrame&& other) noexcept;
+        AudioFrame& operator=(const AudioFrame& other);
+        AudioFrame& operator=(AudioFrame&& other) noexcept;
         ~AudioFrame();
 
+        // References the buffers of an existing frame without copying;
+        // frames without AVBufferRefs are copied once.
+        static std::shared_ptr<AudioFrame> Wrap(const AVFrame* frame);
+
+        // src holds interleaved samples, or the planes back to back for
+        // planar formats.
         void FillFrame(const uint8_t* src);
         void ClearFrame();
 
+        // Ensures the sample buffers are not shared, copying them if needed.
+        void MakeWritable();
+        bool IsWritable() const;
+
         int SampleRate() const;
         int Channels() const;
         int Samples() const;
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+#include "AudioFrame.h"
+#include "Resampler.h"
+
+namespace MediaEncoder {
+
+class MediaWriter;
+
+struct AudioMixerSourceStats {
+    std::string name;
+    float gain = 1.0f;
+    size_t bufferedSamples = 0;
+    uint64_t silenceSamples = 0;    // mixed as silence because the source was late
+    uint64_t droppedSamples = 0;    // late data discarded to stay aligned
+};
+
+// Mixes any number of sources into one FLTP stream of encoder-sized frames.
+//
+// Each source has its own rate, channel count and sample format and is
+// converted on Push() through a cached Resampler into per-channel FIFOs. A
+// frame is mixed once every source has a frame's worth of samples, or once
+// any source is more than the latency limit ahead: late sources then
+// contribute what they have plus silence. When a late source catches up,
+// as many of its samples as were replaced by silence (at most the latency
+// limit) are discarded so it stays aligned with the rest; a source that
+// has not delivered anything yet simply joins the mix when it starts.
+// Summing (with per-source gain) and clipping to [-1, 1] use SSE or NEON
+// where available.
+//
+// Push() may be called from one thread per source; ReadFrame()/Pump() from
+// one consumer thread.
+class AudioMixer {
+public:
+    AudioMixer(int sampleRate, int channels, int frameSize);
+
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+
+    // Returns the source id used by Push/SetGain/RemoveSource.
+    int AddSource(const std::string& name, int sampleRate, int channels, AVSampleFormat format, float gain = 1.0f);
+    void RemoveSource(int source);
+    void SetGain(int source, float gain);
+
+    // How far (in ms) a source may run ahead before late sources are filled with silence. Default 100.
+    void SetMaxLatency(int milliseconds);
+
+    // data holds one pointer per plane (one for packed formats).
+    void Push(int source, const uint8_t* const* data, int samples);
+
+    // Mixes the next frame if it is due, or unconditionally when force is set
+    // (e.g. on a wall-clock tick or at the end of the stream, padding with
+    // silence). Returns nullptr when nothing was mixed. The frame is reused by
+    // the next call; copy-on-write keeps references taken by an encoder intact.
+    AudioFrame* ReadFrame(bool force = false);
+
+    // Encodes every due frame into the writer; with flush, also the remainder.
+    size_t Pump(MediaWriter& writer, bool flush = false);
+
+    int SampleRate() const { return m_sampleRate; }
+    int Channels() const { return m_channels; }
+    int FrameSize() const { return m_frameSize; }
+    std::vector<AudioMixerSourceStats> Stats() const;
+
+private:
+    struct Source {
+        std::string name;
+        float gain;
+        bool active = true;
+        bool started = false;                   // has delivered samples
+        bool planar = false;                    // direct FLTP input
+        int channels;
+        std::unique_ptr<Resampler> resampler;   // null when input is already FLT at the mix rate
+        std::mutex convertMutex;                // serializes Push() per source
+
+        // Guarded by the mixer mutex.
+        std::vector<std::vector<float>> fifo;   // per output channel
+        size_t head = 0;
+        uint64_t deficit = 0;
+        uint64_t silenceSamples = 0;
+        uint64_t droppedSamples = 0;
+
+        size_t Buffered() const { return fifo.empty() ? 0 : fifo[0].size() - head; }
+    };
+
+    Source& GetSource(int source) const;
+
+    const int m_sampleRate;
+    const int m_channels;
+    const int m_frameSize;
+    size_t m_maxLeadSamples;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Source>> m_sources;
+    AudioFrame m_output;
+    int64_t m_pts = 0;
+};
+
+} // namespace MediaEncoder
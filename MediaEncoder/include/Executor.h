@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Placement.h"
+
+namespace MediaEncoder {
+
+class Executor;
+
+// A serial task queue on an Executor. Tasks posted to one client run one at
+// a time in FIFO order, on whichever worker picks them up, so a writer,
+// scaler or resampler attached to a client never runs concurrently with itself.
+class ExecutorClient : public std::enable_shared_from_this<ExecutorClient> {
+public:
+    void Post(std::function<void()> task);
+
+    const std::string& Name() const { return m_name; }
+    size_t QueueDepth() const;
+    uint64_t TasksRun() const { return m_tasksRun.load(std::memory_order_relaxed); }
+    uint64_t Steals() const { return m_steals.load(std::memory_order_relaxed); }
+
+    ExecutorClient(Executor& executor, std::string name);
+    ExecutorClient(const ExecutorClient&) = delete;
+    ExecutorClient& operator=(const ExecutorClient&) = delete;
+
+private:
+    friend class Executor;
+
+    void RunBatch();
+
+    Executor& m_executor;
+    std::string m_name;
+    mutable std::mutex m_mutex;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_scheduled = false;
+    std::atomic<uint64_t> m_tasksRun{0};
+    std::atomic<uint64_t> m_steals{0};
+};
+
+// Fixed-size work-stealing thread pool shared by many writers.
+//
+// Each worker owns a deque: it pops its own work from the front and, when
+// idle, steals from the back of the other workers' deques. Work is scheduled
+// per ExecutorClient, so queue depth and steal counts are reported per writer.
+class Executor {
+public:
+    struct ClientStats {
+        std::string name;
+        size_t queueDepth = 0;
+        uint64_t tasksRun = 0;
+        uint64_t steals = 0;
+    };
+
+    // workerCount 0 uses one worker per placement CPU, or
+    // std::thread::hardware_concurrency() without placement. Workers pin
+    // themselves to the placement's CPUs and allocate from its NUMA node.
+    explicit Executor(size_t workerCount = 0, const PlacementOptions& placement = PlacementOptions());
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // Process-wide executor sized to the machine.
+    static Executor& Shared();
+
+    std::shared_ptr<ExecutorClient> CreateClient(const std::string& name);
+
+    size_t WorkerCount() const { return m_workers.size(); }
+    const PlacementInfo& GetPlacement() const { return m_placement; }
+    std::vector<ClientStats> GetStats() const;
+
+private:
+    friend class ExecutorClient;
+
+    struct Job {
+        std::shared_ptr<ExecutorClient> client;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void Schedule(std::shared_ptr<ExecutorClient> client);
+    bool TryPop(size_t worker, Job& job, bool& stolen);
+    void WorkerLoop(size_t worker);
+
+    PlacementInfo m_placement;
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCv;
+    std::atomic<size_t> m_pending{0};
+    std::atomic<size_t> m_nextQueue{0};
+    bool m_stop = false;
+
+    mutable std::mutex m_clientsMutex;
+    std::vector<std::weak_ptr<ExecutorClient>> m_clients;
+};
+
+} // namespace MediaEncoder
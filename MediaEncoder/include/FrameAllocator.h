@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+namespace MediaEncoder {
+
+struct FrameAllocatorStats {
+    uint64_t allocations = 0;
+    uint64_t bytesAllocated = 0;    // cumulative
+    size_t bytesLive = 0;           // handed out and not yet released
+    uint64_t fallbacks = 0;         // served from the heap instead of the backend
+};
+
+enum class HugePageMode {
+    Transparent,    // 2 MiB-aligned anonymous mappings with madvise(MADV_HUGEPAGE)
+    Explicit        // MAP_HUGETLB from the reserved pool, else Transparent
+};
+
+// Source of frame and scratch memory for VideoFrame, AudioFrame and
+// Resampler. Buffers are returned as AVBufferRefs, so frames built on them
+// remain ordinary refcounted AVFrames; each buffer keeps its allocator alive
+// until it is released, even if an encoder holds it past its owner.
+class FrameAllocator : public std::enable_shared_from_this<FrameAllocator> {
+public:
+    virtual ~FrameAllocator() = default;
+
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    // Used by frames and resamplers created without an allocator. Initially
+    // a heap allocator with 64-byte alignment.
+    static std::shared_ptr<FrameAllocator> Default();
+    static void SetDefault(std::shared_ptr<FrameAllocator> allocator);
+
+    // alignment must be a power of two from 16 to 64 (64 suits AVX-512).
+    static std::shared_ptr<FrameAllocator> CreateHeap(size_t alignment = 64);
+
+    // Buffers of at least half a huge page get their own 2 MiB-aligned
+    // mapping, so a 4K picture spans a few TLB entries instead of thousands;
+    // smaller ones come from the heap. Without huge page support (e.g. on
+    // macOS) the mappings use normal pages.
+    static std::shared_ptr<FrameAllocator> CreateHugePage(HugePageMode mode = HugePageMode::Transparent,
+                                                          size_t alignment = 64);
+
+    // Bump allocation from chunks of chunkSize bytes, for the frames of one
+    // session. A chunk is reused once every buffer taken from it has been
+    // released, so the arena grows to the peak of live chunks; the chunks
+    // are freed with the last reference to the arena. Requests larger than
+    // a chunk come from the heap, and MakeWritable() copies from Default().
+    static std::shared_ptr<FrameAllocator> CreateArena(size_t chunkSize, size_t alignment = 64);
+
+    // A buffer of at least size bytes starting on an Alignment() boundary.
+    virtual AVBufferRef* Allocate(size_t size) = 0;
+    virtual const char* Name() const = 0;
+
+    size_t Alignment() const { return m_alignment; }
+    FrameAllocatorStats Stats() const;
+
+    // Allocates the planes described by width/height/format (video) or
+    // nb_samples/format/ch_layout (audio) in one buffer, with every plane
+    // and line start aligned.
+    void AllocateVideo(AVFrame* frame);
+    void AllocateAudio(AVFrame* frame);
+
+    // Replaces shared or read-only buffers with a private copy from this
+    // allocator (the default one for arenas); a no-op when the frame is
+    // already writable.
+    void MakeWritable(AVFrame* frame);
+
+protected:
+    explicit FrameAllocator(size_t alignment);
+
+    // Wraps backend memory [base, base + length) holding the buffer at data.
+    // heap memory (from AllocateFromHeap) is freed directly; anything else
+    // is handed back through Release() once the last reference is gone.
+    AVBufferRef* Track(uint8_t* data, size_t size, void* base, size_t length, bool heap);
+    AVBufferRef* AllocateFromHeap(size_t size, bool fallback);
+    virtual void Release(void*, size_t) {}
+    // Allocator for the private copies made by MakeWritable().
+    virtual std::shared_ptr<FrameAllocator> CopyAllocator();
+
+private:
+    struct Allocation;
+    static void FreeAllocation(void* opaque, uint8_t* data);
+
+    const size_t m_alignment;
+    std::atomic<uint64_t> m_allocations{0};
+    std::atomic<uint64_t> m_bytesAllocated{0};
+    std::atomic<size_t> m_bytesLive{0};
+    std::atomic<uint64_t> m_fallbacks{0};
+};
+
+} // namespace MediaEncoder
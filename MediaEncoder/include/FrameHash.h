@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace MediaEncoder {
+
+// 64-bit content hash of a video frame's visible pixels. Row padding is
+// ignored, so frames with different strides but equal pixels hash alike.
+// Returns 0 for formats it cannot walk (hardware frames, bitstreams).
+uint64_t HashVideoFrame(const AVFrame* frame);
+
+// Hash of a contiguous buffer, seeded so rows can be chained.
+uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t seed);
+
+} // namespace MediaEncoder
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace MediaEncoder {
+
+// What the producer does when every slot is queued or in use.
+enum class OverflowPolicy {
+    DropOldest,     // reclaim the oldest queued frame
+    DropNewest,     // BeginWrite() returns nullptr and the new frame is skipped
+    Block           // spin until the consumer releases a slot
+};
+
+struct FrameRingStats {
+    uint64_t published = 0;
+    uint64_t consumed = 0;
+    uint64_t droppedOldest = 0;
+    uint64_t droppedNewest = 0;
+    uint64_t blockedWrites = 0;
+};
+
+// Fixed-capacity single-producer/single-consumer ring of preallocated frames.
+//
+// The producer (e.g. a realtime capture callback) fills a slot in place
+// between BeginWrite() and Publish(); the consumer reads between BeginRead()
+// and EndRead(). Neither side locks or allocates, beyond what an optional
+// publish callback does. Slots circulate through two index queues:
+// published (producer -> consumer) and free (consumer -> producer). The
+// published tail is advanced with a CAS so the producer can
+// reclaim the oldest frame under DropOldest without racing the consumer.
+template <typename Frame>
+class FrameRing {
+public:
+    template <typename Factory>
+    FrameRing(size_t capacity, OverflowPolicy policy, Factory&& makeFrame)
+        : m_capacity(capacity), m_policy(policy),
+          m_published(new std::atomic<uint32_t>[capacity]),
+          m_free(new std::atomic<uint32_t>[capacity])
+    {
+        if (capacity < 2) throw std::invalid_argument("FrameRing needs at least two slots");
+        m_slots.reserve(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            m_slots.emplace_back(makeFrame());
+            m_published[i].store(0, std::memory_order_relaxed);
+            m_free[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+        }
+        m_freeHead.store(capacity, std::memory_order_release);
+    }
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    // Producer side. Returns the slot to fill, or nullptr under DropNewest
+    // when the ring is full. Calling again before Publish() returns the same slot.
+    Frame* BeginWrite() {
+        if (m_writing != kNone) return m_slots[m_writing].get();
+
+        bool counted = false;
+        while (true) {
+            uint64_t freeTail = m_freeTail.load(std::memory_order_relaxed);
+            if (freeTail != m_freeHead.load(std::memory_order_acquire)) {
+                m_writing = m_free[freeTail % m_capacity].load(std::memory_order_relaxed);
+                m_freeTail.store(freeTail + 1, std::memory_order_release);
+                return m_slots[m_writing].get();
+            }
+
+            switch (m_policy) {
+            case OverflowPolicy::DropNewest:
+                m_droppedNewest.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+
+            case OverflowPolicy::DropOldest: {
+                uint64_t tail = m_tail.load(std::memory_order_acquire);
+                if (tail != m_head.load(std::memory_order_relaxed)) {
+                    uint32_t index = m_published[tail % m_capacity].load(std::memory_order_relaxed);
+                    if (m_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel)) {
+                        m_droppedOldest.fetch_add(1, std::memory_order_relaxed);
+                        m_writing = index;
+                        return m_slots[m_writing].get();
+                    }
+                    continue;
+                }
+                // Only the consumer's in-flight slot is outstanding; wait for it.
+                std::this_thread::yield();
+                break;
+            }
+
+            case OverflowPolicy::Block:
+                if (!counted) {
+                    m_blockedWrites.fetch_add(1, std::memory_order_relaxed);
+                    counted = true;
+                }
+                std::this_thread::yield();
+                break;
+            }
+        }
+    }
+
+    void Publish() {
+        if (m_writing == kNone) return;
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        m_published[head % m_capacity].store(m_writing, std::memory_order_relaxed);
+        m_head.store(head + 1, std::memory_order_release);
+        m_writing = kNone;
+        m_publishedCount.fetch_add(1, std::memory_order_relaxed);
+        if (m_onPublish) m_onPublish();
+    }
+
+    // Runs on the producer after each Publish(), once the frame is visible
+    // to BeginRead(), so a consumer can sleep instead of polling. Set before
+    // the producer starts.
+    void SetPublishCallback(std::function<void()> callback) { m_onPublish = std::move(callback); }
+
+    // Consumer side. Returns the oldest published frame or nullptr when empty.
+    Frame* BeginRead() {
+        if (m_reading != kNone) return m_slots[m_reading].get();
+
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        while (tail != m_head.load(std::memory_order_acquire)) {
+            uint32_t index = m_published[tail % m_capacity].load(std::memory_order_relaxed);
+            if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel)) {
+                m_reading = index;
+                return m_slots[m_reading].get();
+            }
+        }
+        return nullptr;
+    }
+
+    void EndRead() {
+        if (m_reading == kNone) return;
+        uint64_t freeHead = m_freeHead.load(std::memory_order_relaxed);
+        m_free[freeHead % m_capacity].store(m_reading, std::memory_order_relaxed);
+        m_freeHead.store(freeHead + 1, std::memory_order_release);
+        m_reading = kNone;
+        m_consumedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t Capacity() const { return m_capacity; }
+    OverflowPolicy Policy() const { return m_policy; }
+
+    // Frames published but not yet claimed by the consumer.
+    size_t Size() const {
+        return static_cast<size_t>(m_head.load(std::memory_order_acquire) -
+                                   m_tail.load(std::memory_order_acquire));
+    }
+
+    // Setup-time access to every slot, e.g. to place its memory. Not safe
+    // while a producer or consumer is active.
+    template <typename Fn>
+    void ForEachSlot(Fn&& fn) {
+        for (auto& slot : m_slots) fn(*slot);
+    }
+
+    FrameRingStats Stats() const {
+        FrameRingStats stats;
+        stats.published = m_publishedCount.load(std::memory_order_relaxed);
+        stats.consumed = m_consumedCount.load(std::memory_order_relaxed);
+        stats.droppedOldest = m_droppedOldest.load(std::memory_order_relaxed);
+        stats.droppedNewest = m_droppedNewest.load(std::memory_order_relaxed);
+        stats.blockedWrites = m_blockedWrites.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    const size_t m_capacity;
+    const OverflowPolicy m_policy;
+    std::vector<std::unique_ptr<Frame>> m_slots;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> m_published;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_free;
+
+    alignas(64) std::atomic<uint64_t> m_head{0};        // published, written by producer
+    alignas(64) std::atomic<uint64_t> m_tail{0};        // published, CAS by both sides
+    alignas(64) std::atomic<uint64_t> m_freeHead{0};    // free, written by consumer
+    alignas(64) std::atomic<uint64_t> m_freeTail{0};    // free, written by producer
+
+    alignas(64) uint32_t m_writing = kNone;             // producer-owned
+    alignas(64) uint32_t m_reading = kNone;             // consumer-owned
+    std::function<void()> m_onPublish;                  // fixed once the producer runs
+
+    std::atomic<uint64_t> m_publishedCount{0};
+    std::atomic<uint64_t> m_consumedCount{0};
+    std::atomic<uint64_t> m_droppedOldest{0};
+    std::atomic<uint64_t> m_droppedNewest{0};
+    std::atomic<uint64_t> m_blockedWrites{0};
+};
+
+} // namespace MediaEncoder
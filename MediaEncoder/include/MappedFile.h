@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavutil/buffer.h>
+}
+
+namespace MediaEncoder {
+
+// A read-only, private mapping of a whole file. Frame views handed out by the
+// readers reference it through AVBufferRefs, so the mapping stays valid until
+// the last frame is released even if the reader is destroyed first.
+class MappedFile : public std::enable_shared_from_this<MappedFile> {
+public:
+    static std::shared_ptr<MappedFile> Open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    const std::string& Path() const { return m_path; }
+
+    // Hints that [offset, offset + length) is needed soon (readahead).
+    void WillNeed(size_t offset, size_t length) const;
+
+    // Read-only buffer over [offset, offset + length). Writing through a frame
+    // that uses it (MakeWritable) copies the data first.
+    AVBufferRef* Reference(size_t offset, size_t length);
+
+private:
+    MappedFile(std::string path, const uint8_t* data, size_t size);
+
+    std::string m_path;
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+} // namespace MediaEncoder
@@ -2,14 +2,84 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <iostream> // Optional: for debug logging
 
 extern "C" {
 #include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
 }
 
 namespace MediaEncoder {
 
+struct MuxerInfo {
+    const AVOutputFormat* format = nullptr;
+    std::string name;
+    std::string longName;
+    std::vector<std::string> extensions;
+    AVCodecID defaultVideoCodec = AV_CODEC_ID_NONE;
+    AVCodecID defaultAudioCodec = AV_CODEC_ID_NONE;
+};
+
+struct EncoderInfo {
+    const AVCodec* codec = nullptr;
+    std::string name;
+    AVCodecID id = AV_CODEC_ID_NONE;
+    AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    bool hardware = false;
+    bool experimental = false;
+};
+
+enum class CodecSupport {
+    Supported,
+    Unsupported,
+    Unknown         // the muxer does not say; libavformat will try
+};
+
+// Result of MediaFormat::Validate(). Encoders are nullptr for absent streams.
+struct OutputPlan {
+    const MuxerInfo* muxer = nullptr;
+    const EncoderInfo* videoEncoder = nullptr;
+    const EncoderInfo* audioEncoder = nullptr;
+};
+
+// Immutable snapshot of the muxers and encoders built into libav*, created
+// on first use. All lookups are hash lookups and safe from any thread.
+class CapabilityIndex {
+public:
+    static const CapabilityIndex& Get();
+
+    const std::vector<MuxerInfo>& Muxers() const { return m_muxers; }
+    const MuxerInfo* FindMuxer(const std::string& name) const;
+    const MuxerInfo* FindMuxerByExtension(const std::string& extension) const;
+
+    // By format name, else by the url's extension (as av_guess_format does).
+    const MuxerInfo* GuessMuxer(const std::string& format, const std::string& url) const;
+
+    const EncoderInfo* FindEncoder(const std::string& name) const;
+
+    // Encoders for a codec, software before hardware before experimental.
+    const std::vector<const EncoderInfo*>& EncodersFor(AVCodecID id) const;
+
+    // The named encoder or, when it is not built in, the preferred encoder
+    // for the same codec (e.g. libx264 -> another H.264 encoder). Codec
+    // names such as "h264" are accepted too. nullptr if nothing matches.
+    const EncoderInfo* ResolveEncoder(const std::string& name) const;
+
+    CodecSupport Supports(const MuxerInfo& muxer, AVCodecID codec) const;
+
+private:
+    CapabilityIndex();
+
+    std::vector<MuxerInfo> m_muxers;
+    std::vector<EncoderInfo> m_encoders;
+    std::unordered_map<std::string, size_t> m_muxersByName;
+    std::unordered_map<std::string, size_t> m_muxersByExtension;
+    std::unordered_map<std::string, size_t> m_encodersByName;
+    std::unordered_map<int, std::vector<const EncoderInfo*>> m_encodersById;
+    std::vector<std::unordered_map<int, CodecSupport>> m_support;    // per muxer, by codec id
+};
+
 class MediaFormat {
 public:
     static std::vector<std::string> GetAllFormatLongNames();
@@ -19,6 +89,12 @@ public:
     static std::string GetFormatLongName(const std::string& format);
 
     static void GetFormatInfo(const std::string& format, std::string& longName, std::string& extensions);
+
+    // Resolves the muxer and encoders an output would use and checks that
+    // the container can carry the codecs, without opening anything. An
+    // empty encoder name means no such stream. Throws std::invalid_argument.
+    static OutputPlan Validate(const std::string& url, const std::string& format,
+                               const std::string& videoEncoder, const std::string& audioEncoder);
 };
 
-} // namespace MediaEncoder
\ No newline at end of file
+} // namespace MediaEncoder
@@ -1,13 +1,15 @@
 #pragma once
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // Forward declarations of opaque structs
 typedef struct MediaWriterHandle MediaWriterHandle;
-typedef struct VideoFrameHandle VideoFrameHandle;
-typedef struct AudioFrameHandle AudioFrameHandle;
+typedef struct VideoFrameHandle VideoFrameHandle;   // MediaEncoder::VideoFrame owned by C++ code
+typedef struct AudioFrameHandle AudioFrameHandle;   // MediaEncoder::AudioFrame owned by C++ code
 
 // Video codec enumeration
 typedef enum {
@@ -30,73 +32,420 @@ typedef enum {
     // Add more if needed (matches MediaEncoder::AudioCodec)
 } AudioCodec;
 
+// Status codes returned by every MediaWriter_* call
+typedef enum {
+    MEDIA_STATUS_OK = 0,
+    MEDIA_STATUS_INVALID_ARGUMENT = -1,
+    MEDIA_STATUS_INVALID_STATE = -2,
+    MEDIA_STATUS_OUT_OF_MEMORY = -3,
+    MEDIA_STATUS_ENCODER_ERROR = -4,
+    MEDIA_STATUS_WOULD_BLOCK = 1        // async queue full; nothing was queued
+} MediaStatus;
+
+// Behaviour when a writer exceeds its memory budget (matches MediaEncoder::MemoryPolicy)
+typedef enum {
+    MEDIA_MEMORY_BLOCK = 0,             // Encode* waits, Submit* returns MEDIA_STATUS_WOULD_BLOCK
+    MEDIA_MEMORY_DROP_NON_REFERENCE,    // drop video frames not forced to be keyframes
+    MEDIA_MEMORY_FAIL                   // fail the writer
+} MediaMemoryPolicy;
+
+// Pass as pts to let the writer assign the next timestamp.
+#define MEDIA_PTS_AUTO INT64_MIN
+
+/**
+ * Called exactly once when the library no longer references submitted planes,
+ * which can be after the submitting call has returned (encoder lookahead).
+ *
+ * @param opaque    Value passed alongside the callback.
+ * @param data      First plane pointer of the submission.
+ */
+typedef void (*MediaReleaseCallback)(void* opaque, uint8_t* data);
+
+/**
+ * Called after a packet has been written to the output.
+ *
+ * @param opaque        Value registered with MediaWriter_SetCallbacks.
+ * @param streamIndex   Output stream index.
+ * @param size          Packet size in bytes.
+ * @param pts           Packet pts in frame units (video) or samples (audio).
+ */
+typedef void (*MediaPacketCallback)(void* opaque, int streamIndex, int size, int64_t pts);
+
 /**
- * Creates and initializes a new MediaWriter instance.
- * 
- * @param filename        Output file path.
- * @param format          Format name (e.g., "mp4", "mov").
+ * Called on the encoding thread after adaptive quality changed the encoder.
+ *
+ * @param opaque    Value registered with MediaWriter_SetAdaptiveQuality.
+ * @param level     New level; 0 is full quality, higher is faster.
+ * @param width     Encoded width at the new level.
+ * @param height    Encoded height at the new level.
+ * @param preset    Encoder preset at the new level, or "" if none.
+ */
+typedef void (*MediaQualityCallback)(void* opaque, int level, int width, int height, const char* preset);
+
+/**
+ * Creates a new MediaWriter instance.
+ *
  * @param width           Video width.
  * @param height          Video height.
- * @param fps             Frames per second.
- * @param videoCodec      Video codec to use.
+ * @param fpsNum          Frame rate numerator.
+ * @param fpsDen          Frame rate denominator.
+ * @param videoCodec      Video codec to use, or VIDEO_CODEC_NONE for no video.
  * @param videoBitrate    Video bitrate in bps.
- * @param audioCodec      Audio codec to use.
+ * @param audioCodec      Audio codec to use, or AUDIO_CODEC_NONE for no audio.
  * @param audioBitrate    Audio bitrate in bps.
- * @return                Handle to the MediaWriter, or NULL on failure.
+ * @param outWriter       Receives the handle on success.
+ * @return                MEDIA_STATUS_OK or an error status.
  */
-MediaWriterHandle* MediaWriter_Create(
-    const char* filename,
-    const char* format,
+int MediaWriter_Create(
     int width,
     int height,
-    int fps,
+    int fpsNum,
+    int fpsDen,
     VideoCodec videoCodec,
     int videoBitrate,
     AudioCodec audioCodec,
-    int audioBitrate
+    int audioBitrate,
+    MediaWriterHandle** outWriter
 );
 
 /**
- * Opens the MediaWriter. Must be called before encoding frames.
- * 
+ * Sets the audio input/encoder sample rate and channel count. Must be called
+ * before MediaWriter_Open. Defaults to 48000 Hz stereo.
+ *
+ * @param writer        MediaWriter handle.
+ * @param sampleRate    Sample rate in Hz.
+ * @param channels      Channel count.
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetAudioFormat(MediaWriterHandle* writer, int sampleRate, int channels);
+
+/**
+ * Runs this writer on the process-wide executor shared by all writers
+ * instead of per-writer encoder and worker threads. Must be called before
+ * MediaWriter_Open.
+ *
+ * @param writer    MediaWriter handle.
+ * @return          MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_UseSharedExecutor(MediaWriterHandle* writer);
+
+/**
+ * Sets the time base of caller-supplied pts, e.g. 1/1000000 for a
+ * microsecond capture clock. Timestamps are rebased so the first one on
+ * either stream becomes 0. Passing 0/1 restores encoder units.
+ *
+ * @param writer    MediaWriter handle.
+ * @param num       Time base numerator.
+ * @param den       Time base denominator.
+ * @return          MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetInputTimeBase(MediaWriterHandle* writer, int num, int den);
+
+/**
+ * Bounds how far one stream may run ahead of the other while packets wait
+ * to be interleaved. Past the bound packets are written as they come.
+ *
+ * @param writer        MediaWriter handle.
+ * @param milliseconds  Maximum delta, or 0 to wait for both streams. Default 1000.
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetMaxInterleaveDelta(MediaWriterHandle* writer, int milliseconds);
+
+/**
+ * Opens the output. Must be called before encoding frames.
+ *
+ * @param writer    MediaWriter handle.
+ * @param url       Output file path or URL.
+ * @param format    Format name (e.g., "mp4", "mov"), or NULL to guess from the url.
+ * @return          MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_Open(MediaWriterHandle* writer, const char* url, const char* format);
+
+/**
+ * Queries the audio layout the encoder expects. Valid after MediaWriter_Open.
+ *
+ * @param writer        MediaWriter handle.
+ * @param frameSize     Receives samples per frame (0 if the codec accepts any size).
+ * @param sampleFormat  Receives the AVSampleFormat value (planar formats need one plane per channel).
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_GetAudioFrameInfo(MediaWriterHandle* writer, int* frameSize, int* sampleFormat);
+
+/**
+ * Encodes a YUV420P video frame directly from caller memory without copying.
+ *
+ * @param writer    MediaWriter handle.
+ * @param planes    Y, U and V plane pointers.
+ * @param strides   Byte stride of each plane.
+ * @param pts       Timestamp in frame units (1/fps) or the input time base, or MEDIA_PTS_AUTO.
+ * @param release   Called once the planes may be reused. If NULL the library
+ *                  copies the planes before returning.
+ * @param opaque    Passed to release.
+ * @return          MEDIA_STATUS_OK or an error status. release is invoked on
+ *                  failure as well.
+ */
+int MediaWriter_EncodeVideoPlanes(MediaWriterHandle* writer,
+                                  const uint8_t* const planes[3], const int strides[3],
+                                  int64_t pts, MediaReleaseCallback release, void* opaque);
+
+/**
+ * Encodes audio samples directly from caller memory without copying.
+ *
+ * @param writer        MediaWriter handle.
+ * @param planes        One pointer per channel for planar formats, otherwise a single pointer.
+ * @param planeCount    Number of entries in planes.
+ * @param samples       Samples per channel. Must equal the frame size unless it is 0;
+ *                      only the final frame may be shorter.
+ * @param pts           Timestamp in samples or the input time base, or MEDIA_PTS_AUTO.
+ * @param release       Called once the planes may be reused. If NULL the library
+ *                      copies the samples before returning.
+ * @param opaque        Passed to release.
+ * @return              MEDIA_STATUS_OK or an error status. release is invoked on
+ *                      failure as well.
+ */
+int MediaWriter_EncodeAudioPlanes(MediaWriterHandle* writer,
+                                  const uint8_t* const* planes, int planeCount, int samples,
+                                  int64_t pts, MediaReleaseCallback release, void* opaque);
+
+/**
+ * Registers the callbacks used by the non-blocking Submit* entry points.
+ * Must be called before MediaWriter_StartAsync. Callbacks run on the
+ * writer's worker thread and must not call back into the same writer.
+ *
+ * @param writer          MediaWriter handle.
+ * @param frameReleased   Called once per submission when its planes may be
+ *                        reused (also for rejected submissions). If NULL,
+ *                        Submit* copies the planes before returning.
+ * @param packetWritten   Called after each packet is written, or NULL.
+ * @param opaque          Passed to both callbacks.
+ * @return                MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetCallbacks(MediaWriterHandle* writer, MediaReleaseCallback frameReleased,
+                             MediaPacketCallback packetWritten, void* opaque);
+
+/**
+ * Switches the writer to non-blocking mode: encoding and muxing move to a
+ * worker thread fed by a queue of at most queueCapacity frames. Call after
+ * MediaWriter_Open. The blocking Encode* calls keep working and wait for
+ * queue space.
+ *
+ * @param writer          MediaWriter handle.
+ * @param queueCapacity   Maximum number of queued frames.
+ * @return                MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_StartAsync(MediaWriterHandle* writer, int queueCapacity);
+
+/**
+ * Queues a YUV420P video frame without waiting for the encoder.
+ *
+ * @param writer    MediaWriter handle.
+ * @param planes    Y, U and V plane pointers.
+ * @param strides   Byte stride of each plane.
+ * @param pts       Timestamp in frame units (1/fps) or the input time base, or MEDIA_PTS_AUTO.
+ * @return          MEDIA_STATUS_OK, MEDIA_STATUS_WOULD_BLOCK when the queue
+ *                  is full, or an error status (including errors raised by
+ *                  earlier frames on the worker thread).
+ */
+int MediaWriter_SubmitVideoPlanes(MediaWriterHandle* writer,
+                                  const uint8_t* const planes[3], const int strides[3], int64_t pts);
+
+/**
+ * Queues audio samples without waiting for the encoder. Parameters match
+ * MediaWriter_EncodeAudioPlanes.
+ *
+ * @return          MEDIA_STATUS_OK, MEDIA_STATUS_WOULD_BLOCK when the queue
+ *                  is full, or an error status.
+ */
+int MediaWriter_SubmitAudioPlanes(MediaWriterHandle* writer,
+                                  const uint8_t* const* planes, int planeCount, int samples, int64_t pts);
+
+/**
+ * Charges this writer's queued frames to the process-wide memory governor.
+ * Must be called before MediaWriter_StartAsync.
+ *
+ * @param writer        MediaWriter handle.
+ * @param limitBytes    Per-writer limit in bytes, or 0 for only the global limit.
+ * @param policy        What to do when a frame does not fit.
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetMemoryBudget(MediaWriterHandle* writer, int64_t limitBytes, MediaMemoryPolicy policy);
+
+/**
+ * Sets the limit shared by all writers with a memory budget. 0 disables it.
+ *
+ * @param limitBytes    Global limit in bytes.
+ */
+void MediaEncoder_SetGlobalMemoryLimit(int64_t limitBytes);
+
+/**
+ * Returns the bytes currently charged to the process-wide memory governor.
+ */
+int64_t MediaEncoder_GetMemoryUsage(void);
+
+/**
+ * Enables realtime pacing: video frames (never keyframes or audio) are
+ * dropped once the writer falls more than targetLatencyMs behind capture.
+ * Dropped frames keep their timestamps.
+ *
+ * @param writer            MediaWriter handle.
+ * @param targetLatencyMs   Latency budget in milliseconds, or 0 to disable.
+ * @return                  MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetRealtime(MediaWriterHandle* writer, int targetLatencyMs);
+
+/**
+ * Skips video frames identical to the previous one and stretches the
+ * previous frame instead (variable frame rate output).
+ *
+ * @param writer            MediaWriter handle.
+ * @param enabled           Non-zero to enable.
+ * @param maxSkippedFrames  Longest run of skipped frames, or 0 for no bound.
+ * @return                  MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetSkipDuplicateFrames(MediaWriterHandle* writer, int enabled, int maxSkippedFrames);
+
+/**
+ * Blocks until all queued frames have been encoded and written.
+ *
  * @param writer    MediaWriter handle.
- * @return          0 on success, non-zero on error.
+ * @return          MEDIA_STATUS_OK or an error status.
  */
-int MediaWriter_Open(MediaWriterHandle* writer);
+int MediaWriter_Flush(MediaWriterHandle* writer);
 
 /**
  * Encodes a video frame.
- * 
+ *
  * @param writer    MediaWriter handle.
  * @param frame     VideoFrame handle.
- * @return          0 on success, non-zero on error.
+ * @return          MEDIA_STATUS_OK or an error status.
  */
 int MediaWriter_EncodeVideoFrame(MediaWriterHandle* writer, VideoFrameHandle* frame);
 
 /**
  * Encodes an audio frame.
- * 
+ *
  * @param writer    MediaWriter handle.
  * @param frame     AudioFrame handle.
- * @return          0 on success, non-zero on error.
+ * @return          MEDIA_STATUS_OK or an error status.
  */
 int MediaWriter_EncodeAudioFrame(MediaWriterHandle* writer, AudioFrameHandle* frame);
 
+/**
+ * Writes a JPEG preview of the video to a file at most every intervalMs of
+ * stream time. Scaling and encoding run on a low-priority thread and never
+ * delay frame submission. Call before MediaWriter_StartAsync.
+ *
+ * @param writer        MediaWriter handle.
+ * @param path          Output file, replaced atomically; a single %d, as in
+ *                      "thumb-%05d.jpg", numbers the files instead.
+ * @param intervalMs    Minimum spacing between previews.
+ * @param width         Preview width; height keeps the aspect ratio.
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetPreview(MediaWriterHandle* writer, const char* path, int intervalMs, int width);
+
+/**
+ * Pins the writer's encoder and worker threads to a set of CPUs and places
+ * its frame memory on a NUMA node. Falls back to CPU pinning alone (or
+ * nothing) where NUMA placement is unavailable. Call before MediaWriter_Open.
+ *
+ * @param writer    MediaWriter handle.
+ * @param cpus      CPU numbers, or NULL to use the CPUs of numaNode.
+ * @param cpuCount  Number of entries in cpus.
+ * @param numaNode  Memory node, or -1 for the node of the given CPUs.
+ * @return          MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetPlacement(MediaWriterHandle* writer, const int* cpus, int cpuCount, int numaNode);
+
+/**
+ * Steps the video encoder to faster presets, then smaller output sizes,
+ * while the average encode time stays above degradeLoad of the frame
+ * interval, and back up while it stays below upgradeLoad. Uses the default
+ * preset and scale ladders. Parameter sets change with each step and are
+ * sent in-band, so MediaWriter_Open then fails with
+ * MEDIA_STATUS_INVALID_ARGUMENT for formats that need global headers
+ * (MP4, MOV, MKV, ...). Call before MediaWriter_Open.
+ *
+ * @param writer        MediaWriter handle.
+ * @param degradeLoad   Load that triggers a step down, e.g. 0.85.
+ * @param upgradeLoad   Load that allows a step up, e.g. 0.5.
+ * @param holdMs        How long the load must persist before a step.
+ * @param callback      Called after each change, or NULL.
+ * @param opaque        Passed to callback.
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetAdaptiveQuality(MediaWriterHandle* writer, double degradeLoad, double upgradeLoad, int holdMs,
+                                   MediaQualityCallback callback, void* opaque);
+
+/**
+ * Accepts video frames of any size and software pixel format: each one, or
+ * its crop rectangle, is scaled to fit the writer's size with its aspect
+ * ratio kept, centred on a border of the fill colour. Call before
+ * MediaWriter_Open.
+ *
+ * @param writer        MediaWriter handle.
+ * @param enabled       Non-zero to fit frames, zero to require exact frames.
+ * @param r             Fill colour, red.
+ * @param g             Fill colour, green.
+ * @param b             Fill colour, blue.
+ * @param cropX         Left edge of the part of each frame to use.
+ * @param cropY         Top edge of the part of each frame to use.
+ * @param cropWidth     Crop width, or 0 (with cropHeight 0) for the whole frame.
+ * @param cropHeight    Crop height, or 0 for the whole frame.
+ * @return              MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_SetVideoFit(MediaWriterHandle* writer, int enabled, uint8_t r, uint8_t g, uint8_t b,
+                            int cropX, int cropY, int cropWidth, int cropHeight);
+
+/**
+ * Adds an output that receives the same encoded packets as the primary
+ * one, muxed on its own thread. A slow output drops packets until the next
+ * keyframe; a failing output is disabled without affecting the others.
+ * Outputs whose format needs global headers (MP4, MKV) must be added
+ * before MediaWriter_Open.
+ *
+ * @param writer            MediaWriter handle.
+ * @param url               Output file path or URL.
+ * @param format            Format name, or NULL to guess from the url.
+ * @param queueCapacity     Packets buffered for this output.
+ * @return                  MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_AddOutput(MediaWriterHandle* writer, const char* url, const char* format, int queueCapacity);
+
+/**
+ * Continues the recording in a new file without restarting the encoders.
+ * The switch happens at a forced keyframe; the previous file is finalized
+ * on a background thread.
+ *
+ * @param writer    MediaWriter handle.
+ * @param url       Path or URL of the next file (same container format).
+ * @return          MEDIA_STATUS_OK or an error status.
+ */
+int MediaWriter_Rollover(MediaWriterHandle* writer, const char* url);
+
 /**
  * Closes and finalizes the media file.
- * 
+ *
  * @param writer    MediaWriter handle.
- * @return          0 on success, non-zero on error.
+ * @return          MEDIA_STATUS_OK or an error status.
  */
 int MediaWriter_Close(MediaWriterHandle* writer);
 
+/**
+ * Returns the message of the last failed call on this handle, or "" if none.
+ * The pointer stays valid until the next call on the same handle.
+ *
+ * @param writer    MediaWriter handle.
+ */
+const char* MediaWriter_GetLastError(MediaWriterHandle* writer);
+
 /**
  * Frees the MediaWriter instance and associated resources.
- * 
+ *
  * @param writer    MediaWriter handle to free.
  */
 void MediaWriter_Destroy(MediaWriterHandle* writer);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -2,6 +2,28 @@
 
 #include <string>
 #include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <future>
+#include <vector>
+
+#include "FrameRing.h"
+#include "Executor.h"
+#include "MemoryGovernor.h"
+#include "PacketInterleaver.h"
+#include "OutputSink.h"
+#include "PreviewTap.h"
+#include "Placement.h"
+#include "QualityController.h"
+#include "Scaler.h"
+#if defined(MEDIAENCODER_COROUTINES)
+#include "WriterAwaitables.h"
+#endif
 
 extern "C" {
     #include <libavformat/avformat.h>
@@ -19,15 +41,249 @@ namespace MediaEncoder {
                     const std::string& videoCodecName, int videoBitrate,
                     const std::string& audioCodecName, int audioBitrate);
 
-        ~MediaWriter() = default;
+        ~MediaWriter();
+
+        struct WriterStats {
+            uint64_t videoFramesEncoded = 0;
+            uint64_t audioFramesEncoded = 0;
+            uint64_t packetsWritten = 0;
+            uint64_t bytesWritten = 0;
+            size_t queueDepth = 0;
+            FrameRingStats videoRing;
+            FrameRingStats audioRing;
+            // Shared executor client (AttachExecutor)
+            size_t executorQueueDepth = 0;
+            uint64_t executorTasksRun = 0;
+            uint64_t executorSteals = 0;
+            // Memory budget (SetMemoryBudget)
+            size_t memoryUsage = 0;
+            uint64_t framesDroppedForMemory = 0;
+            // Realtime mode (SetRealtimeMode)
+            uint64_t framesDroppedLate = 0;
+            uint64_t framesLate = 0;            // encoded, but finished past the target latency
+            int64_t averageEncodeMicroseconds = 0;
+            uint64_t framesSkippedDuplicate = 0;
+            // Interleaver
+            size_t interleaveBufferedBytes = 0;
+            uint64_t interleaveForcedWrites = 0;
+            uint64_t rollovers = 0;
+            // Preview tap (SetPreview)
+            uint64_t previewsEncoded = 0;
+            uint64_t previewsSkipped = 0;
+            // Effective thread and memory placement (SetPlacement)
+            PlacementInfo placement;
+            // Adaptive quality (SetAdaptiveQuality)
+            int qualityLevel = 0;
+            uint64_t qualityChanges = 0;
+        };
+
+        // (streamIndex, packet size in bytes, pts in the encoder time base)
+        using PacketCallback = std::function<void(int, int, int64_t)>;
+
+        // Must be called before Open(). Defaults to 48 kHz stereo.
+        void SetAudioParameters(int sampleRate, int channels);
+
+        // Codec threads for each encoder: 0 lets the codec pick (usually one
+        // per core), 1 encodes on the calling or worker thread only. Unset,
+        // the codec's default applies. Ignored with AttachExecutor(), which
+        // always opens encoders single-threaded. Call before Open().
+        void SetEncoderThreads(int threads);
+
+        // Pins the writer's threads to a CPU set and places its frame memory
+        // on the matching NUMA node. Encoders are opened under the placement,
+        // so codec threads inherit it; the async worker applies it to itself;
+        // the writer's conversion frames are migrated to the node in Open()
+        // and the slots of attached frame rings in StartAsync(). Requests the
+        // host cannot honour are narrowed (see WriterStats::placement), and
+        // without NUMA support only the CPU set applies. With
+        // AttachExecutor(), encoding runs where the executor's workers are
+        // placed. Call before Open().
+        void SetPlacement(const PlacementOptions& options);
+
+        // Runs encoding and muxing on a shared executor instead of per-writer
+        // threads: encoders are opened single-threaded and StartAsync() drains
+        // the queue on an executor strand. Call before Open().
+        void AttachExecutor(Executor& executor, const std::string& name = "MediaWriter");
+
+        // Caller timestamps are read in this time base (e.g. {1, 1000000} for
+        // a microsecond capture clock) and rebased so that the first one seen
+        // on either stream becomes 0. {0, 1}, the default, means encoder
+        // units: frames for video, samples for audio, without rebasing.
+        void SetInputTimeBase(AVRational timeBase);
+
+        // How far, in milliseconds, one stream may run ahead of the other
+        // in the interleaving buffer before packets are written regardless.
+        // 0 waits for both streams like av_interleaved_write_frame. Default 1000.
+        void SetMaxInterleaveDelta(int milliseconds);
 
         void Open(const std::string& url, const std::string& format);
-        void EncodeVideoFrame(VideoFrame* frame);
-        void EncodeAudioFrame(AudioFrame* frame);
+        void EncodeVideoFrame(VideoFrame* frame, int64_t pts = AV_NOPTS_VALUE);
+        void EncodeAudioFrame(AudioFrame* frame, int64_t pts = AV_NOPTS_VALUE);
+
+        // Encodes a caller-owned AVFrame that already matches the encoder
+        // format. A pts of AV_NOPTS_VALUE lets the writer assign the next one.
+        void EncodeNativeVideoFrame(AVFrame* frame);
+        void EncodeNativeAudioFrame(AVFrame* frame);
+
         void Close();
 
+        // Adds an output that receives the same encoded packets (encode once,
+        // mux many; packets are shared by reference, not copied). Each added
+        // output runs on its own I/O thread with a queue of queueCapacity
+        // packets: a slow output drops packets and resumes at the next video
+        // keyframe, and a failing one is disabled without affecting the
+        // encoder or the other outputs. Every output starts at a video
+        // keyframe. Outputs added before Open() are considered when deciding
+        // on global codec headers; one added later whose format needs global
+        // headers the encoders were not opened with throws
+        // std::logic_error. Formats that need in-band headers get them
+        // repeated before keyframes.
+        // Returns the output's index in GetOutputStats().
+        size_t AddOutput(const std::string& url, const std::string& format = "", size_t queueCapacity = 512);
+        std::vector<OutputStats> GetOutputStats() const;
+
+        // Continues the recording in a new file while the encoders keep
+        // running. The new file is opened (same container format) before
+        // this returns; the next encoded video frame is forced to a
+        // keyframe, and from its packet on output goes to newUrl with
+        // timestamps restarting at zero. Audio up to the switch point still
+        // goes to the old file, whose trailer is written and file closed on
+        // a background thread. Trailer errors surface from the next
+        // Rollover() or Close().
+        void Rollover(const std::string& newUrl);
+
+        // Moves encoding and muxing onto a worker thread fed by a bounded
+        // queue of at most queueCapacity frames. Call after Open(). In async
+        // mode Encode*Frame block while the queue is full; TrySubmit* never do.
+        void StartAsync(size_t queueCapacity);
+        bool IsAsync() const { return m_data->async; }
+
+        // Queue a reference to the frame and return immediately. Returns
+        // false without taking a reference when the queue is full.
+        bool TrySubmitVideoFrame(AVFrame* frame);
+        bool TrySubmitAudioFrame(AVFrame* frame);
+
+        // Charges queued frames to an account of at most limitBytes (0 means
+        // only the governor's global limit applies). Over the limit, policy
+        // decides: Block waits in Encode*Frame (TrySubmit* returns false),
+        // DropNonReference drops video frames not forced to be keyframes
+        // (pict_type I), Fail throws MemoryLimitError and fails the writer:
+        // every later Encode*Frame, Flush and Close rethrows it. Call before
+        // StartAsync().
+        void SetMemoryBudget(MemoryGovernor& governor, size_t limitBytes, MemoryPolicy policy);
+
+        // Keeps video within targetLatencyMs of capture. Encode time is
+        // tracked against the frame interval; once the backlog (queue age in
+        // async mode, accumulated overrun otherwise) plus the expected encode
+        // time exceeds the target, video frames are dropped. Keyframes
+        // (pict_type I) and audio are never dropped, and dropped frames keep
+        // their pts so playback timing is unchanged. 0 disables. Call before
+        // StartAsync().
+        void SetRealtimeMode(int targetLatencyMs);
+
+        // Skips video frames whose pixels hash equal to the previous frame's,
+        // e.g. static screen content. Skipped frames consume their pts, so
+        // the previous frame is shown for longer (variable frame rate); the
+        // container must accept VFR. Forced keyframes are always encoded.
+        // maxSkippedFrames bounds a run of skips (0 means unbounded), which
+        // also bounds how long a trailing static section can be cut short.
+        void SetDuplicateFrameSkipping(bool enabled, int maxSkippedFrames = 0);
+
+        // Trades quality for speed when encoding cannot keep up. Encode time
+        // per video frame is averaged against the frame interval; sustained
+        // load above options.degradeLoad steps the encoder to the next
+        // faster preset and, past the last one, to a smaller output size
+        // (frames are scaled down before encoding). Load below
+        // options.upgradeLoad steps back up, with hysteresis (see
+        // QualityController). Each change reopens the video encoder after
+        // draining the old one: the new encoder starts with a keyframe and
+        // carries its parameter sets in-band. Containers that store them
+        // once in a global header (MP4, MOV, MKV, ...) cannot follow that,
+        // so Open() throws std::invalid_argument for them, including tee
+        // outputs added before Open(); later ones are refused by
+        // AddOutput(). Encoding runs without B-frames so timestamps stay
+        // monotonic across switches. The callback runs on the encoding
+        // thread after each change. Call before Open().
+        void SetAdaptiveQuality(const AdaptiveQualityOptions& options, QualityCallback callback = nullptr);
+
+        // Accepts video frames of any size and software pixel format. Each
+        // frame, or its crop rectangle when crop has a size, is scaled to fit
+        // the output with its aspect ratio kept and centred on a border of
+        // fill, in one pass into the writer's own frame (see
+        // Scaler::ConvertRect). The crop must lie within every frame and
+        // start on a whole chroma block; frames it does not fit are rejected
+        // with std::invalid_argument. Call before Open().
+        void SetVideoFit(bool enabled, FillColor fill = FillColor(), const ScaleRect& crop = ScaleRect());
+
+        // Produces a still image (MJPEG or PNG) at most every
+        // options.intervalMs of stream time, delivered to the callback
+        // and/or written to options.path. The encoding path only takes a
+        // reference to a due frame; scaling and image encoding happen on a
+        // low-priority thread, and frames arriving while it is busy are
+        // skipped, so the tap never blocks Encode*Frame. Call before StartAsync().
+        void SetPreview(const PreviewOptions& options, PreviewCallback callback = nullptr);
+
+        // Blocks until every queued frame has been encoded and muxed.
+        void Flush();
+
+        // Non-blocking counterparts of the waits in Encode*Frame and Flush(),
+        // for producers that suspend instead (see WriterAwaitables.h).
+        // NotifyWhenWritable registers callback for the next time a queued
+        // frame finishes, which is when a TrySubmit* that returned false can
+        // succeed; it returns false without registering when nothing is
+        // queued (the writer is synchronous, or the submission is waiting on
+        // a memory budget held by others). NotifyWhenFlushed calls callback
+        // once the queue is drained, right away if it already is. Callbacks
+        // run on the encoding thread, with no writer lock held, and must not
+        // block; all pending ones run when the worker stops.
+        bool NotifyWhenWritable(std::function<void()> callback);
+        void NotifyWhenFlushed(std::function<void()> callback);
+
+#if defined(MEDIAENCODER_COROUTINES)
+        // co_await counterparts of EncodeVideoFrame/EncodeAudioFrame and
+        // Close(): they suspend only while the async queue is full or, for
+        // CloseAsync, frames are still being encoded, and resume through
+        // the resume executor (see WriterAwaitables.h). Without StartAsync()
+        // they complete inline. Set the executor before StartAsync().
+        void SetResumeExecutor(ResumeExecutor executor);
+        WriterSubmitAwaitable EncodeVideoFrameAsync(VideoFrame* frame, int64_t pts = AV_NOPTS_VALUE);
+        WriterSubmitAwaitable EncodeAudioFrameAsync(AudioFrame* frame, int64_t pts = AV_NOPTS_VALUE);
+        WriterCloseAwaitable CloseAsync();
+#endif
+
+        // Lock-free capture handoff. The writer is the ring's consumer: the
+        // async worker sleeps until the producer publishes (the ring's
+        // publish callback is set here), or call ConsumeRings() yourself
+        // from a single thread. Attach before StartAsync() and before the
+        // producer starts; the ring must outlive the writer. Ring frames get
+        // writer-assigned timestamps and go through the same duplicate,
+        // realtime and memory budget handling as submitted ones; a frame
+        // the budget cannot take under MemoryPolicy::Block stays in the
+        // ring until it can. A stream with a ring takes no other input:
+        // Encode*Frame and TrySubmit* for it throw std::logic_error.
+        // Rings cannot be combined with AttachExecutor().
+        void AttachVideoRing(FrameRing<VideoFrame>* ring);
+        void AttachAudioRing(FrameRing<AudioFrame>* ring);
+        size_t ConsumeRings();
+
+        WriterStats GetStats() const;
+
+        // Invoked after each packet is written, on the thread doing the muxing.
+        void SetPacketCallback(PacketCallback callback) { m_packetCallback = std::move(callback); }
+
+        // Writes the recorded Chrome trace to this path when Close() runs.
+        void SetTraceOutput(const std::string& path) { m_traceOutput = path; }
+
         int GetWidth() const { return m_width; }
         int GetHeight() const { return m_height; }
+        int GetAudioSampleRate() const { return m_audioSampleRate; }
+        int GetAudioChannels() const { return m_audioChannels; }
+
+        // Encoder geometry; valid after Open(). A nonzero audio frame size
+        // is what every audio frame must carry, except a shorter last one.
+        AVPixelFormat GetVideoPixelFormat() const;
+        AVSampleFormat GetAudioSampleFormat() const;
+        int GetAudioFrameSize() const;
 
     private:
         int m_width;
@@ -36,41 +292,228 @@ namespace MediaEncoder {
         int m_videoDenominator;
         int m_videoBitrate;
         int m_audioBitrate;
+        int m_audioSampleRate;
+        int m_audioChannels;
 
         std::string m_videoCodecName;
         std::string m_audioCodecName;
         std::string m_url;
         std::string m_format;
+        std::string m_traceOutput;
+        PacketCallback m_packetCallback;
 
         bool m_disposed;
 
+        // One output container fed by the writer's encoders.
+        struct Muxer {
+            std::string url;
+            AVFormatContext* formatCtx = nullptr;
+            AVStream* videoStream = nullptr;
+            AVStream* audioStream = nullptr;
+            int64_t videoOffset = 0;        // encoder timestamp that maps to 0 in this file
+            int64_t audioOffset = 0;
+            std::unique_ptr<PacketInterleaver> interleaver;
+
+            ~Muxer() {
+                interleaver.reset();
+                if (formatCtx) {
+                    if (!(formatCtx->oformat->flags & AVFMT_NOFILE)) {
+                        avio_closep(&formatCtx->pb);
+                    }
+                    avformat_free_context(formatCtx);
+                }
+            }
+        };
+
+        // Wakes the async worker of a writer with rings (MediaWriter.cpp).
+        struct RingSignal;
+
         // ✅ Full definition required to avoid incomplete type error
         struct WriterPrivateData {
-            AVFormatContext* formatCtx = nullptr;
+            bool opened = false;
+            const AVOutputFormat* outputFormat = nullptr;
+            std::unique_ptr<Muxer> muxer;
             AVCodecContext* videoCtx = nullptr;
             AVCodecContext* audioCtx = nullptr;
-            AVStream* videoStream = nullptr;
-            AVStream* audioStream = nullptr;
             AVFrame* videoFrame = nullptr;
             AVFrame* audioFrame = nullptr;
+            // Per-writer references to caller VideoFrame/AudioFrame buffers,
+            // so a frame shared with other writers is never modified here.
+            AVFrame* videoInput = nullptr;
+            AVFrame* audioInput = nullptr;
             int64_t videoPts = 0;
             int64_t audioPts = 0;
+            bool audioEnded = false;    // a short frame ended a fixed-size audio stream
+            int encoderThreads = -1;    // -1: codec default
+            PlacementInfo placement;
+            std::atomic<size_t> placementBoundBytes{0};
+
+            // Caller timestamps (SetInputTimeBase)
+            AVRational inputTimeBase{0, 1};
+            int64_t inputOrigin = AV_NOPTS_VALUE;
+
+            std::atomic<int64_t> maxInterleaveUs{1000000};
+
+            // Async submission (StartAsync)
+            struct QueuedFrame {
+                AVFrame* frame;
+                bool video;
+                size_t bytes;       // charged to memory
+                int64_t enqueuedUs;
+            };
+            bool async = false;
+            std::thread worker;
+            mutable std::mutex queueMutex;
+            std::condition_variable queueCv;
+            std::condition_variable spaceCv;
+            std::deque<QueuedFrame> queue;
+            size_t queueCapacity = 0;
+            size_t inFlight = 0;
+            bool stopWorker = false;
+            std::exception_ptr asyncError;     // also set by a Fail memory limit in sync mode
+            std::vector<std::function<void()>> writableWaiters;
+            std::vector<std::function<void()>> flushedWaiters;
+            size_t wakingWaiters = 0;          // WakeWaiters calls running callbacks unlocked
+#if defined(MEDIAENCODER_COROUTINES)
+            ResumeExecutor resumeExecutor;
+#endif
+
+            // Executor mode: the queue is drained by a pump task on this strand.
+            std::shared_ptr<ExecutorClient> strand;
+            bool pumpScheduled = false;
+
+            std::shared_ptr<MemoryAccount> memory;
+            std::atomic<uint64_t> framesDroppedForMemory{0};
+
+            // Realtime pacing; encodeEmaUs and backlogUs belong to the encoding thread.
+            int64_t realtimeTargetUs = 0;
+            int64_t backlogUs = 0;
+            std::atomic<int64_t> encodeEmaUs{0};
+            std::atomic<uint64_t> framesDroppedLate{0};
+            std::atomic<uint64_t> framesLate{0};
+
+            // Duplicate skipping; owned by the submitting thread. A frame
+            // dropped after being hashed sets resetFrameHash so its
+            // successor is not skipped against content that was never encoded.
+            bool skipDuplicates = false;
+            int maxSkippedFrames = 0;
+            int skippedRun = 0;
+            bool haveFrameHash = false;
+            uint64_t lastFrameHash = 0;
+            std::atomic<bool> resetFrameHash{false};
+            std::atomic<uint64_t> framesSkippedDuplicate{0};
+
+            FrameRing<VideoFrame>* videoRing = nullptr;
+            FrameRing<AudioFrame>* audioRing = nullptr;
+            AVFrame* ringView = nullptr;
+            std::shared_ptr<RingSignal> ringSignal;     // shared with the rings' publish callbacks
+            bool ringWaitingForMemory = false;          // consumer-owned
+
+            std::atomic<uint64_t> videoFramesEncoded{0};
+            std::atomic<uint64_t> audioFramesEncoded{0};
+            std::atomic<uint64_t> packetsWritten{0};
+            std::atomic<uint64_t> bytesWritten{0};
+
+            // Rollover: nextMuxer is opened up front and takes over at the
+            // forced keyframe; drainingMuxer still receives audio up to the
+            // switch point; retiring holds background trailer writes.
+            std::mutex rolloverMutex;
+            std::atomic<bool> rolloverPending{false};
+            std::unique_ptr<Muxer> nextMuxer;
+            int64_t rolloverPts = AV_NOPTS_VALUE;
+            std::unique_ptr<Muxer> drainingMuxer;
+            std::vector<std::future<void>> retiring;
+            std::atomic<uint64_t> rollovers{0};
+
+            // Tee outputs (AddOutput); specs wait here until Open().
+            struct OutputSpec {
+                std::string url;
+                const AVOutputFormat* format;
+                size_t queueCapacity;
+            };
+            std::vector<OutputSpec> pendingOutputs;
+            std::vector<std::unique_ptr<OutputSink>> outputs;
+            mutable std::mutex outputsMutex;
+
+            std::unique_ptr<PreviewTap> preview;
+
+            // Adaptive quality; the controller and scaler belong to the
+            // encoding thread. videoCtxMutex is held while the encoder is
+            // replaced and by readers on other threads (Rollover, AddOutput),
+            // which otherwise see the codec only through the cached format.
+            bool adaptiveQuality = false;
+            AdaptiveQualityOptions qualityOptions;
+            QualityCallback qualityCallback;
+            std::unique_ptr<QualityController> quality;
+            const AVCodec* videoCodec = nullptr;
+            AVRational videoTimeBase{0, 1};
+            AVPixelFormat videoPixelFormat = AV_PIX_FMT_NONE;
+            std::mutex videoCtxMutex;
+            std::atomic<int> qualityLevel{0};
+            std::atomic<uint64_t> qualityChanges{0};
+
+            // Frames that are not at the encoder's size and format (fitted
+            // or adaptively scaled) are converted into videoFrame.
+            bool fitVideo = false;
+            FillColor fitFill;
+            ScaleRect fitCrop;
+            Scaler videoScaler;
 
             ~WriterPrivateData() {
+                preview.reset();
+                outputs.clear();
+                // Muxers hold packets charged to the memory account.
+                muxer.reset();
+                drainingMuxer.reset();
+                nextMuxer.reset();
+                for (auto& pending : retiring) pending.wait();
+                for (auto& item : queue) {
+                    av_frame_free(&item.frame);
+                    if (memory) memory->Release(item.bytes);
+                }
                 if (videoCtx) avcodec_free_context(&videoCtx);
                 if (audioCtx) avcodec_free_context(&audioCtx);
-                if (formatCtx) {
-                    if (!(formatCtx->oformat->flags & AVFMT_NOFILE)) {
-                        avio_closep(&formatCtx->pb);
-                    }
-                    avformat_free_context(formatCtx);
-                }
                 if (videoFrame) av_frame_free(&videoFrame);
                 if (audioFrame) av_frame_free(&audioFrame);
+                if (ringView) av_frame_free(&ringView);
+                if (videoInput) av_frame_free(&videoInput);
+                if (audioInput) av_frame_free(&audioInput);
             }
         };
 
         std::unique_ptr<WriterPrivateData> m_data;
+
+        void PrepareVideoFrame(AVFrame* frame);
+        void PrepareAudioFrame(AVFrame* frame);
+        uint64_t HashForDuplicates(const AVFrame* frame) const;
+        bool IsDuplicateVideoFrame(const AVFrame* frame);
+        bool IsDuplicateVideoFrame(const AVFrame* frame, uint64_t hash);
+        void EncodeVideo(AVFrame* frame);
+        AVCodecContext* OpenVideoEncoder(int width, int height, const std::string& preset, bool globalHeader);
+        AVFrame* ScaleForEncoder(AVFrame* frame);
+        void ApplyQualityLevel();
+        void EncodeAudio(AVFrame* frame);
+        void EncodePacedVideo(AVFrame* frame, int64_t ageUs);
+        bool Submit(AVFrame* frame, bool video, bool wait);
+        void CheckDirectInput(bool video) const;
+        bool EncodeRingFrame(AVFrame* frame, bool video);
+        void AttachRingSignal();
+        void NotifyWorker();
+        void WorkerLoop();
+        void PumpQueue();
+        void EncodeQueued(WriterPrivateData::QueuedFrame& item);
+        void StopWorker();
+        void WakeWaiters(std::unique_lock<std::mutex>& lock);
+        void RethrowAsyncError();
+        void FailWriter(std::exception_ptr error);
+        void WriteFrame(AVCodecContext* codecCtx, AVFrame* frame);
+        void WritePacket(Muxer& muxer, AVPacket* pkt);
+        std::unique_ptr<Muxer> CreateMuxer(const std::string& url);
+        bool ClaimRolloverKeyframe(int64_t pts);
+        void SwitchMuxerIfDue(const AVPacket& pkt, bool video);
+        void RetireDrainingMuxer();
+        void CollectRetiredMuxers(bool wait);
+        int64_t RebaseInputPts(int64_t pts, AVRational encoderTimeBase);
     };
 
 } // namespace MediaEncoder
\ No newline at end of file
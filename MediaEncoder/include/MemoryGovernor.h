@@ -0,0 +1,110 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace MediaEncoder {
+
+class MemoryGovernor;
+
+// What an account does when a charge would exceed its own or the global limit.
+enum class MemoryPolicy {
+    Block,              // wait until other charges are released
+    DropNonReference,   // refuse droppable charges; reference data is admitted over the limit
+    Fail                // throw, failing the writer
+};
+
+// Thrown by Charge() under MemoryPolicy::Fail.
+class MemoryLimitError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct MemoryAccountStats {
+    std::string name;
+    size_t usage = 0;
+    size_t peak = 0;
+    size_t limit = 0;
+    uint64_t blocked = 0;
+    uint64_t dropped = 0;
+    uint64_t failed = 0;
+};
+
+// Bytes charged by one writer. Every Charge() that returns true must be
+// matched by a Release() of the same size; outstanding bytes are returned to
+// the governor when the account is destroyed.
+class MemoryAccount {
+public:
+    MemoryAccount(MemoryGovernor& governor, std::string name, size_t limit, MemoryPolicy policy);
+    ~MemoryAccount();
+
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    // Returns false when nothing was charged: the data should be dropped
+    // (DropNonReference) or the caller asked not to wait (Block). Throws
+    // MemoryLimitError under Fail.
+    bool Charge(size_t bytes, bool droppable, bool wait = true);
+    void Release(size_t bytes);
+
+    const std::string& Name() const { return m_name; }
+    MemoryPolicy Policy() const { return m_policy; }
+    size_t Limit() const { return m_limit; }
+    size_t Usage() const;
+    MemoryAccountStats Stats() const;
+
+private:
+    friend class MemoryGovernor;
+
+    bool Fits(size_t bytes) const;
+
+    MemoryGovernor& m_governor;
+    const std::string m_name;
+    const size_t m_limit;
+    const MemoryPolicy m_policy;
+
+    // Guarded by the governor's mutex.
+    size_t m_usage = 0;
+    size_t m_peak = 0;
+    uint64_t m_blocked = 0;
+    uint64_t m_dropped = 0;
+    uint64_t m_failed = 0;
+};
+
+// Process-wide byte budget shared by frame queues, packet queues and mux
+// buffers of many writers. A limit of 0 means unlimited.
+class MemoryGovernor {
+public:
+    explicit MemoryGovernor(size_t globalLimit = 0);
+
+    MemoryGovernor(const MemoryGovernor&) = delete;
+    MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+    static MemoryGovernor& Shared();
+
+    void SetGlobalLimit(size_t bytes);
+    size_t GlobalLimit() const;
+    size_t Usage() const;
+    size_t PeakUsage() const;
+
+    std::shared_ptr<MemoryAccount> CreateAccount(const std::string& name, size_t limit, MemoryPolicy policy);
+    std::vector<MemoryAccountStats> GetStats() const;
+
+private:
+    friend class MemoryAccount;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_released;
+    size_t m_limit;
+    size_t m_usage = 0;
+    size_t m_peak = 0;
+    std::vector<std::weak_ptr<MemoryAccount>> m_accounts;
+};
+
+} // namespace MediaEncoder
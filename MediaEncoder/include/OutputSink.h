@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
+}
+
+namespace MediaEncoder {
+
+class PacketInterleaver;
+
+struct OutputStats {
+    std::string url;
+    uint64_t packetsWritten = 0;
+    uint64_t packetsDropped = 0;
+    size_t queueDepth = 0;
+    bool failed = false;
+    std::string error;
+};
+
+// An additional output of a MediaWriter (tee). The encoding thread hands it
+// references to the encoded packets; the sink's own thread opens the file,
+// interleaves and muxes them. Writing starts at a video keyframe; when the
+// queue is full packets are dropped and the sink resumes at the next one. Any error only disables this
+// sink; it never reaches the encoder or other outputs.
+class OutputSink {
+public:
+    // Stream parameters are copied from the codec contexts; either may be null.
+    OutputSink(std::string url, const AVOutputFormat* format,
+               const AVCodecContext* videoCtx, const AVCodecContext* audioCtx,
+               size_t queueCapacity, int64_t maxInterleaveUs);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // pkt is in the encoder time base. Never blocks on I/O.
+    void Push(const AVPacket* pkt, bool video);
+
+    // Writes what is queued and the trailer, then stops the thread.
+    void Finish();
+
+    OutputStats Stats() const;
+
+private:
+    struct QueuedPacket {
+        AVPacket* packet;
+        bool video;
+    };
+
+    void Run();
+    void OpenOutput();
+    void WritePacket(AVPacket* pkt, bool video);
+    void CloseOutput();
+
+    const std::string m_url;
+    const AVOutputFormat* m_format;
+    AVCodecParameters* m_videoPar = nullptr;
+    AVCodecParameters* m_audioPar = nullptr;
+    AVRational m_videoTimeBase{0, 1};
+    AVRational m_audioTimeBase{0, 1};
+    const size_t m_capacity;
+    const int64_t m_maxInterleaveUs;
+
+    // Sink thread only
+    AVFormatContext* m_formatCtx = nullptr;
+    AVStream* m_videoStream = nullptr;
+    AVStream* m_audioStream = nullptr;
+    AVBSFContext* m_headerFilter = nullptr;     // repeats extradata in-band for formats without global headers
+    std::unique_ptr<PacketInterleaver> m_interleaver;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<QueuedPacket> m_queue;
+    bool m_finishing = false;
+    bool m_failed = false;
+    bool m_resync = false;
+    std::string m_error;
+    uint64_t m_dropped = 0;
+    std::atomic<uint64_t> m_written{0};
+
+    std::thread m_thread;
+};
+
+} // namespace MediaEncoder
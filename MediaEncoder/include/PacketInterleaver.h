@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/rational.h>
+}
+
+namespace MediaEncoder {
+
+class MemoryAccount;
+
+// Orders packets of several streams by dts before they reach the muxer,
+// replacing av_interleaved_write_frame's unbounded buffer.
+//
+// A packet is written once every stream has something queued, so the output
+// stays interleaved. If one stream lags (muted or late source) by more than
+// the max delta, the buffered packets are written anyway instead of growing
+// without bound; the lagging stream's later packets remain monotonic within
+// their own stream. Not thread-safe: use from the thread that muxes.
+class PacketInterleaver {
+public:
+    using WriteFunction = std::function<void(AVPacket*)>;
+
+    // timeBases holds the muxer time base of each stream, indexed by stream.
+    PacketInterleaver(std::vector<AVRational> timeBases, WriteFunction write);
+    ~PacketInterleaver();
+
+    PacketInterleaver(const PacketInterleaver&) = delete;
+    PacketInterleaver& operator=(const PacketInterleaver&) = delete;
+
+    // 0 waits for every stream, like libavformat.
+    void SetMaxDeltaMicroseconds(int64_t delta) { m_maxDelta.store(delta, std::memory_order_relaxed); }
+    int64_t MaxDeltaMicroseconds() const { return m_maxDelta.load(std::memory_order_relaxed); }
+
+    // Buffered packet bytes are charged here (never blocking).
+    void SetMemoryAccount(MemoryAccount* account) { m_memory = account; }
+
+    // Takes the packet's reference; pkt is left blank.
+    void Push(AVPacket* pkt);
+
+    // Writes every buffered packet in dts order.
+    void Flush();
+
+    // Drops buffered packets without writing them.
+    void Clear();
+
+    size_t BufferedBytes() const { return m_bufferedBytes.load(std::memory_order_relaxed); }
+    size_t BufferedPackets() const { return m_bufferedPackets.load(std::memory_order_relaxed); }
+    uint64_t ForcedWrites() const { return m_forcedWrites.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        AVPacket* packet;
+        size_t charged;
+    };
+
+    int64_t Timestamp(const AVPacket* pkt) const;
+    int64_t Microseconds(int stream, int64_t ts) const;
+    void Drain(bool flush);
+    void WriteHead(int stream);
+
+    std::vector<AVRational> m_timeBases;
+    std::vector<std::deque<Entry>> m_queues;
+    WriteFunction m_write;
+    MemoryAccount* m_memory = nullptr;
+    std::atomic<int64_t> m_maxDelta{0};     // may be changed from any thread
+    int64_t m_newest = INT64_MIN;               // latest buffered timestamp, in microseconds
+
+    std::atomic<size_t> m_bufferedBytes{0};
+    std::atomic<size_t> m_bufferedPackets{0};
+    std::atomic<uint64_t> m_forcedWrites{0};
+};
+
+} // namespace MediaEncoder
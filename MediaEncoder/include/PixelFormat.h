@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 extern "C" {
     #include <libavutil/pixfmt.h>
 }
@@ -79,4 +81,174 @@ namespace MediaEncoder {
         D3D11VA_VLD = AV_PIX_FMT_D3D11VA_VLD,
         D3D11 = AV_PIX_FMT_D3D11,
     };
+
+    // Layout of a software pixel format, known at compile time so plane
+    // sizes need no av_image_* or descriptor lookups in per-frame code.
+    struct PixelFormatTraits {
+        int planes = 0;                     // 0 for hardware and unknown formats
+        int log2ChromaW = 0;
+        int log2ChromaH = 0;
+        int bytesPerComponent = 0;          // 0 when components are bit-packed (RGB565, MONOWHITE, ...)
+        int depth = 0;                      // significant bits per component
+        std::array<int, 4> bitsPerPixel{};  // per plane, at that plane's resolution
+        std::array<bool, 4> subsampled{};   // plane has the chroma resolution
+        bool yuv = false;
+        bool fullRange = false;             // YUVJ: black luma is 0 rather than 16
+        bool bigEndian = false;
+        bool palette = false;               // data[1] holds a 256-entry palette
+        int alphaOffset = -1;               // byte offset of alpha in a packed pixel
+
+        constexpr int PlaneWidth(int plane, int width) const {
+            return subsampled[plane] ? (width + (1 << log2ChromaW) - 1) >> log2ChromaW : width;
+        }
+        constexpr int PlaneHeight(int plane, int height) const {
+            return subsampled[plane] ? (height + (1 << log2ChromaH) - 1) >> log2ChromaH : height;
+        }
+        // Bytes of pixel data in one row, i.e. the tightly packed line size.
+        constexpr int PlaneRowBytes(int plane, int width) const {
+            return (PlaneWidth(plane, width) * bitsPerPixel[plane] + 7) >> 3;
+        }
+
+        static constexpr PixelFormatTraits PlanarYuv(int log2W, int log2H, int depth, bool alpha = false,
+                                                     bool fullRange = false, bool bigEndian = false) {
+            PixelFormatTraits traits;
+            traits.planes = alpha ? 4 : 3;
+            traits.log2ChromaW = log2W;
+            traits.log2ChromaH = log2H;
+            traits.bytesPerComponent = depth > 8 ? 2 : 1;
+            traits.depth = depth;
+            for (int plane = 0; plane < traits.planes; ++plane) traits.bitsPerPixel[plane] = 8 * traits.bytesPerComponent;
+            traits.subsampled[1] = traits.subsampled[2] = true;
+            traits.yuv = true;
+            traits.fullRange = fullRange;
+            traits.bigEndian = bigEndian;
+            return traits;
+        }
+
+        // NV12/NV21: a luma plane and one interleaved chroma plane.
+        static constexpr PixelFormatTraits SemiPlanarYuv() {
+            PixelFormatTraits traits;
+            traits.planes = 2;
+            traits.log2ChromaW = traits.log2ChromaH = 1;
+            traits.bytesPerComponent = 1;
+            traits.depth = 8;
+            traits.bitsPerPixel[0] = 8;
+            traits.bitsPerPixel[1] = 16;
+            traits.subsampled[1] = true;
+            traits.yuv = true;
+            return traits;
+        }
+
+        // YUYV422, UYVY422, UYYVYY411: one plane of interleaved samples.
+        static constexpr PixelFormatTraits PackedYuv(int bitsPerPixel, int log2W) {
+            PixelFormatTraits traits = Packed(bitsPerPixel, 1, 8);
+            traits.log2ChromaW = log2W;
+            traits.yuv = true;
+            return traits;
+        }
+
+        static constexpr PixelFormatTraits Packed(int bitsPerPixel, int bytesPerComponent, int depth,
+                                                  int alphaOffset = -1, bool bigEndian = false) {
+            PixelFormatTraits traits;
+            traits.planes = 1;
+            traits.bytesPerComponent = bytesPerComponent;
+            traits.depth = depth;
+            traits.bitsPerPixel[0] = bitsPerPixel;
+            traits.alphaOffset = alphaOffset;
+            traits.bigEndian = bigEndian;
+            return traits;
+        }
+
+        static constexpr PixelFormatTraits PlanarRgb(int depth, bool bigEndian = false) {
+            PixelFormatTraits traits = PlanarYuv(0, 0, depth, false, true, bigEndian);
+            traits.subsampled[1] = traits.subsampled[2] = false;
+            traits.yuv = false;
+            return traits;
+        }
+    };
+
+    constexpr PixelFormatTraits GetPixelFormatTraits(PixelFormat format) {
+        using T = PixelFormatTraits;
+        switch (format) {
+        case PixelFormat::YUV420P:      return T::PlanarYuv(1, 1, 8);
+        case PixelFormat::YUVJ420P:     return T::PlanarYuv(1, 1, 8, false, true);
+        case PixelFormat::YUV422P:      return T::PlanarYuv(1, 0, 8);
+        case PixelFormat::YUVJ422P:     return T::PlanarYuv(1, 0, 8, false, true);
+        case PixelFormat::YUV444P:      return T::PlanarYuv(0, 0, 8);
+        case PixelFormat::YUVJ444P:     return T::PlanarYuv(0, 0, 8, false, true);
+        case PixelFormat::YUV440P:      return T::PlanarYuv(0, 1, 8);
+        case PixelFormat::YUVJ440P:     return T::PlanarYuv(0, 1, 8, false, true);
+        case PixelFormat::YUV410P:      return T::PlanarYuv(2, 2, 8);
+        case PixelFormat::YUV411P:      return T::PlanarYuv(2, 0, 8);
+        case PixelFormat::YUVA420P:     return T::PlanarYuv(1, 1, 8, true);
+        case PixelFormat::YUVA422P:     return T::PlanarYuv(1, 0, 8, true);
+        case PixelFormat::YUVA444P:     return T::PlanarYuv(0, 0, 8, true);
+        case PixelFormat::YUVA420P9LE:  return T::PlanarYuv(1, 1, 9, true);
+        case PixelFormat::YUVA422P9LE:  return T::PlanarYuv(1, 0, 9, true);
+        case PixelFormat::YUVA444P9LE:  return T::PlanarYuv(0, 0, 9, true);
+        case PixelFormat::YUVA420P10LE: return T::PlanarYuv(1, 1, 10, true);
+        case PixelFormat::YUVA422P10LE: return T::PlanarYuv(1, 0, 10, true);
+        case PixelFormat::YUVA444P10LE: return T::PlanarYuv(0, 0, 10, true);
+        case PixelFormat::YUV420P16LE:  return T::PlanarYuv(1, 1, 16);
+        case PixelFormat::YUV420P16BE:  return T::PlanarYuv(1, 1, 16, false, false, true);
+        case PixelFormat::YUV422P16LE:  return T::PlanarYuv(1, 0, 16);
+        case PixelFormat::YUV422P16BE:  return T::PlanarYuv(1, 0, 16, false, false, true);
+        case PixelFormat::YUV444P16LE:  return T::PlanarYuv(0, 0, 16);
+        case PixelFormat::YUV444P16BE:  return T::PlanarYuv(0, 0, 16, false, false, true);
+        case PixelFormat::NV12:
+        case PixelFormat::NV21:         return T::SemiPlanarYuv();
+        case PixelFormat::YUYV422:
+        case PixelFormat::UYVY422:      return T::PackedYuv(16, 1);
+        case PixelFormat::UYYVYY411:    return T::PackedYuv(12, 2);
+        case PixelFormat::GBRP:         return T::PlanarRgb(8);
+        case PixelFormat::GBRP16LE:     return T::PlanarRgb(16);
+        case PixelFormat::GBRP16BE:     return T::PlanarRgb(16, true);
+        case PixelFormat::GRAY8:        return T::Packed(8, 1, 8);
+        case PixelFormat::GRAY16LE:     return T::Packed(16, 2, 16);
+        case PixelFormat::GRAY16BE:     return T::Packed(16, 2, 16, -1, true);
+        case PixelFormat::RGB24:
+        case PixelFormat::BGR24:        return T::Packed(24, 1, 8);
+        case PixelFormat::ARGB:
+        case PixelFormat::ABGR:         return T::Packed(32, 1, 8, 0);
+        case PixelFormat::RGBA:
+        case PixelFormat::BGRA:         return T::Packed(32, 1, 8, 3);
+        case PixelFormat::RGB48LE:      return T::Packed(48, 2, 16);
+        case PixelFormat::RGB48BE:      return T::Packed(48, 2, 16, -1, true);
+        case PixelFormat::RGBA64LE:
+        case PixelFormat::BGRA64LE:     return T::Packed(64, 2, 16, 6);
+        case PixelFormat::RGBA64BE:
+        case PixelFormat::BGRA64BE:     return T::Packed(64, 2, 16, 6, true);
+        case PixelFormat::RGB565LE:
+        case PixelFormat::BGR565LE:
+        case PixelFormat::RGB555LE:
+        case PixelFormat::BGR555LE:     return T::Packed(16, 0, 5);
+        case PixelFormat::RGB565BE:
+        case PixelFormat::BGR565BE:
+        case PixelFormat::RGB555BE:
+        case PixelFormat::BGR555BE:     return T::Packed(16, 0, 5, -1, true);
+        case PixelFormat::RGB8:
+        case PixelFormat::BGR8:         return T::Packed(8, 0, 3);
+        case PixelFormat::RGB4_BYTE:
+        case PixelFormat::BGR4_BYTE:    return T::Packed(8, 0, 2);
+        case PixelFormat::RGB4:
+        case PixelFormat::BGR4:         return T::Packed(4, 0, 2);
+        case PixelFormat::MONOWHITE:
+        case PixelFormat::MONOBLACK:    return T::Packed(1, 0, 1);
+        case PixelFormat::PAL8: {
+            PixelFormatTraits traits = T::Packed(8, 1, 8);
+            traits.palette = true;
+            return traits;
+        }
+        default:                        return T();
+        }
+    }
+
+    constexpr PixelFormatTraits GetPixelFormatTraits(AVPixelFormat format) {
+        return GetPixelFormatTraits(static_cast<PixelFormat>(format));
+    }
+
+    template <PixelFormat Format>
+    struct PixelFormatTraitsOf {
+        static constexpr PixelFormatTraits value = GetPixelFormatTraits(Format);
+    };
 } // namespace MediaEncoder
\ No newline at end of file
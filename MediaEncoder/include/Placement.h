@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace MediaEncoder {
+
+// Where a writer's or executor's threads run and its frame memory lives.
+struct PlacementOptions {
+    std::vector<int> cpus;      // empty: the CPUs of numaNode, or no pinning
+    int numaNode = -1;          // -1: the node all of cpus belong to, if any
+
+    bool Empty() const { return cpus.empty() && numaNode < 0; }
+};
+
+// The placement actually in effect, after clipping the request to the CPUs
+// this process may use and to what the host supports.
+struct PlacementInfo {
+    std::vector<int> cpus;      // empty: threads are not pinned
+    int numaNode = -1;          // -1: memory is not placed
+    bool numaAvailable = false;
+    size_t boundBytes = 0;      // frame memory moved to numaNode
+};
+
+// CPU affinity and NUMA memory placement. Linux uses sched_setaffinity and
+// the mbind/set_mempolicy system calls directly (no libnuma); elsewhere, and
+// on single-node hosts, everything degrades to a no-op that Resolve()
+// reports as an empty placement.
+class Placement {
+public:
+    // Throws std::invalid_argument when cpus only names CPUs this process
+    // cannot run on, or numaNode does not exist.
+    static PlacementInfo Resolve(const PlacementOptions& options);
+
+    static bool NumaAvailable();
+    static int NodeOfCpu(int cpu);
+    static std::vector<int> CpusOfNode(int node);
+
+    // Pins the calling thread and makes numaNode its preferred node for new
+    // pages. Threads it creates afterwards inherit both. Returns false when
+    // nothing could be applied.
+    static bool ApplyToCurrentThread(const PlacementInfo& placement);
+
+    // Migrates the pages of the frame's buffers to node (preferred, so a
+    // full node never fails an allocation). Returns the bytes bound.
+    static size_t BindFrame(const AVFrame* frame, int node);
+};
+
+// Applies a placement to the calling thread for the lifetime of the scope
+// and restores the previous affinity and memory policy afterwards, so
+// threads spawned meanwhile (e.g. codec threads in avcodec_open2) are placed
+// without permanently moving the caller.
+class ScopedPlacement {
+public:
+    explicit ScopedPlacement(const PlacementInfo& placement);
+    ~ScopedPlacement();
+
+    ScopedPlacement(const ScopedPlacement&) = delete;
+    ScopedPlacement& operator=(const ScopedPlacement&) = delete;
+
+private:
+    bool m_affinitySaved = false;
+    bool m_policySaved = false;
+    int m_policyMode = 0;
+    std::vector<unsigned long> m_cpuMask;
+    std::vector<unsigned long> m_nodeMask;
+};
+
+} // namespace MediaEncoder
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "PixelFormat.h"
+
+namespace MediaEncoder {
+
+// Repeating byte pattern that paints a plane black (opaque where there is alpha).
+struct PlaneFill {
+    std::array<uint8_t, 8> bytes{};
+    int size = 1;
+};
+
+template <PixelFormat Format>
+constexpr PlaneFill BlackFill(int plane) {
+    constexpr PixelFormatTraits traits = GetPixelFormatTraits(Format);
+    PlaneFill fill;
+
+    auto put = [&](int index, int value) {
+        if (traits.bytesPerComponent == 2) {
+            fill.bytes[2 * index + (traits.bigEndian ? 1 : 0)] = static_cast<uint8_t>(value & 0xff);
+            fill.bytes[2 * index + (traits.bigEndian ? 0 : 1)] = static_cast<uint8_t>(value >> 8);
+        } else {
+            fill.bytes[index] = static_cast<uint8_t>(value);
+        }
+    };
+    const int shift = traits.depth > 8 ? traits.depth - 8 : 0;
+    const int luma = traits.fullRange ? 0 : 16 << shift;
+    const int chroma = 128 << shift;
+    const int opaque = (1 << traits.depth) - 1;
+
+    if (Format == PixelFormat::YUYV422) {
+        fill.bytes = {static_cast<uint8_t>(luma), 128, static_cast<uint8_t>(luma), 128};
+        fill.size = 4;
+    } else if (Format == PixelFormat::UYVY422) {
+        fill.bytes = {128, static_cast<uint8_t>(luma), 128, static_cast<uint8_t>(luma)};
+        fill.size = 4;
+    } else if (Format == PixelFormat::UYYVYY411) {
+        fill.bytes = {128, static_cast<uint8_t>(luma), static_cast<uint8_t>(luma),
+                      128, static_cast<uint8_t>(luma), static_cast<uint8_t>(luma)};
+        fill.size = 6;
+    } else if (Format == PixelFormat::MONOWHITE) {
+        fill.bytes[0] = 0xff;
+    } else if (traits.yuv) {
+        // Planar or semi-planar: luma, chroma (one or two components), alpha.
+        const int components = plane == 0 || plane == 3 ? 1 : traits.bitsPerPixel[plane] / (8 * traits.bytesPerComponent);
+        for (int c = 0; c < components; ++c) put(c, plane == 0 ? luma : plane == 3 ? opaque : chroma);
+        fill.size = components * traits.bytesPerComponent;
+    } else if (traits.alphaOffset >= 0) {
+        fill.size = traits.bitsPerPixel[0] / 8;
+        for (int b = 0; b < traits.bytesPerComponent; ++b) fill.bytes[traits.alphaOffset + b] = 0xff;
+    }
+    return fill;
+}
+
+// Copies width x height pixels of every plane (and the palette). Row sizes
+// are compile-time functions of the format, and planes whose rows are
+// contiguous in both images are copied in one block.
+template <PixelFormat Format>
+void CopyPlanes(uint8_t* const dst[4], const int dstLinesize[4],
+                const uint8_t* const src[4], const int srcLinesize[4], int width, int height) {
+    constexpr PixelFormatTraits traits = GetPixelFormatTraits(Format);
+    static_assert(traits.planes > 0, "CopyPlanes needs a software pixel format");
+
+    for (int plane = 0; plane < traits.planes; ++plane) {
+        const size_t rowBytes = static_cast<size_t>(traits.PlaneRowBytes(plane, width));
+        const int rows = traits.PlaneHeight(plane, height);
+        const ptrdiff_t dstStride = dstLinesize[plane];
+        const ptrdiff_t srcStride = srcLinesize[plane];
+        if (dstStride == srcStride && static_cast<size_t>(dstStride) == rowBytes) {
+            std::memcpy(dst[plane], src[plane], rowBytes * rows);
+            continue;
+        }
+        for (int y = 0; y < rows; ++y) std::memcpy(dst[plane] + y * dstStride, src[plane] + y * srcStride, rowBytes);
+    }
+    if constexpr (traits.palette) std::memcpy(dst[1], src[1], 256 * 4);
+}
+
+// Paints width x height pixels of every plane black (limited-range YUV
+// unless the format is full range; opaque alpha).
+template <PixelFormat Format>
+void ClearPlanes(uint8_t* const dst[4], const int dstLinesize[4], int width, int height) {
+    constexpr PixelFormatTraits traits = GetPixelFormatTraits(Format);
+    static_assert(traits.planes > 0, "ClearPlanes needs a software pixel format");
+
+    for (int plane = 0; plane < traits.planes; ++plane) {
+        const PlaneFill fill = BlackFill<Format>(plane);
+        const size_t rowBytes = static_cast<size_t>(traits.PlaneRowBytes(plane, width));
+        const int rows = traits.PlaneHeight(plane, height);
+        const ptrdiff_t stride = dstLinesize[plane];
+        uint8_t* first = dst[plane];
+
+        if (fill.size == 1) {
+            for (int y = 0; y < rows; ++y) std::memset(first + y * stride, fill.bytes[0], rowBytes);
+            continue;
+        }
+        size_t x = 0;
+        for (; x + fill.size <= rowBytes; x += fill.size) std::memcpy(first + x, fill.bytes.data(), fill.size);
+        std::memcpy(first + x, fill.bytes.data(), rowBytes - x);
+        for (int y = 1; y < rows; ++y) std::memcpy(first + y * stride, first, rowBytes);
+    }
+    if constexpr (traits.palette) std::memset(dst[1], 0, 256 * 4);
+}
+
+// Runtime dispatch to the kernels above. Return false for formats without
+// traits (hardware surfaces, formats PixelFormat does not list), which the
+// caller handles with av_image_copy()/av_image_fill_black().
+bool CopyImage(AVPixelFormat format, uint8_t* const dst[4], const int dstLinesize[4],
+               const uint8_t* const src[4], const int srcLinesize[4], int width, int height);
+bool ClearImage(AVPixelFormat format, uint8_t* const dst[4], const int dstLinesize[4], int width, int height);
+
+} // namespace MediaEncoder
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+
+#include "Scaler.h"
+
+namespace MediaEncoder {
+
+struct PreviewOptions {
+    int intervalMs = 5000;          // minimum spacing of previews, in stream time
+    int width = 320;
+    int height = 0;                 // 0 keeps the source aspect ratio
+    std::string codec = "mjpeg";    // "mjpeg" or "png"
+    int quality = 5;                // MJPEG qscale, 2 (best) to 31
+    // Written on every preview when set. A single %d, as in
+    // "thumb-%05d.jpg", numbers the files; any other path is written as
+    // given and replaced atomically (write to a temporary name, then rename).
+    std::string path;
+};
+
+// (image bytes, size, pts in microseconds of stream time)
+using PreviewCallback = std::function<void(const uint8_t*, size_t, int64_t)>;
+
+// Still-image side output of a MediaWriter. Offer() runs on the encoding path
+// and only takes a reference to a due frame when the worker is idle: it never
+// waits, copies pixels of refcounted frames, or encodes. Scaling (with a
+// cached Scaler) and the image encode run on a low-priority thread; frames
+// that arrive while it is busy are skipped rather than queued.
+class PreviewTap {
+public:
+    PreviewTap(PreviewOptions options, PreviewCallback callback);
+    ~PreviewTap();
+
+    PreviewTap(const PreviewTap&) = delete;
+    PreviewTap& operator=(const PreviewTap&) = delete;
+
+    void Offer(const AVFrame* frame, int64_t ptsMicroseconds);
+
+    uint64_t PreviewsEncoded() const { return m_encoded.load(std::memory_order_relaxed); }
+    uint64_t PreviewsSkipped() const { return m_skipped.load(std::memory_order_relaxed); }
+    uint64_t PreviewErrors() const { return m_errors.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+    void Encode(AVFrame* source, int64_t ptsMicroseconds);
+    void OpenEncoder(const AVFrame* source);
+    void Deliver(const AVPacket* packet, int64_t ptsMicroseconds);
+
+    PreviewOptions m_options;
+    PreviewCallback m_callback;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    AVFrame* m_pending = nullptr;       // guarded by m_mutex
+    int64_t m_pendingPts = 0;
+    bool m_busy = false;
+    bool m_stop = false;
+    int64_t m_nextDueUs = INT64_MIN;    // touched only by Offer()
+
+    // Worker-owned
+    Scaler m_scaler;
+    AVCodecContext* m_encoder = nullptr;
+    AVFrame* m_scaled = nullptr;
+    AVPacket* m_packet = nullptr;
+    int m_fileIndex = 0;
+
+    std::atomic<uint64_t> m_encoded{0};
+    std::atomic<uint64_t> m_skipped{0};
+    std::atomic<uint64_t> m_errors{0};
+    std::thread m_thread;
+};
+
+} // namespace MediaEncoder
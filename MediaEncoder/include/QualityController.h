@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MediaEncoder {
+
+struct AdaptiveQualityOptions {
+    // Encoder presets, slowest first, set through the codec's "preset"
+    // option. Codecs without one skip straight to the scales.
+    std::vector<std::string> presets = {"medium", "faster", "veryfast", "superfast", "ultrafast"};
+    // Output scale factors tried once the fastest preset is not enough,
+    // largest first, each between 0 and 1.
+    std::vector<double> scales = {0.75, 0.5};
+    // Load is the average encode time over the frame interval. Above
+    // degradeLoad for holdMs the controller steps down a level; below
+    // upgradeLoad for holdMs it steps back up.
+    double degradeLoad = 0.85;
+    double upgradeLoad = 0.5;
+    int holdMs = 2000;
+};
+
+struct QualityLevel {
+    int index = 0;          // 0 is full quality; higher levels encode faster
+    std::string preset;     // empty for codecs without presets
+    int width = 0;
+    int height = 0;
+};
+
+// (previous level, new level, load that triggered the change)
+using QualityCallback = std::function<void(const QualityLevel&, const QualityLevel&, double)>;
+
+// Picks the encoder level from measured encode times. Levels run from the
+// configured preset at full size, through the faster presets, to the scaled
+// sizes at the fastest preset. Changes need the load past a threshold for
+// the hold time and at least the hold time since the previous change. An
+// upgrade that has to be undone soon after doubles the hold for the next
+// upgrade (up to 8x), so a level that only just fits is not retried every
+// few seconds. Not thread-safe: use from the encoding thread.
+class QualityController {
+public:
+    QualityController(const AdaptiveQualityOptions& options, int width, int height, int64_t intervalUs,
+                      bool presets);
+
+    // Throws std::invalid_argument for inconsistent options.
+    static void Validate(const AdaptiveQualityOptions& options);
+
+    // Records one frame's encode time, measured at nowUs (steady clock).
+    // Returns true when the level changed; Previous() is the one left.
+    bool Update(int64_t encodeUs, int64_t nowUs);
+
+    // Returns to the previous level after the new one could not be applied,
+    // and stops adapting.
+    void Revert();
+
+    const QualityLevel& Current() const { return m_levels[m_level]; }
+    const QualityLevel& Previous() const { return m_levels[m_previous]; }
+    size_t LevelCount() const { return m_levels.size(); }
+    double Load() const;
+
+private:
+    void Step(int delta, int64_t nowUs);
+
+    std::vector<QualityLevel> m_levels;
+    const int64_t m_intervalUs;
+    const double m_degradeLoad;
+    const double m_upgradeLoad;
+    const int64_t m_holdUs;
+
+    size_t m_level = 0;
+    size_t m_previous = 0;
+    bool m_enabled = true;
+    int64_t m_encodeEmaUs = 0;
+    int64_t m_overSinceUs = -1;
+    int64_t m_underSinceUs = -1;
+    int64_t m_changedAtUs = -1;
+    bool m_lastWasUpgrade = false;
+    int m_upgradeBackoff = 1;
+};
+
+} // namespace MediaEncoder
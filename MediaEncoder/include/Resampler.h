@@ -3,6 +3,12 @@
 #include <stdexcept>
 #include <cstdint>
 #include <memory>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "Executor.h"
+#include "FrameAllocator.h"
 
 extern "C" {
 #include <libswresample/swresample.h>
@@ -19,9 +25,24 @@ private:
     int m_srcChannels, m_destChannels;
     AVSampleFormat m_srcSampleFormat, m_destSampleFormat;
     int m_srcSampleRate, m_destSampleRate;
-    uint8_t* m_resampledBuffer;
+    AVBufferRef* m_resampledBuffer;
     int m_resampledBufferSize;
+    std::shared_ptr<FrameAllocator> m_allocator;
+    std::shared_ptr<ExecutorClient> m_strand;
+
+    // Split mode (SetParallelChannels): one context per group of channels.
+    struct ChannelGroup {
+        SwrContext* context;
+        int firstChannel;
+        std::shared_ptr<ExecutorClient> strand;     // null for the group the caller runs
+    };
+    std::vector<ChannelGroup> m_groups;
+    std::vector<uint8_t*> m_outputPlanes;
+    int m_channelsPerGroup = 0;
+    Executor* m_groupExecutor = nullptr;
 
+    void FreeContexts();
+    int ConvertGroups(const uint8_t** srcData, int srcSamples, int maxDstSamples);
     void SwrContextValidation(int srcChannels, AVSampleFormat srcSampleFormat, int srcSampleRate,
                               int destChannels, AVSampleFormat destSampleFormat, int destSampleRate);
 
@@ -32,9 +53,35 @@ public:
     void Initialize(int srcChannels, AVSampleFormat srcSampleFormat, int srcSampleRate,
                     int destChannels, AVSampleFormat destSampleFormat, int destSampleRate);
 
+    // Returns the converted samples, valid until the next call. Planar
+    // output has its planes back to back, destSamples each.
     uint8_t* Resample(const uint8_t** srcData, int srcSamples, int& destSamples);
 
     int EstimateOutputSamples(int srcSamples) const;
+
+    // Source of the output buffer returned by Resample(); defaults to
+    // FrameAllocator::Default(). Takes effect when the buffer next grows.
+    void SetAllocator(std::shared_ptr<FrameAllocator> allocator) { m_allocator = std::move(allocator); }
+
+    // For planar-to-planar conversions that keep the channel count (no
+    // mixing, so channels are independent), resamples groups of
+    // channelsPerGroup channels with their own SwrContexts in parallel on
+    // the executor (Executor::Shared() if null); the calling thread takes a
+    // group too and runs any group no worker has started yet. The output is
+    // identical to a single context's. Other conversions, and 0, use one
+    // context. Takes effect at the next Initialize().
+    void SetParallelChannels(int channelsPerGroup, Executor* executor = nullptr);
+
+    struct ResampleResult {
+        uint8_t* data;
+        int samples;
+    };
+
+    // Runs Resample() calls on a strand of the executor, in submission order.
+    // srcData must stay valid until the future is ready, and the returned
+    // buffer is reused by the next call.
+    void AttachExecutor(Executor& executor, const std::string& name = "Resampler");
+    std::future<ResampleResult> ResampleAsync(const uint8_t** srcData, int srcSamples);
 };
 
 } // namespace MediaEncoder
\ No newline at end of file
@@ -6,12 +6,35 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
+#include <array>
 #include <cstdint>
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
+#include "Executor.h"
+#include "PixelFormat.h"
+
 namespace MediaEncoder {
 
+// A rectangle in pixels of the full-resolution (luma) plane.
+struct ScaleRect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Opaque 8-bit RGB colour, converted to the destination format for padding.
+struct FillColor {
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+
+    bool operator==(const FillColor& other) const { return r == other.r && g == other.g && b == other.b; }
+};
+
 class Scaler {
 public:
     Scaler();
@@ -27,14 +50,56 @@ public:
                  uint8_t* const srcData[4], const int srcStride[4],
                  uint8_t* const dstData[4], const int dstStride[4]);
 
+    // Crop, scale and pad in one pass: scales srcRect of the source into
+    // dstRect of the destination and paints only the destination outside
+    // dstRect with fill. Both rectangles are reached by offsetting the plane
+    // pointers, so no intermediate frame is needed and the inside of dstRect
+    // is written once. Rectangles must lie within their images, and for
+    // chroma-subsampled or bit-packed formats start on a whole chroma block
+    // or byte; dstRect must also end on one unless it ends at the image edge.
+    // Throws std::invalid_argument otherwise and for hardware formats.
+    bool ConvertRect(int srcW, int srcH, AVPixelFormat srcFormat,
+                     uint8_t* const srcData[4], const int srcStride[4], const ScaleRect& srcRect,
+                     int dstW, int dstH, AVPixelFormat dstFormat,
+                     uint8_t* const dstData[4], const int dstStride[4], const ScaleRect& dstRect,
+                     FillColor fill = FillColor());
+
+    // Throws std::invalid_argument unless rect can be passed to ConvertRect
+    // as srcRect for a width x height image in format.
+    static void CheckSourceRect(int width, int height, AVPixelFormat format, const ScaleRect& rect);
+
+    // The largest rectangle with the aspect ratio of srcW x srcH centred in
+    // dstW x dstH, aligned so it can be passed to ConvertRect as dstRect.
+    static ScaleRect FitRect(int srcW, int srcH, int dstW, int dstH, AVPixelFormat dstFormat);
+
+    // Runs conversions on a strand of the executor. Conversions submitted
+    // through ConvertAsync execute in order; the buffers must stay valid
+    // until the future is ready.
+    void AttachExecutor(Executor& executor, const std::string& name = "Scaler");
+
+    std::future<bool> ConvertAsync(int srcW, int srcH, AVPixelFormat srcFormat,
+                                   int dstW, int dstH, AVPixelFormat dstFormat,
+                                   uint8_t* const srcData[4], const int srcStride[4],
+                                   uint8_t* const dstData[4], const int dstStride[4]);
+
 private:
     SwsContext* sws_ctx;
     int currentSrcW, currentSrcH, currentDstW, currentDstH;
     AVPixelFormat currentSrcFmt, currentDstFmt;
+    std::shared_ptr<ExecutorClient> strand;
+
+    // One row of fill pixels per plane in the last padded format, long
+    // enough to repeat whole (macro)pixels.
+    std::array<std::vector<uint8_t>, 4> fillPattern;
+    AVPixelFormat fillFormat;
+    FillColor fillColor;
 
     void ResetContext();
     bool EnsureContext(int srcW, int srcH, AVPixelFormat srcFmt,
                        int dstW, int dstH, AVPixelFormat dstFmt);
+    void EnsureFillPattern(AVPixelFormat format, const PixelFormatTraits& traits, FillColor fill);
+    void FillBorder(const PixelFormatTraits& traits, int dstW, int dstH,
+                    uint8_t* const dstData[4], const int dstStride[4], const ScaleRect& dstRect);
 };
 
 } // namespace MediaEncoder
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include "VideoFrame.h"
+#include "AudioFrame.h"
+
+namespace MediaEncoder {
+
+// Frame geometry shared by both processes. Video slots hold the planes as laid
+// out by av_image_fill_arrays() with 32-byte alignment; audio slots as laid
+// out by av_samples_fill_arrays() with default alignment.
+struct SharedFrameFormat {
+    bool video = true;
+    int width = 0;
+    int height = 0;
+    AVPixelFormat pixelFormat = AV_PIX_FMT_NONE;
+    int sampleRate = 0;
+    int channels = 0;
+    AVSampleFormat sampleFormat = AV_SAMPLE_FMT_NONE;
+    int samples = 0;
+
+    static SharedFrameFormat Video(int width, int height, AVPixelFormat format);
+    static SharedFrameFormat Audio(int sampleRate, int channels, AVSampleFormat format, int samples);
+};
+
+enum class SharedRingStatus {
+    Frame,          // a frame was returned
+    Timeout,        // nothing published within the timeout
+    ProducerLost    // the producer died; a new one may attach to the same ring
+};
+
+struct SharedRingStats {
+    uint64_t framesRead = 0;
+    size_t framesInFlight = 0;      // read but not yet released by their last reference
+    uint32_t producerGeneration = 0;
+    uint64_t producersLost = 0;
+};
+
+namespace detail { struct SharedRingMapping; }
+
+// Consumer side of a frame ring in POSIX shared memory, owned by the process
+// that encodes. A capture process attaches with SharedFrameProducer and writes
+// frames into the slots; Read*Frame() returns VideoFrame/AudioFrame objects
+// whose buffers are the slots themselves, so the encoder reads capture memory
+// without a copy. A slot returns to the producer when the last reference to
+// its frame (including any held by an encoder or tee output) is dropped.
+//
+// Slots are claimed with a per-slot sequence number, so frames may be released
+// in any order. Waiting uses a futex on Linux and short sleeps elsewhere. A
+// producer that exits without detaching, or stops heartbeating, is reported
+// once as ProducerLost; frames it already published stay readable and a
+// restarted producer resumes where the old one stopped.
+//
+// The name follows shm_open() rules ("/name"; 31 characters max on macOS).
+class SharedFrameRing {
+public:
+    SharedFrameRing(const std::string& name, const SharedFrameFormat& format, size_t slotCount);
+    ~SharedFrameRing();
+
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    // The frame's pts is the one the producer published (producer time base).
+    SharedRingStatus ReadVideoFrame(std::shared_ptr<VideoFrame>& frame, int timeoutMs);
+    SharedRingStatus ReadAudioFrame(std::shared_ptr<AudioFrame>& frame, int timeoutMs);
+
+    // How long the producer may go without a heartbeat before it is considered lost.
+    void SetProducerTimeout(int timeoutMs) { m_producerTimeoutMs = timeoutMs; }
+
+    bool HasProducer() const;
+    const std::string& Name() const { return m_name; }
+    const SharedFrameFormat& Format() const { return m_format; }
+    SharedRingStats Stats() const;
+
+private:
+    SharedRingStatus Read(AVFrame* frame, int timeoutMs);
+    bool ProducerLost();
+
+    std::string m_name;
+    SharedFrameFormat m_format;
+    std::shared_ptr<detail::SharedRingMapping> m_mapping;
+    uint64_t m_readPosition = 0;
+    int m_producerTimeoutMs = 2000;
+    uint64_t m_framesRead = 0;
+    uint64_t m_producersLost = 0;
+};
+
+// Reference producer: attaches to a ring created by SharedFrameRing (usually
+// from the capture process) and publishes frames into it. Slots can be filled
+// in place between BeginWrite() and Publish(), or copied with Write*Frame().
+class SharedFrameProducer {
+public:
+    explicit SharedFrameProducer(const std::string& name);
+    ~SharedFrameProducer();
+
+    SharedFrameProducer(const SharedFrameProducer&) = delete;
+    SharedFrameProducer& operator=(const SharedFrameProducer&) = delete;
+
+    // Returns the next slot with data/linesize set up for the ring's format,
+    // or nullptr when no slot was released within timeoutMs. The returned
+    // frame stays owned by the producer and is valid until Publish().
+    AVFrame* BeginWrite(int timeoutMs);
+    void Publish(int64_t pts);
+
+    // Copies a frame of the ring's format into the next slot.
+    bool WriteVideoFrame(const AVFrame* frame, int timeoutMs);
+    bool WriteAudioFrame(const AVFrame* frame, int timeoutMs);
+
+    // Keeps the producer alive while it has nothing to publish.
+    void Heartbeat();
+
+    bool ConsumerAlive() const;
+    const SharedFrameFormat& Format() const { return m_format; }
+
+private:
+    SharedFrameFormat m_format;
+    std::shared_ptr<detail::SharedRingMapping> m_mapping;
+    AVFrame* m_slotFrame = nullptr;
+    uint64_t m_writePosition = 0;
+    bool m_writing = false;
+    uint32_t m_generation = 0;
+};
+
+} // namespace MediaEncoder
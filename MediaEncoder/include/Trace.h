@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace MediaEncoder {
+
+// Lightweight pipeline tracer that exports Chrome Trace Event JSON
+// (loadable in chrome://tracing and Perfetto).
+//
+// Events are recorded into a fixed-size buffer owned by the recording thread,
+// so the hot path never takes a lock. When the thread exits its events are
+// kept and the buffer is freed. Instrumentation points use the
+// ME_TRACE_SCOPE macro, which compiles to nothing unless the library is built
+// with MEDIAENCODER_TRACING (CMake option MEDIAENCODER_ENABLE_TRACING).
+class Trace {
+public:
+    static constexpr int64_t kNoPts = INT64_MIN;
+
+    // Starts or stops recording. eventsPerThread applies to threads that
+    // record their first event after this call.
+    static void Enable(bool enabled, size_t eventsPerThread = 1 << 16);
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    static int64_t NowMicroseconds();
+    static void Record(const char* name, const char* category,
+                       int64_t beginUs, int64_t endUs, int64_t pts);
+
+    // Serializes every recorded event. Safe to call while other threads record.
+    static std::string ToChromeTraceJson();
+    static bool WriteChromeTrace(const std::string& path);
+
+    // Discards recorded events. Must not race with recording threads.
+    static void Clear();
+
+    static uint64_t DroppedEvents();
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category, int64_t pts = Trace::kNoPts)
+        : m_name(name), m_category(category), m_pts(pts),
+          m_begin(Trace::IsEnabled() ? Trace::NowMicroseconds() : -1) {}
+
+    ~TraceScope() {
+        if (m_begin >= 0) {
+            Trace::Record(m_name, m_category, m_begin, Trace::NowMicroseconds(), m_pts);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_category;
+    int64_t m_pts;
+    int64_t m_begin;
+};
+
+} // namespace MediaEncoder
+
+#ifdef MEDIAENCODER_TRACING
+#define ME_TRACE_CONCAT_INNER(a, b) a##b
+#define ME_TRACE_CONCAT(a, b) ME_TRACE_CONCAT_INNER(a, b)
+#define ME_TRACE_SCOPE(name, category, pts) \
+    ::MediaEncoder::TraceScope ME_TRACE_CONCAT(meTraceScope_, __LINE__)(name, category, pts)
+#else
+#define ME_TRACE_SCOPE(name, category, pts) do {} while (0)
+#endif
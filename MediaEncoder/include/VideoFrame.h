@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <stdexcept>
@@ -9,18 +10,51 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
+#include "FrameAllocator.h"
+#include "PixelFormat.h"
+
 namespace MediaEncoder {
 
+// One plane of a frame: rowBytes of pixel data in each of rows lines.
+struct PlaneView {
+    uint8_t* data = nullptr;
+    int linesize = 0;
+    int rowBytes = 0;
+    int rows = 0;
+};
+
+// A video picture backed by reference-counted AVBufferRefs.
+//
+// Copies are cheap views that share the pixel buffers; the buffers are
+// released when the last view (or encoder holding a reference) lets go.
+// Writing through FillFrame() or after MakeWritable() detaches the frame
+// first if its buffers are shared, so other views never see the change.
+// Pixel memory, including detached copies, comes from the frame's
+// FrameAllocator (FrameAllocator::Default() unless one is given).
 class VideoFrame {
 public:
-    VideoFrame(int width, int height, AVPixelFormat pixelFormat);
+    VideoFrame(int width, int height, AVPixelFormat pixelFormat,
+               std::shared_ptr<FrameAllocator> allocator = nullptr);
     VideoFrame(const VideoFrame& other);
     VideoFrame(VideoFrame&& other) noexcept;
+    VideoFrame& operator=(const VideoFrame& other);
+    VideoFrame& operator=(VideoFrame&& other) noexcept;
     ~VideoFrame();
 
     void Dispose();
 
+    // Copies a packed image (all planes back to back). srcStride overrides
+    // the line size of single-plane formats; 0 means tightly packed.
     void FillFrame(const uint8_t* srcData, int srcStride);
+
+    // Paints the picture black (limited-range YUV unless the format is full range).
+    void ClearFrame();
+
+    // Ensures this frame owns its buffers exclusively, copying them if they
+    // are shared. Call before writing through DataPointer() or NativePointer().
+    void MakeWritable();
+    bool IsWritable() const;
+
     AVFrame* NativePointer() const;
     int Width() const;
     int Height() const;
@@ -28,15 +62,31 @@ public:
     std::vector<int> LineSize() const;
     std::vector<uint8_t*> DataPointer() const;
 
-    static std::shared_ptr<VideoFrame> Create(int width, int height, AVPixelFormat format) {
-        return std::make_shared<VideoFrame>(width, height, format);
+    // Allocation-free counterparts of DataPointer()/LineSize() for per-frame
+    // code, and a view of one plane sized from the format's traits.
+    std::array<uint8_t*, 4> Planes() const;
+    std::array<int, 4> Strides() const;
+    PlaneView Plane(int index) const;
+    const PixelFormatTraits& Traits() const { return m_traits; }
+
+    static std::shared_ptr<VideoFrame> Create(int width, int height, AVPixelFormat format,
+                                              std::shared_ptr<FrameAllocator> allocator = nullptr) {
+        return std::make_shared<VideoFrame>(width, height, format, std::move(allocator));
     }
 
+    // References the buffers of an existing frame (e.g. a decoder or capture
+    // output) without copying; frames without AVBufferRefs are copied once.
+    static std::shared_ptr<VideoFrame> Wrap(const AVFrame* frame);
+
 private:
+    explicit VideoFrame(const AVFrame* source);
+
     AVFrame* m_frame;
     bool m_disposed;
+    std::shared_ptr<FrameAllocator> m_allocator;
+    PixelFormatTraits m_traits;
 
     void CheckIfDisposed() const;
 };
 
-} // namespace MediaEncoder
\ No newline at end of file
+} // namespace MediaEncoder
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavutil/samplefmt.h>
+#include <libavutil/rational.h>
+}
+
+#include "AudioFrame.h"
+#include "MappedFile.h"
+
+namespace MediaEncoder {
+
+// Reads PCM or IEEE float WAV files through a memory mapping. Each frame is a
+// read-only AudioFrame view of samplesPerFrame interleaved samples over the
+// mapped pages (the last frame may be shorter). Sample formats map to the
+// packed AVSampleFormats (U8, S16, S32, FLT, DBL); 24-bit PCM has no packed
+// equivalent and is rejected. Frames carry pts in samples (TimeBase()).
+class WavReader {
+public:
+    explicit WavReader(const std::string& path, int samplesPerFrame = 1024);
+
+    // Returns false at end of data.
+    bool ReadFrame(std::shared_ptr<AudioFrame>& frame);
+
+    int SampleRate() const { return m_sampleRate; }
+    int Channels() const { return m_channels; }
+    AVSampleFormat SampleFormat() const { return m_sampleFormat; }
+    AVRational TimeBase() const { return AVRational{1, m_sampleRate}; }
+    int64_t TotalSamples() const { return static_cast<int64_t>(m_dataBytes / m_blockAlign); }
+    int64_t SamplesRead() const { return m_samplesRead; }
+
+    // Samples per returned frame, e.g. MediaWriter::GetAudioFrameSize() once open.
+    void SetSamplesPerFrame(int samples);
+
+    // Frames to prefetch ahead of the read position (default 16).
+    void SetReadahead(int frames) { m_readahead = frames > 0 ? frames : 0; }
+
+private:
+    void ParseHeader();
+
+    std::shared_ptr<MappedFile> m_file;
+    size_t m_dataOffset = 0;
+    size_t m_dataBytes = 0;
+    int m_samplesPerFrame;
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    uint64_t m_channelMask = 0;
+    size_t m_blockAlign = 0;
+    AVSampleFormat m_sampleFormat = AV_SAMPLE_FMT_NONE;
+    int64_t m_samplesRead = 0;
+    int m_readahead = 16;
+};
+
+} // namespace MediaEncoder
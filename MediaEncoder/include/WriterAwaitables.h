@@ -0,0 +1,84 @@
+#pragma once
+
+// C++20 awaitable front end of MediaWriter, built with
+// MEDIAENCODER_ENABLE_COROUTINES. Included by MediaWriter.h.
+//
+//     writer.SetResumeExecutor(ResumeOn(executor.CreateClient("capture")));
+//     co_await writer.EncodeVideoFrameAsync(&frame);
+//     co_await writer.CloseAsync();
+//
+// An await completes without suspending while the async queue has room;
+// only a full queue (or, for CloseAsync, frames still being encoded)
+// suspends the coroutine, which is then resumed through the writer's resume
+// executor instead of parking a thread. Errors are rethrown from co_await.
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace MediaEncoder {
+
+class MediaWriter;
+class ExecutorClient;
+
+// Schedules a resumption. Without one, coroutines resume on the writer's
+// encoding thread and must not block there.
+using ResumeExecutor = std::function<void(std::function<void()>)>;
+
+// Resumes on a strand of an Executor.
+ResumeExecutor ResumeOn(std::shared_ptr<ExecutorClient> client);
+
+// Result of EncodeVideoFrameAsync/EncodeAudioFrameAsync. Holds its own
+// reference to the frame's buffers until the writer has taken the frame.
+class WriterSubmitAwaitable {
+public:
+    WriterSubmitAwaitable(MediaWriter& writer, AVFrame* frame, bool video, const ResumeExecutor& resume);
+    ~WriterSubmitAwaitable();
+
+    WriterSubmitAwaitable(const WriterSubmitAwaitable&) = delete;
+    WriterSubmitAwaitable& operator=(const WriterSubmitAwaitable&) = delete;
+
+    bool await_ready() { return TrySubmit(); }
+    bool await_suspend(std::coroutine_handle<> handle) { return Wait(handle); }
+    void await_resume();
+
+private:
+    bool TrySubmit();
+    bool Wait(std::coroutine_handle<> handle);
+
+    MediaWriter& m_writer;
+    AVFrame* m_frame;
+    bool m_video;
+    const ResumeExecutor& m_resume;
+    std::exception_ptr m_error;
+};
+
+// Result of CloseAsync: waits for the queue to drain, then closes the
+// writer on the resume executor. Without one it closes on the awaiting
+// thread, like Close(), since the encoding thread cannot join itself.
+class WriterCloseAwaitable {
+public:
+    WriterCloseAwaitable(MediaWriter& writer, const ResumeExecutor& resume) : m_writer(writer), m_resume(resume) {}
+
+    WriterCloseAwaitable(const WriterCloseAwaitable&) = delete;
+    WriterCloseAwaitable& operator=(const WriterCloseAwaitable&) = delete;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume();
+
+private:
+    void Close();
+
+    MediaWriter& m_writer;
+    const ResumeExecutor& m_resume;
+    std::exception_ptr m_error;
+};
+
+} // namespace MediaEncoder
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+#include <libavutil/rational.h>
+}
+
+#include "MappedFile.h"
+#include "VideoFrame.h"
+
+namespace MediaEncoder {
+
+// Reads a YUV4MPEG2 (.y4m) file through a memory mapping. Each frame is a
+// read-only VideoFrame view over the mapped pages (tightly packed planes, no
+// row padding), so nothing is copied on the way to MediaWriter. Frames carry
+// pts = frame index in TimeBase(); pass that to MediaWriter::SetInputTimeBase().
+class Y4MReader {
+public:
+    explicit Y4MReader(const std::string& path);
+
+    // Returns false at end of file. Throws on a malformed or truncated frame.
+    bool ReadFrame(std::shared_ptr<VideoFrame>& frame);
+
+    int Width() const { return m_width; }
+    int Height() const { return m_height; }
+    AVPixelFormat PixelFormat() const { return m_pixelFormat; }
+    AVRational FrameRate() const { return m_frameRate; }
+    AVRational TimeBase() const { return av_inv_q(m_frameRate); }
+    AVRational SampleAspectRatio() const { return m_sampleAspect; }
+    int64_t FramesRead() const { return m_framesRead; }
+
+    // Frames to prefetch ahead of the read position (default 4).
+    void SetReadahead(int frames) { m_readahead = frames > 0 ? frames : 0; }
+
+private:
+    void ParseHeader();
+
+    std::shared_ptr<MappedFile> m_file;
+    size_t m_offset = 0;
+    size_t m_frameBytes = 0;
+    int m_width = 0;
+    int m_height = 0;
+    AVPixelFormat m_pixelFormat = AV_PIX_FMT_YUV420P;
+    AVRational m_frameRate{25, 1};
+    AVRational m_sampleAspect{0, 1};
+    int64_t m_framesRead = 0;
+    int m_readahead = 4;
+};
+
+} // namespace MediaEncoder
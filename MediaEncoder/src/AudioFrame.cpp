@@ -3,8 +3,10 @@
 
 namespace MediaEncoder
 {
-    AudioFrame::AudioFrame(int sampleRate, int channels, AVSampleFormat sampleFormat, int samples)
-        : m_disposed(false), m_channels(channels)
+    AudioFrame::AudioFrame(int sampleRate, int channels, AVSampleFormat sampleFormat, int samples,
+                           std::shared_ptr<FrameAllocator> allocator)
+        : m_disposed(false), m_channels(channels),
+          m_allocator(allocator ? std::move(allocator) : FrameAllocator::Default())
     {
         m_avFrame = av_frame_alloc();
         if (!m_avFrame)
@@ -23,14 +25,76 @@ namespace MediaEncoder
             throw std::runtime_error("Invalid default channel layout.");
         }
 
-        if (av_frame_get_buffer(m_avFrame, 0) < 0)
+        try
+        {
+            m_allocator->AllocateAudio(m_avFrame);
+        }
+        catch (...)
         {
             av_frame_free(&m_avFrame);
-            throw std::runtime_error("Failed to allocate audio buffer.");
+            throw;
         }
     }
 
+    AudioFrame::AudioFrame(const AVFrame* source)
+        : m_disposed(false), m_channels(source->ch_layout.nb_channels),
+          m_allocator(FrameAllocator::Default())
+    {
+        m_avFrame = av_frame_alloc();
+        if (!m_avFrame)
+            throw std::runtime_error("Failed to allocate AVFrame.");
+
+        // av_frame_ref() shares refcounted buffers and copies unowned ones.
+        if (av_frame_ref(m_avFrame, source) < 0)
+        {
+            av_frame_free(&m_avFrame);
+            throw std::runtime_error("Failed to reference AVFrame.");
+        }
+    }
+
+    AudioFrame::AudioFrame(const AudioFrame& other)
+        : AudioFrame(other.NativePointer())
+    {
+        m_channels = other.m_channels;
+        m_allocator = other.m_allocator;
+    }
+
+    AudioFrame::AudioFrame(AudioFrame&& other) noexcept
+        : m_avFrame(other.m_avFrame), m_disposed(other.m_disposed), m_channels(other.m_channels),
+          m_allocator(std::move(other.m_allocator))
+    {
+        other.m_avFrame = nullptr;
+        other.m_disposed = true;
+    }
+
+    AudioFrame& AudioFrame::operator=(const AudioFrame& other)
+    {
+        if (this == &other)
+            return *this;
+        AudioFrame copy(other);
+        return *this = std::move(copy);
+    }
+
+    AudioFrame& AudioFrame::operator=(AudioFrame&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        Release();
+        m_avFrame = other.m_avFrame;
+        m_disposed = other.m_disposed;
+        m_channels = other.m_channels;
+        m_allocator = std::move(other.m_allocator);
+        other.m_avFrame = nullptr;
+        other.m_disposed = true;
+        return *this;
+    }
+
     AudioFrame::~AudioFrame()
+    {
+        Release();
+    }
+
+    void AudioFrame::Release() noexcept
     {
         if (m_avFrame)
         {
@@ -39,6 +103,13 @@ namespace MediaEncoder
         m_disposed = true;
     }
 
+    std::shared_ptr<AudioFrame> AudioFrame::Wrap(const AVFrame* frame)
+    {
+        if (!frame)
+            throw std::invalid_argument("Cannot wrap a null AVFrame.");
+        return std::shared_ptr<AudioFrame>(new AudioFrame(frame));
+    }
+
     void AudioFrame::CheckIfDisposed() const
     {
         if (m_disposed)
@@ -48,23 +119,39 @@ namespace MediaEncoder
     void AudioFrame::FillFrame(const uint8_t* src)
     {
         CheckIfDisposed();
-        int bufferSize = av_samples_get_buffer_size(nullptr, m_channels, m_avFrame->nb_samples,
-                                                    static_cast<AVSampleFormat>(m_avFrame->format), 0);
-        if (bufferSize > 0)
-        {
-            std::memcpy(m_avFrame->data[0], src, bufferSize);
-        }
+        MakeWritable();
+
+        const AVSampleFormat format = static_cast<AVSampleFormat>(m_avFrame->format);
+        uint8_t* srcPlanes[AV_NUM_DATA_POINTERS] = {};
+        int srcLinesize = 0;
+        if (m_channels > AV_NUM_DATA_POINTERS && av_sample_fmt_is_planar(format))
+            throw std::runtime_error("Too many planar channels for FillFrame.");
+        if (av_samples_fill_arrays(srcPlanes, &srcLinesize, src, m_channels,
+                                   m_avFrame->nb_samples, format, 1) < 0)
+            throw std::runtime_error("Unsupported sample format for FillFrame.");
+
+        av_samples_copy(m_avFrame->extended_data, srcPlanes, 0, 0,
+                        m_avFrame->nb_samples, m_channels, format);
     }
 
     void AudioFrame::ClearFrame()
     {
         CheckIfDisposed();
-        int bufferSize = av_samples_get_buffer_size(nullptr, m_channels, m_avFrame->nb_samples,
-                                                    static_cast<AVSampleFormat>(m_avFrame->format), 0);
-        if (bufferSize > 0)
-        {
-            std::memset(m_avFrame->data[0], 0, bufferSize);
-        }
+        MakeWritable();
+        av_samples_set_silence(m_avFrame->extended_data, 0, m_avFrame->nb_samples, m_channels,
+                               static_cast<AVSampleFormat>(m_avFrame->format));
+    }
+
+    void AudioFrame::MakeWritable()
+    {
+        CheckIfDisposed();
+        m_allocator->MakeWritable(m_avFrame);
+    }
+
+    bool AudioFrame::IsWritable() const
+    {
+        CheckIfDisposed();
+        return av_frame_is_writable(m_avFrame) != 0;
     }
 
     int AudioFrame::SampleRate() const
@@ -118,4 +205,4 @@ namespace MediaEncoder
         CheckIfDisposed();
         return m_avFrame;
     }
-}
\ No newline at end of file
+}
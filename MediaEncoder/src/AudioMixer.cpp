@@ -0,0 +1,249 @@
+#include "AudioMixer.h"
+#include "MediaWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MEDIAENCODER_MIX_SSE 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAENCODER_MIX_NEON 1
+#endif
+
+namespace MediaEncoder {
+
+namespace {
+
+// dst[i] += src[i] * gain
+void MixScaled(float* dst, const float* src, float gain, size_t count) {
+    size_t i = 0;
+#if defined(MEDIAENCODER_MIX_SSE)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g));
+        __m128 b = _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g));
+        _mm_storeu_ps(dst + i, a);
+        _mm_storeu_ps(dst + i + 4, b);
+    }
+#elif defined(MEDIAENCODER_MIX_NEON)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), gain));
+        vst1q_f32(dst + i + 4, vmlaq_n_f32(vld1q_f32(dst + i + 4), vld1q_f32(src + i + 4), gain));
+    }
+#endif
+    for (; i < count; ++i) dst[i] += src[i] * gain;
+}
+
+// Clamps to [-1, 1]; NaN becomes -1 rather than reaching the encoder.
+void Clip(float* data, size_t count) {
+    size_t i = 0;
+#if defined(MEDIAENCODER_MIX_SSE)
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(data + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(data + i), lo), hi));
+    }
+#elif defined(MEDIAENCODER_MIX_NEON)
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        // vmaxq_f32 propagates NaN; the compare is false for it, selecting lo.
+        const float32x4_t v = vld1q_f32(data + i);
+        vst1q_f32(data + i, vminq_f32(vbslq_f32(vcgeq_f32(v, lo), v, lo), hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        float v = data[i];
+        data[i] = v > 1.0f ? 1.0f : (v >= -1.0f ? v : -1.0f);
+    }
+}
+
+} // namespace
+
+AudioMixer::AudioMixer(int sampleRate, int channels, int frameSize)
+    : m_sampleRate(sampleRate), m_channels(channels), m_frameSize(frameSize),
+      m_output(sampleRate, channels, AV_SAMPLE_FMT_FLTP, frameSize)
+{
+    if (sampleRate <= 0 || channels <= 0 || frameSize <= 0) throw std::invalid_argument("Invalid mixer format");
+    SetMaxLatency(100);
+}
+
+void AudioMixer::SetMaxLatency(int milliseconds) {
+    if (milliseconds < 0) throw std::invalid_argument("Mixer latency must not be negative");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxLeadSamples = static_cast<size_t>(static_cast<int64_t>(milliseconds) * m_sampleRate / 1000);
+}
+
+int AudioMixer::AddSource(const std::string& name, int sampleRate, int channels, AVSampleFormat format, float gain) {
+    if (sampleRate <= 0 || channels <= 0) throw std::invalid_argument("Invalid mixer source format");
+
+    auto source = std::make_unique<Source>();
+    source->name = name;
+    source->gain = gain;
+    source->channels = channels;
+    source->fifo.resize(static_cast<size_t>(m_channels));
+
+    // Float input at the mix rate and layout is deinterleaved directly;
+    // anything else goes through its own cached Resampler to packed float.
+    const bool direct = sampleRate == m_sampleRate && channels == m_channels &&
+                        (format == AV_SAMPLE_FMT_FLT || format == AV_SAMPLE_FMT_FLTP);
+    if (!direct) {
+        source->resampler = std::make_unique<Resampler>();
+        source->resampler->Initialize(channels, format, sampleRate, m_channels, AV_SAMPLE_FMT_FLT, m_sampleRate);
+    }
+    source->planar = direct && format == AV_SAMPLE_FMT_FLTP;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sources.push_back(std::move(source));
+    return static_cast<int>(m_sources.size() - 1);
+}
+
+AudioMixer::Source& AudioMixer::GetSource(int source) const {
+    if (source < 0 || static_cast<size_t>(source) >= m_sources.size() || !m_sources[source]->active)
+        throw std::invalid_argument("Unknown mixer source");
+    return *m_sources[source];
+}
+
+void AudioMixer::RemoveSource(int source) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Source& s = GetSource(source);
+    s.active = false;
+    for (auto& plane : s.fifo) std::vector<float>().swap(plane);
+    s.head = 0;
+}
+
+void AudioMixer::SetGain(int source, float gain) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    GetSource(source).gain = gain;
+}
+
+void AudioMixer::Push(int source, const uint8_t* const* data, int samples) {
+    if (samples <= 0) return;
+    Source* s;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s = &GetSource(source);
+    }
+
+    std::lock_guard<std::mutex> convertLock(s->convertMutex);
+    const float* const* planes = reinterpret_cast<const float* const*>(data);
+    const float* interleaved = planes[0];
+    if (s->resampler) {
+        int converted = 0;
+        interleaved = reinterpret_cast<const float*>(
+            s->resampler->Resample(const_cast<const uint8_t**>(data), samples, converted));
+        samples = converted;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!s->active || samples <= 0) return;
+    s->started = true;
+
+    // Data for time already mixed as silence is discarded.
+    const size_t drop = static_cast<size_t>(std::min<uint64_t>(s->deficit, static_cast<uint64_t>(samples)));
+    s->deficit -= drop;
+    s->droppedSamples += drop;
+    const size_t count = static_cast<size_t>(samples) - drop;
+    if (count == 0) return;
+
+    for (int ch = 0; ch < m_channels; ++ch) {
+        std::vector<float>& fifo = s->fifo[ch];
+        const size_t start = fifo.size();
+        fifo.resize(start + count);
+        if (s->planar) {
+            std::memcpy(fifo.data() + start, planes[ch] + drop, count * sizeof(float));
+        } else {
+            const float* in = interleaved + drop * m_channels + ch;
+            for (size_t i = 0; i < count; ++i) fifo[start + i] = in[i * m_channels];
+        }
+    }
+}
+
+AudioFrame* AudioMixer::ReadFrame(bool force) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const size_t frameSize = static_cast<size_t>(m_frameSize);
+
+    size_t least = SIZE_MAX;
+    size_t most = 0;
+    for (const auto& source : m_sources) {
+        if (!source->active) continue;
+        least = std::min(least, source->Buffered());
+        most = std::max(most, source->Buffered());
+    }
+    if (least == SIZE_MAX) least = 0;
+    const bool due = least >= frameSize || most >= frameSize + m_maxLeadSamples;
+    if (!force && !due) return nullptr;
+
+    m_output.MakeWritable();
+    AVFrame* out = m_output.NativePointer();
+    out->nb_samples = m_frameSize;
+    for (int ch = 0; ch < m_channels; ++ch) std::memset(out->extended_data[ch], 0, frameSize * sizeof(float));
+
+    for (auto& source : m_sources) {
+        if (!source->active) continue;
+        const size_t take = std::min(source->Buffered(), frameSize);
+        if (take) {
+            for (int ch = 0; ch < m_channels; ++ch) {
+                MixScaled(reinterpret_cast<float*>(out->extended_data[ch]),
+                          source->fifo[ch].data() + source->head, source->gain, take);
+            }
+            source->head += take;
+        }
+        if (take < frameSize && source->started) {
+            const uint64_t cap = std::max<uint64_t>(m_maxLeadSamples, frameSize);
+            source->deficit = std::min<uint64_t>(source->deficit + frameSize - take, cap);
+            source->silenceSamples += frameSize - take;
+        }
+
+        // Reclaim consumed samples once they dominate the FIFO.
+        if (source->head >= 4 * frameSize && source->head * 2 >= source->fifo[0].size()) {
+            for (auto& plane : source->fifo) plane.erase(plane.begin(), plane.begin() + source->head);
+            source->head = 0;
+        }
+    }
+
+    for (int ch = 0; ch < m_channels; ++ch) Clip(reinterpret_cast<float*>(out->extended_data[ch]), frameSize);
+    out->pts = m_pts;
+    m_pts += m_frameSize;
+    return &m_output;
+}
+
+size_t AudioMixer::Pump(MediaWriter& writer, bool flush) {
+    size_t frames = 0;
+    while (AudioFrame* frame = ReadFrame(false)) {
+        writer.EncodeAudioFrame(frame);
+        ++frames;
+    }
+    while (flush) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            flush = std::any_of(m_sources.begin(), m_sources.end(),
+                                [](const std::unique_ptr<Source>& s) { return s->active && s->Buffered() > 0; });
+        }
+        if (!flush) break;
+        writer.EncodeAudioFrame(ReadFrame(true));
+        ++frames;
+    }
+    return frames;
+}
+
+std::vector<AudioMixerSourceStats> AudioMixer::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<AudioMixerSourceStats> stats;
+    for (const auto& source : m_sources) {
+        if (!source->active) continue;
+        AudioMixerSourceStats entry;
+        entry.name = source->name;
+        entry.gain = source->gain;
+        entry.bufferedSamples = source->Buffered();
+        entry.silenceSamples = source->silenceSamples;
+        entry.droppedSamples = source->droppedSamples;
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,184 @@
+#include "Executor.h"
+
+#include <algorithm>
+
+namespace MediaEncoder {
+
+namespace {
+// Identifies the executor worker running on the current thread, if any.
+thread_local const Executor* t_executor = nullptr;
+thread_local size_t t_worker = 0;
+
+// Tasks a client runs before yielding its worker to other clients.
+constexpr int kBatchSize = 8;
+}
+
+ExecutorClient::ExecutorClient(Executor& executor, std::string name)
+    : m_executor(executor), m_name(std::move(name)) {}
+
+void ExecutorClient::Post(std::function<void()> task) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+        if (!m_scheduled) {
+            m_scheduled = true;
+            schedule = true;
+        }
+    }
+    if (schedule) m_executor.Schedule(shared_from_this());
+}
+
+size_t ExecutorClient::QueueDepth() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+void ExecutorClient::RunBatch() {
+    for (int i = 0; i < kBatchSize; ++i) {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_tasks.empty()) {
+                m_scheduled = false;
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        // Tasks report their own errors; one failing writer must not take down a worker.
+        try {
+            task();
+        } catch (...) {
+        }
+        m_tasksRun.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tasks.empty()) {
+            m_scheduled = false;
+            return;
+        }
+    }
+    m_executor.Schedule(shared_from_this());
+}
+
+Executor::Executor(size_t workerCount, const PlacementOptions& placement)
+    : m_placement(Placement::Resolve(placement))
+{
+    if (workerCount == 0) {
+        workerCount = m_placement.cpus.empty() ? std::max(1u, std::thread::hardware_concurrency())
+                                               : m_placement.cpus.size();
+    }
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&Executor::WorkerLoop, this, i);
+    }
+}
+
+Executor::~Executor() {
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_stop = true;
+    }
+    m_idleCv.notify_all();
+    for (auto& worker : m_workers) worker.join();
+}
+
+Executor& Executor::Shared() {
+    static Executor executor;
+    return executor;
+}
+
+std::shared_ptr<ExecutorClient> Executor::CreateClient(const std::string& name) {
+    auto client = std::make_shared<ExecutorClient>(*this, name);
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                   [](const std::weak_ptr<ExecutorClient>& c) { return c.expired(); }),
+                    m_clients.end());
+    m_clients.push_back(client);
+    return client;
+}
+
+std::vector<Executor::ClientStats> Executor::GetStats() const {
+    std::vector<ClientStats> stats;
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    for (const auto& weak : m_clients) {
+        if (auto client = weak.lock()) {
+            ClientStats entry;
+            entry.name = client->Name();
+            entry.queueDepth = client->QueueDepth();
+            entry.tasksRun = client->TasksRun();
+            entry.steals = client->Steals();
+            stats.push_back(std::move(entry));
+        }
+    }
+    return stats;
+}
+
+// Workers push follow-up work onto their own deque; other threads spread
+// work round-robin.
+void Executor::Schedule(std::shared_ptr<ExecutorClient> client) {
+    size_t target = t_executor == this
+        ? t_worker
+        : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    {
+        std::lock_guard<std::mutex> lock(m_queues[target]->mutex);
+        m_queues[target]->jobs.push_back(Job{std::move(client)});
+    }
+    m_pending.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+    }
+    m_idleCv.notify_one();
+}
+
+bool Executor::TryPop(size_t worker, Job& job, bool& stolen) {
+    {
+        WorkerQueue& own = *m_queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.front());
+            own.jobs.pop_front();
+            stolen = false;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < m_queues.size(); ++i) {
+        WorkerQueue& victim = *m_queues[(worker + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::WorkerLoop(size_t worker) {
+    t_executor = this;
+    t_worker = worker;
+    Placement::ApplyToCurrentThread(m_placement);
+
+    while (true) {
+        Job job;
+        bool stolen = false;
+        if (TryPop(worker, job, stolen)) {
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+            if (stolen) job.client->m_steals.fetch_add(1, std::memory_order_relaxed);
+            job.client->RunBatch();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleCv.wait(lock, [this] { return m_stop || m_pending.load(std::memory_order_acquire) > 0; });
+        if (m_stop && m_pending.load(std::memory_order_acquire) == 0) return;
+    }
+}
+
+} // namespace MediaEncoder
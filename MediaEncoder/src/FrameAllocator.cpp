@@ -0,0 +1,337 @@
+#include "FrameAllocator.h"
+
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include <sys/mman.h>
+
+namespace MediaEncoder {
+
+namespace {
+
+// Slack after the last plane for SIMD over-reads (AV_INPUT_BUFFER_PADDING_SIZE).
+constexpr size_t kPadding = 64;
+constexpr size_t kHugePageSize = size_t(2) << 20;
+
+size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+uint8_t* AlignPointer(void* pointer, size_t alignment) {
+    return reinterpret_cast<uint8_t*>(RoundUp(reinterpret_cast<uintptr_t>(pointer), alignment));
+}
+
+class HeapAllocator : public FrameAllocator {
+public:
+    explicit HeapAllocator(size_t alignment) : FrameAllocator(alignment) {}
+
+    AVBufferRef* Allocate(size_t size) override { return AllocateFromHeap(size, false); }
+    const char* Name() const override { return "heap"; }
+};
+
+class HugePageAllocator : public FrameAllocator {
+public:
+    HugePageAllocator(HugePageMode mode, size_t alignment) : FrameAllocator(alignment), m_mode(mode) {}
+
+    AVBufferRef* Allocate(size_t size) override {
+        if (size < kHugePageSize / 2) return AllocateFromHeap(size, true);
+
+        const size_t length = RoundUp(size, kHugePageSize);
+        void* base = MAP_FAILED;
+#if defined(__linux__) && defined(MAP_HUGETLB)
+        if (m_mode == HugePageMode::Explicit)
+            base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (base == MAP_FAILED) base = MapAligned(length);
+        if (base == MAP_FAILED) return AllocateFromHeap(size, true);
+        return Track(static_cast<uint8_t*>(base), size, base, length, false);
+    }
+
+    const char* Name() const override {
+        return m_mode == HugePageMode::Explicit ? "hugetlb" : "thp";
+    }
+
+protected:
+    void Release(void* base, size_t length) override { munmap(base, length); }
+
+private:
+    // Over-maps by one huge page and trims both ends so the range can be
+    // backed by huge pages from its first byte.
+    static void* MapAligned(size_t length) {
+        void* raw = mmap(nullptr, length + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return MAP_FAILED;
+
+        uint8_t* begin = static_cast<uint8_t*>(raw);
+        uint8_t* aligned = AlignPointer(raw, kHugePageSize);
+        uint8_t* end = begin + length + kHugePageSize;
+        if (aligned > begin) munmap(begin, aligned - begin);
+        if (end > aligned + length) munmap(aligned + length, end - (aligned + length));
+#if defined(MADV_HUGEPAGE)
+        madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+        return aligned;
+    }
+
+    const HugePageMode m_mode;
+};
+
+class ArenaAllocator : public FrameAllocator {
+public:
+    ArenaAllocator(size_t chunkSize, size_t alignment) : FrameAllocator(alignment), m_chunkSize(chunkSize) {
+        if (chunkSize == 0) throw std::invalid_argument("Arena chunk size must be positive");
+    }
+
+    ~ArenaAllocator() override {
+        for (auto& chunk : m_chunks) av_free(chunk.base);
+    }
+
+    AVBufferRef* Allocate(size_t size) override {
+        const size_t need = RoundUp(size, Alignment());
+        if (need > m_chunkSize) return AllocateFromHeap(size, true);
+
+        uint8_t* data;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_current == m_chunks.size() || m_chunks[m_current].used + need > m_chunkSize) {
+                m_current = 0;
+                while (m_current < m_chunks.size() && m_chunks[m_current].used + need > m_chunkSize) ++m_current;
+            }
+            if (m_current == m_chunks.size()) {
+                void* base = av_malloc(m_chunkSize + Alignment());
+                if (!base) throw std::runtime_error("Failed to allocate arena chunk");
+                m_chunks.push_back({base, AlignPointer(base, Alignment()), 0, 0});
+            }
+            Chunk& chunk = m_chunks[m_current];
+            data = chunk.data + chunk.used;
+            chunk.used += need;
+            ++chunk.live;
+        }
+        return Track(data, size, data, need, false);
+    }
+
+    const char* Name() const override { return "arena"; }
+
+protected:
+    // A chunk is rewound once none of its buffers is referenced any more,
+    // so a long-lived frame pins only the chunk it came from.
+    void Release(void* base, size_t) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint8_t* data = static_cast<const uint8_t*>(base);
+        for (auto& chunk : m_chunks) {
+            if (data < chunk.data || data >= chunk.data + m_chunkSize) continue;
+            if (--chunk.live == 0) chunk.used = 0;
+            return;
+        }
+    }
+
+    // Copies made for writing usually outlive the session's frames.
+    std::shared_ptr<FrameAllocator> CopyAllocator() override { return Default(); }
+
+private:
+    struct Chunk {
+        void* base;
+        uint8_t* data;
+        size_t used;
+        size_t live;    // buffers not yet released
+    };
+
+    const size_t m_chunkSize;
+    std::mutex m_mutex;
+    std::vector<Chunk> m_chunks;
+    size_t m_current = 0;
+};
+
+std::mutex g_defaultMutex;
+std::shared_ptr<FrameAllocator> g_default;
+
+} // namespace
+
+struct FrameAllocator::Allocation {
+    std::shared_ptr<FrameAllocator> owner;
+    void* base;
+    size_t length;
+    size_t size;
+    bool heap;
+};
+
+FrameAllocator::FrameAllocator(size_t alignment)
+    : m_alignment(alignment)
+{
+    if (alignment < 16 || alignment > 64 || (alignment & (alignment - 1)))
+        throw std::invalid_argument("Frame alignment must be 16, 32 or 64 bytes");
+}
+
+std::shared_ptr<FrameAllocator> FrameAllocator::Default() {
+    std::lock_guard<std::mutex> lock(g_defaultMutex);
+    if (!g_default) g_default = CreateHeap();
+    return g_default;
+}
+
+void FrameAllocator::SetDefault(std::shared_ptr<FrameAllocator> allocator) {
+    std::lock_guard<std::mutex> lock(g_defaultMutex);
+    g_default = std::move(allocator);
+}
+
+std::shared_ptr<FrameAllocator> FrameAllocator::CreateHeap(size_t alignment) {
+    return std::make_shared<HeapAllocator>(alignment);
+}
+
+std::shared_ptr<FrameAllocator> FrameAllocator::CreateHugePage(HugePageMode mode, size_t alignment) {
+    return std::make_shared<HugePageAllocator>(mode, alignment);
+}
+
+std::shared_ptr<FrameAllocator> FrameAllocator::CreateArena(size_t chunkSize, size_t alignment) {
+    return std::make_shared<ArenaAllocator>(chunkSize, alignment);
+}
+
+FrameAllocatorStats FrameAllocator::Stats() const {
+    FrameAllocatorStats stats;
+    stats.allocations = m_allocations.load(std::memory_order_relaxed);
+    stats.bytesAllocated = m_bytesAllocated.load(std::memory_order_relaxed);
+    stats.bytesLive = m_bytesLive.load(std::memory_order_relaxed);
+    stats.fallbacks = m_fallbacks.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AVBufferRef* FrameAllocator::Track(uint8_t* data, size_t size, void* base, size_t length, bool heap) {
+    auto* allocation = new Allocation{shared_from_this(), base, length, size, heap};
+    m_bytesLive.fetch_add(size, std::memory_order_relaxed);
+    AVBufferRef* buffer = av_buffer_create(data, size, &FrameAllocator::FreeAllocation, allocation, 0);
+    if (!buffer) {
+        FreeAllocation(allocation, data);
+        throw std::runtime_error("Failed to allocate frame buffer");
+    }
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    m_bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    return buffer;
+}
+
+void FrameAllocator::FreeAllocation(void* opaque, uint8_t*) {
+    std::unique_ptr<Allocation> allocation(static_cast<Allocation*>(opaque));
+    FrameAllocator& owner = *allocation->owner;
+    if (allocation->heap) av_free(allocation->base);
+    else owner.Release(allocation->base, allocation->length);
+    owner.m_bytesLive.fetch_sub(allocation->size, std::memory_order_relaxed);
+}
+
+AVBufferRef* FrameAllocator::AllocateFromHeap(size_t size, bool fallback) {
+    void* base = av_malloc(size + m_alignment);
+    if (!base) throw std::runtime_error("Failed to allocate frame buffer");
+    if (fallback) m_fallbacks.fetch_add(1, std::memory_order_relaxed);
+    return Track(AlignPointer(base, m_alignment), size, base, size + m_alignment, true);
+}
+
+void FrameAllocator::AllocateVideo(AVFrame* frame) {
+    const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    if (frame->width <= 0 || frame->height <= 0 || !av_pix_fmt_desc_get(format))
+        throw std::invalid_argument("Invalid video frame geometry");
+
+    // Widen the lines until each is a multiple of the alignment, as
+    // av_frame_get_buffer() does.
+    for (size_t step = 1; step <= m_alignment; step *= 2) {
+        const int width = static_cast<int>(RoundUp(static_cast<size_t>(frame->width), step));
+        if (av_image_fill_linesizes(frame->linesize, format, width) < 0)
+            throw std::runtime_error("Unsupported pixel format");
+        bool aligned = true;
+        for (int i = 0; i < 4; ++i) aligned = aligned && frame->linesize[i] % m_alignment == 0;
+        if (aligned) break;
+    }
+
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; ++i) linesizes[i] = frame->linesize[i];
+    size_t planeSizes[4] = {};
+    if (av_image_fill_plane_sizes(planeSizes, format, frame->height, linesizes) < 0)
+        throw std::runtime_error("Unsupported pixel format");
+
+    size_t offsets[4];
+    size_t total = 0;
+    for (int i = 0; i < 4; ++i) {
+        offsets[i] = total;
+        total += RoundUp(planeSizes[i], m_alignment);
+    }
+
+    AVBufferRef* buffer = Allocate(total + kPadding);
+    frame->buf[0] = buffer;
+    for (int i = 0; i < 4; ++i) frame->data[i] = planeSizes[i] ? buffer->data + offsets[i] : nullptr;
+    frame->extended_data = frame->data;
+}
+
+void FrameAllocator::AllocateAudio(AVFrame* frame) {
+    const AVSampleFormat format = static_cast<AVSampleFormat>(frame->format);
+    const int channels = frame->ch_layout.nb_channels;
+    if (frame->nb_samples <= 0 || channels <= 0 || av_get_bytes_per_sample(format) <= 0)
+        throw std::invalid_argument("Invalid audio frame geometry");
+
+    const int planes = av_sample_fmt_is_planar(format) ? channels : 1;
+    int linesize = 0;
+    if (av_samples_get_buffer_size(&linesize, channels, frame->nb_samples, format, static_cast<int>(m_alignment)) < 0)
+        throw std::runtime_error("Failed to compute audio buffer size");
+
+    AVBufferRef* buffer = Allocate(static_cast<size_t>(linesize) * planes + kPadding);
+    if (planes > AV_NUM_DATA_POINTERS) {
+        frame->extended_data = static_cast<uint8_t**>(av_calloc(planes, sizeof(uint8_t*)));
+        if (!frame->extended_data) {
+            frame->extended_data = frame->data;
+            av_buffer_unref(&buffer);
+            throw std::runtime_error("Failed to allocate channel pointers");
+        }
+    } else {
+        frame->extended_data = frame->data;
+    }
+
+    frame->buf[0] = buffer;
+    frame->linesize[0] = linesize;
+    for (int p = 0; p < planes; ++p) {
+        frame->extended_data[p] = buffer->data + static_cast<size_t>(p) * linesize;
+        if (p < AV_NUM_DATA_POINTERS) frame->data[p] = frame->extended_data[p];
+    }
+}
+
+std::shared_ptr<FrameAllocator> FrameAllocator::CopyAllocator() {
+    return shared_from_this();
+}
+
+void FrameAllocator::MakeWritable(AVFrame* frame) {
+    if (av_frame_is_writable(frame)) return;
+
+    std::shared_ptr<FrameAllocator> target = CopyAllocator();
+    if (target.get() != this) m_fallbacks.fetch_add(1, std::memory_order_relaxed);
+
+    AVFrame* copy = av_frame_alloc();
+    if (!copy) throw std::runtime_error("Failed to allocate AVFrame");
+    copy->format = frame->format;
+    copy->width = frame->width;
+    copy->height = frame->height;
+    copy->nb_samples = frame->nb_samples;
+    copy->sample_rate = frame->sample_rate;
+
+    try {
+        if (frame->width > 0 && frame->height > 0) {
+            target->AllocateVideo(copy);
+        } else {
+            if (av_channel_layout_copy(&copy->ch_layout, &frame->ch_layout) < 0)
+                throw std::runtime_error("Failed to copy channel layout");
+            target->AllocateAudio(copy);
+        }
+        if (av_frame_copy(copy, frame) < 0 || av_frame_copy_props(copy, frame) < 0)
+            throw std::runtime_error("Failed to copy frame");
+    } catch (...) {
+        av_frame_free(&copy);
+        throw;
+    }
+
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, copy);
+    av_frame_free(&copy);
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,110 @@
+#include "FrameHash.h"
+
+#include <cstring>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace MediaEncoder {
+
+// xxHash64-style mixing. The main loop keeps four independent accumulators
+// over 32-byte stripes, so the multiplies pipeline (and vectorize where the
+// target has 64-bit vector multiplies) instead of forming one serial chain.
+namespace {
+constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t Load64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = RotateLeft(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t Merge(uint64_t acc, uint64_t lane) {
+    acc ^= Round(0, lane);
+    return acc * kPrime1 + kPrime4;
+}
+}
+
+uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t seed) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = Round(v1, Load64(p));
+            v2 = Round(v2, Load64(p + 8));
+            v3 = Round(v3, Load64(p + 16));
+            v4 = Round(v4, Load64(p + 24));
+        }
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = Merge(hash, v1);
+        hash = Merge(hash, v2);
+        hash = Merge(hash, v3);
+        hash = Merge(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Load64(p));
+        hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    for (; p < end; ++p) {
+        hash ^= (*p) * kPrime5;
+        hash = RotateLeft(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t HashVideoFrame(const AVFrame* frame) {
+    const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM))) return 0;
+
+    uint64_t hash = 0;
+    const int planes = av_pix_fmt_count_planes(format);
+    for (int plane = 0; plane < planes; ++plane) {
+        const int rowBytes = av_image_get_linesize(format, frame->width, plane);
+        if (rowBytes <= 0 || !frame->data[plane]) return 0;
+
+        // Chroma planes of subsampled formats (never the luma or alpha plane).
+        const bool chroma = (plane == 1 || plane == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+        const int rows = chroma ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+
+        const uint8_t* row = frame->data[plane];
+        for (int y = 0; y < rows; ++y, row += frame->linesize[plane]) {
+            hash = HashBytes(row, static_cast<size_t>(rowBytes), hash);
+        }
+    }
+    return hash;
+}
+
+} // namespace MediaEncoder
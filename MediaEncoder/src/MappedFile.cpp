@@ -0,0 +1,78 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace MediaEncoder {
+
+namespace {
+
+struct MappingReference {
+    std::shared_ptr<MappedFile> file;
+};
+
+void ReleaseMapping(void* opaque, uint8_t*) {
+    delete static_cast<MappingReference*>(opaque);
+}
+
+} // namespace
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        throw std::runtime_error("Could not map empty or unreadable file " + path);
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("mmap failed for " + path + ": " + std::strerror(errno));
+
+    // Raw media is read front to back exactly once.
+    madvise(data, size, MADV_SEQUENTIAL);
+    return std::shared_ptr<MappedFile>(new MappedFile(path, static_cast<const uint8_t*>(data), size));
+}
+
+MappedFile::MappedFile(std::string path, const uint8_t* data, size_t size)
+    : m_path(std::move(path)), m_data(data), m_size(size)
+{
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+void MappedFile::WillNeed(size_t offset, size_t length) const {
+    if (offset >= m_size) return;
+    if (length > m_size - offset) length = m_size - offset;
+
+    // madvise wants a page-aligned start.
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start = offset / page * page;
+    madvise(const_cast<uint8_t*>(m_data) + start, length + (offset - start), MADV_WILLNEED);
+}
+
+AVBufferRef* MappedFile::Reference(size_t offset, size_t length) {
+    if (offset > m_size || length > m_size - offset) throw std::runtime_error("Mapped range is past the end of " + m_path);
+
+    auto* ref = new MappingReference{shared_from_this()};
+    AVBufferRef* buffer = av_buffer_create(const_cast<uint8_t*>(m_data) + offset, length,
+                                           &ReleaseMapping, ref, AV_BUFFER_FLAG_READONLY);
+    if (!buffer) {
+        delete ref;
+        throw std::bad_alloc();
+    }
+    return buffer;
+}
+
+} // namespace MediaEncoder
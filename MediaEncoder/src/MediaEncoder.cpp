@@ -1,10 +1,11 @@
-
 #include "MediaEncoder.h"
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <cstring>
 #include <memory>
+#include <algorithm>
+#include <cctype>
 extern "C" {
     #include <libavformat/avformat.h>
     #include <libavcodec/avcodec.h>
@@ -17,39 +18,215 @@ extern "C" {
 
 namespace MediaEncoder
 {
-    std::vector<std::string> MediaFormat::GetAllFormatLongNames()
+    namespace
+    {
+        std::vector<std::string> SplitList(const char* list)
+        {
+            std::vector<std::string> items;
+            if (!list) return items;
+            std::string item;
+            for (const char* p = list; ; ++p)
+            {
+                if (*p == ',' || *p == '\0')
+                {
+                    if (!item.empty()) items.push_back(item);
+                    item.clear();
+                    if (*p == '\0') break;
+                }
+                else
+                {
+                    item += static_cast<char>(std::tolower(static_cast<unsigned char>(*p)));
+                }
+            }
+            return items;
+        }
+
+        // External encoder wrappers that are often missing from a build,
+        // mapped to the codec they implement so another encoder can stand in.
+        AVCodecID WrapperCodec(const std::string& name)
+        {
+            static const std::unordered_map<std::string, AVCodecID> wrappers = {
+                {"libx264", AV_CODEC_ID_H264}, {"libx264rgb", AV_CODEC_ID_H264},
+                {"libopenh264", AV_CODEC_ID_H264}, {"libx265", AV_CODEC_ID_HEVC},
+                {"libvpx", AV_CODEC_ID_VP8}, {"libvpx-vp9", AV_CODEC_ID_VP9},
+                {"libaom-av1", AV_CODEC_ID_AV1}, {"libsvtav1", AV_CODEC_ID_AV1},
+                {"librav1e", AV_CODEC_ID_AV1}, {"libfdk_aac", AV_CODEC_ID_AAC},
+                {"libmp3lame", AV_CODEC_ID_MP3}, {"libshine", AV_CODEC_ID_MP3},
+                {"libopus", AV_CODEC_ID_OPUS}, {"libvorbis", AV_CODEC_ID_VORBIS},
+            };
+            auto it = wrappers.find(name);
+            return it != wrappers.end() ? it->second : AV_CODEC_ID_NONE;
+        }
+
+        int EncoderRank(const EncoderInfo& encoder)
+        {
+            return (encoder.experimental ? 2 : 0) + (encoder.hardware ? 1 : 0);
+        }
+    }
+
+    CapabilityIndex::CapabilityIndex()
     {
-        std::vector<std::string> ret;
         const AVOutputFormat* fmt = nullptr;
-        void* i = nullptr;
+        void* muxerIt = nullptr;
+        while ((fmt = av_muxer_iterate(&muxerIt)))
+        {
+            MuxerInfo info;
+            info.format = fmt;
+            info.name = fmt->name;
+            info.longName = fmt->long_name ? fmt->long_name : "";
+            info.extensions = SplitList(fmt->extensions);
+            info.defaultVideoCodec = fmt->video_codec;
+            info.defaultAudioCodec = fmt->audio_codec;
+
+            size_t index = m_muxers.size();
+            m_muxersByName.emplace(info.name, index);
+            // The first muxer registered for an extension wins, matching av_guess_format.
+            for (const auto& ext : info.extensions) m_muxersByExtension.emplace(ext, index);
+            m_muxers.push_back(std::move(info));
+        }
 
-        while ((fmt = av_muxer_iterate(&i)))
+        const AVCodec* codec = nullptr;
+        void* codecIt = nullptr;
+        while ((codec = av_codec_iterate(&codecIt)))
         {
-            ret.emplace_back(fmt->long_name);
-            ret.emplace_back(fmt->name);
+            if (!av_codec_is_encoder(codec)) continue;
+            EncoderInfo info;
+            info.codec = codec;
+            info.name = codec->name;
+            info.id = codec->id;
+            info.type = codec->type;
+            info.hardware = (codec->capabilities & AV_CODEC_CAP_HARDWARE) != 0;
+            info.experimental = (codec->capabilities & AV_CODEC_CAP_EXPERIMENTAL) != 0;
+            m_encodersByName.emplace(info.name, m_encoders.size());
+            m_encoders.push_back(std::move(info));
+        }
+
+        // Pointers into m_encoders are taken only once it no longer grows.
+        for (const auto& encoder : m_encoders) m_encodersById[encoder.id].push_back(&encoder);
+        for (auto& entry : m_encodersById)
+        {
+            std::stable_sort(entry.second.begin(), entry.second.end(),
+                             [](const EncoderInfo* a, const EncoderInfo* b) { return EncoderRank(*a) < EncoderRank(*b); });
+        }
+
+        m_support.resize(m_muxers.size());
+        for (size_t i = 0; i < m_muxers.size(); ++i)
+        {
+            for (const auto& entry : m_encodersById)
+            {
+                int result = avformat_query_codec(m_muxers[i].format, static_cast<AVCodecID>(entry.first),
+                                                  FF_COMPLIANCE_NORMAL);
+                m_support[i][entry.first] = result > 0 ? CodecSupport::Supported
+                                          : result == 0 ? CodecSupport::Unsupported
+                                          : CodecSupport::Unknown;
+            }
+        }
+    }
+
+    const CapabilityIndex& CapabilityIndex::Get()
+    {
+        static const CapabilityIndex index;
+        return index;
+    }
+
+    const MuxerInfo* CapabilityIndex::FindMuxer(const std::string& name) const
+    {
+        auto it = m_muxersByName.find(name);
+        return it != m_muxersByName.end() ? &m_muxers[it->second] : nullptr;
+    }
+
+    const MuxerInfo* CapabilityIndex::FindMuxerByExtension(const std::string& extension) const
+    {
+        std::string ext = extension;
+        std::transform(ext.begin(), ext.end(), ext.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        auto it = m_muxersByExtension.find(ext);
+        return it != m_muxersByExtension.end() ? &m_muxers[it->second] : nullptr;
+    }
+
+    const MuxerInfo* CapabilityIndex::GuessMuxer(const std::string& format, const std::string& url) const
+    {
+        if (!format.empty()) return FindMuxer(format);
+
+        size_t dot = url.find_last_of('.');
+        size_t slash = url.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return nullptr;
+        return FindMuxerByExtension(url.substr(dot + 1));
+    }
+
+    const EncoderInfo* CapabilityIndex::FindEncoder(const std::string& name) const
+    {
+        auto it = m_encodersByName.find(name);
+        return it != m_encodersByName.end() ? &m_encoders[it->second] : nullptr;
+    }
+
+    const std::vector<const EncoderInfo*>& CapabilityIndex::EncodersFor(AVCodecID id) const
+    {
+        static const std::vector<const EncoderInfo*> none;
+        auto it = m_encodersById.find(id);
+        return it != m_encodersById.end() ? it->second : none;
+    }
+
+    const EncoderInfo* CapabilityIndex::ResolveEncoder(const std::string& name) const
+    {
+        if (const EncoderInfo* encoder = FindEncoder(name)) return encoder;
+
+        AVCodecID id = WrapperCodec(name);
+        if (id == AV_CODEC_ID_NONE)
+        {
+            // Codec names ("h264") and hardware wrappers ("h264_nvenc").
+            const AVCodecDescriptor* desc = avcodec_descriptor_get_by_name(name.c_str());
+            if (!desc) desc = avcodec_descriptor_get_by_name(name.substr(0, name.find('_')).c_str());
+            if (desc) id = desc->id;
+        }
+        const auto& candidates = EncodersFor(id);
+        return candidates.empty() ? nullptr : candidates.front();
+    }
+
+    CodecSupport CapabilityIndex::Supports(const MuxerInfo& muxer, AVCodecID codec) const
+    {
+        size_t index = static_cast<size_t>(&muxer - m_muxers.data());
+        if (index < m_support.size())
+        {
+            auto it = m_support[index].find(codec);
+            if (it != m_support[index].end()) return it->second;
+        }
+        int result = avformat_query_codec(muxer.format, codec, FF_COMPLIANCE_NORMAL);
+        return result > 0 ? CodecSupport::Supported : result == 0 ? CodecSupport::Unsupported : CodecSupport::Unknown;
+    }
+
+    std::vector<std::string> MediaFormat::GetAllFormatLongNames()
+    {
+        std::vector<std::string> ret;
+        const auto& muxers = CapabilityIndex::Get().Muxers();
+        ret.reserve(muxers.size() * 2);
+        for (const auto& muxer : muxers)
+        {
+            ret.emplace_back(muxer.longName);
+            ret.emplace_back(muxer.name);
         }
         return ret;
     }
 
     std::string MediaFormat::GetFormatExtensions(const std::string& format)
     {
-        const AVOutputFormat* fmt = av_guess_format(format.c_str(), nullptr, nullptr);
-        return fmt ? fmt->extensions : "";
+        const MuxerInfo* muxer = CapabilityIndex::Get().FindMuxer(format);
+        return muxer && muxer->format->extensions ? muxer->format->extensions : "";
     }
 
     std::string MediaFormat::GetFormatLongName(const std::string& format)
     {
-        const AVOutputFormat* fmt = av_guess_format(format.c_str(), nullptr, nullptr);
-        return fmt ? fmt->long_name : "";
+        const MuxerInfo* muxer = CapabilityIndex::Get().FindMuxer(format);
+        return muxer ? muxer->longName : "";
     }
 
     void MediaFormat::GetFormatInfo(const std::string& format, std::string& longName, std::string& extensions)
     {
-        const AVOutputFormat* fmt = av_guess_format(format.c_str(), nullptr, nullptr);
-        if (fmt)
+        const MuxerInfo* muxer = CapabilityIndex::Get().FindMuxer(format);
+        if (muxer)
         {
-            longName = fmt->long_name;
-            extensions = fmt->extensions;
+            longName = muxer->longName;
+            extensions = muxer->format->extensions ? muxer->format->extensions : "";
         }
         else
         {
@@ -57,4 +234,35 @@ namespace MediaEncoder
             extensions.clear();
         }
     }
-} // namespace MediaEncoder
\ No newline at end of file
+
+    OutputPlan MediaFormat::Validate(const std::string& url, const std::string& format,
+                                     const std::string& videoEncoder, const std::string& audioEncoder)
+    {
+        const CapabilityIndex& index = CapabilityIndex::Get();
+        OutputPlan plan;
+
+        plan.muxer = index.GuessMuxer(format, url);
+        if (!plan.muxer)
+        {
+            throw std::invalid_argument(format.empty() ? "Cannot guess the output format of " + url
+                                                       : "Unknown output format " + format);
+        }
+
+        auto resolve = [&](const std::string& name, AVMediaType type, const char* kind) -> const EncoderInfo*
+        {
+            if (name.empty()) return nullptr;
+            const EncoderInfo* encoder = index.ResolveEncoder(name);
+            if (!encoder) throw std::invalid_argument(std::string(kind) + " encoder not found: " + name);
+            if (encoder->type != type) throw std::invalid_argument(name + " is not a " + kind + " encoder");
+            if (index.Supports(*plan.muxer, encoder->id) == CodecSupport::Unsupported)
+            {
+                throw std::invalid_argument(plan.muxer->name + " cannot carry " + kind + " encoded by " + encoder->name);
+            }
+            return encoder;
+        };
+
+        plan.videoEncoder = resolve(videoEncoder, AVMEDIA_TYPE_VIDEO, "video");
+        plan.audioEncoder = resolve(audioEncoder, AVMEDIA_TYPE_AUDIO, "audio");
+        return plan;
+    }
+} // namespace MediaEncoder
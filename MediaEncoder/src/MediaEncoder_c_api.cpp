@@ -1,3 +1,4 @@
+#include "MediaEncoder_c_api.h"
 #include "MediaWriter.h"
 #include "VideoFrame.h"
 #include "AudioFrame.h"
@@ -5,105 +6,451 @@
 #include "AudioCodec.h"
 
 #include <memory>
+#include <new>
 #include <string>
-#include <cstdio>
+#include <stdexcept>
 #include <exception>
 
-using namespace MediaEncoder;
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavutil/samplefmt.h>
+    #include <libavutil/channel_layout.h>
+}
 
 // Define handle
 struct MediaWriterHandle {
-    std::unique_ptr<MediaWriter> writer;
+    std::unique_ptr<MediaEncoder::MediaWriter> writer;
+    AVFrame* submitFrame = nullptr;     // reused by the *Planes entry points
+    std::string lastError;
+
+    // Registered with MediaWriter_SetCallbacks, used by the Submit* entry points
+    MediaReleaseCallback frameReleased = nullptr;
+    MediaPacketCallback packetWritten = nullptr;
+    void* callbackOpaque = nullptr;
+
+    ~MediaWriterHandle() {
+        if (submitFrame) av_frame_free(&submitFrame);
+    }
 };
 
-// Helper to convert enums to string names
-std::string CodecToString(VideoCodec codec) {
+// Helpers to convert the C enums to FFmpeg encoder names
+static std::string CodecToString(VideoCodec codec) {
     switch (codec) {
-        case VideoCodec::H264: return "libx264";
-        case VideoCodec::HEVC: return "libx265";
-        case VideoCodec::MPEG4: return "mpeg4";
-        default: return "libx264"; // fallback
+        case VIDEO_CODEC_H264: return "libx264";
+        case VIDEO_CODEC_H265: return "libx265";
+        case VIDEO_CODEC_MPEG4: return "mpeg4";
+        case VIDEO_CODEC_VP8: return "libvpx";
+        case VIDEO_CODEC_VP9: return "libvpx-vp9";
+        default: return "";
+    }
+}
+
+static std::string CodecToString(AudioCodec codec) {
+    MediaEncoder::AudioCodec mapped = MediaEncoder::AudioCodec::None;
+    switch (codec) {
+        case AUDIO_CODEC_AAC: mapped = MediaEncoder::AudioCodec::AAC; break;
+        case AUDIO_CODEC_MP3: mapped = MediaEncoder::AudioCodec::MP3; break;
+        case AUDIO_CODEC_OPUS: mapped = MediaEncoder::AudioCodec::OPUS; break;
+        case AUDIO_CODEC_PCM_S16LE: mapped = MediaEncoder::AudioCodec::PCM_S16LE; break;
+        default: return "";
+    }
+    const char* name = MediaEncoder::ToCodecName(mapped); // use helper in AudioCodec.h
+    return name ? name : "";
+}
+
+static int Fail(MediaWriterHandle* handle, int status, const char* message) {
+    if (handle) handle->lastError = message;
+    return status;
+}
+
+// Runs fn and translates library exceptions into status codes.
+template <typename Fn>
+static int Guard(MediaWriterHandle* handle, Fn&& fn) {
+    try {
+        fn();
+        if (handle) handle->lastError.clear();
+        return MEDIA_STATUS_OK;
+    } catch (const std::invalid_argument& ex) {
+        return Fail(handle, MEDIA_STATUS_INVALID_ARGUMENT, ex.what());
+    } catch (const std::logic_error& ex) {
+        return Fail(handle, MEDIA_STATUS_INVALID_STATE, ex.what());
+    } catch (const std::bad_alloc&) {
+        return Fail(handle, MEDIA_STATUS_OUT_OF_MEMORY, "Out of memory");
+    } catch (const std::exception& ex) {
+        return Fail(handle, MEDIA_STATUS_ENCODER_ERROR, ex.what());
     }
 }
 
-std::string CodecToString(AudioCodec codec) {
-    const char* name = ToCodecName(codec); // use helper in AudioCodec.h
-    return name ? name : "aac";  // default fallback
+// Wraps caller memory in an AVBufferRef whose free callback is the caller's
+// release callback, so the encoder can hold a reference instead of copying.
+// Without a callback the frame stays non-refcounted and libavcodec copies it.
+static void AttachRelease(AVFrame* frame, size_t size, MediaReleaseCallback release, void* opaque) {
+    if (!release) return;
+    frame->buf[0] = av_buffer_create(frame->data[0], size, release, opaque, AV_BUFFER_FLAG_READONLY);
+    if (!frame->buf[0]) throw std::bad_alloc();
+}
+
+// Drops the submission reference; release fires here unless the encoder still holds the frame.
+static void FinishSubmission(AVFrame* frame, const uint8_t* data,
+                             MediaReleaseCallback release, void* opaque) {
+    bool attached = frame->buf[0] != nullptr;
+    av_frame_unref(frame);
+    if (!attached && release) release(opaque, const_cast<uint8_t*>(data));
+}
+
+static bool ValidVideoPlanes(const uint8_t* const planes[3], const int strides[3]) {
+    return planes && strides && planes[0] && planes[1] && planes[2];
+}
+
+static bool ValidAudioPlanes(const uint8_t* const* planes, int planeCount, int samples) {
+    return planes && planes[0] && samples > 0 &&
+           planeCount > 0 && planeCount <= AV_NUM_DATA_POINTERS;
+}
+
+// Points frame at YUV420P caller planes; returns the size of plane 0.
+static size_t FillVideoPlanes(const MediaEncoder::MediaWriter& writer, AVFrame* frame,
+                              const uint8_t* const planes[3], const int strides[3], int64_t pts) {
+    frame->width = writer.GetWidth();
+    frame->height = writer.GetHeight();
+    frame->format = AV_PIX_FMT_YUV420P;
+    for (int i = 0; i < 3; ++i) {
+        frame->data[i] = const_cast<uint8_t*>(planes[i]);
+        frame->linesize[i] = strides[i];
+    }
+    frame->pts = pts == MEDIA_PTS_AUTO ? AV_NOPTS_VALUE : pts;
+    return static_cast<size_t>(strides[0]) * frame->height;
+}
+
+// Points frame at caller samples in the encoder layout; returns the plane size.
+static size_t FillAudioPlanes(const MediaEncoder::MediaWriter& writer, AVFrame* frame,
+                              const uint8_t* const* planes, int planeCount, int samples, int64_t pts) {
+    AVSampleFormat fmt = writer.GetAudioSampleFormat();
+    int channels = writer.GetAudioChannels();
+    if (fmt == AV_SAMPLE_FMT_NONE) throw std::logic_error("Audio stream is not open");
+    int expectedPlanes = av_sample_fmt_is_planar(fmt) ? channels : 1;
+    if (planeCount != expectedPlanes) throw std::invalid_argument("Plane count does not match the encoder layout");
+
+    int lineSize = 0;
+    if (av_samples_get_buffer_size(&lineSize, channels, samples, fmt, 1) < 0)
+        throw std::invalid_argument("Invalid sample count");
+
+    frame->format = fmt;
+    frame->sample_rate = writer.GetAudioSampleRate();
+    frame->nb_samples = samples;
+    av_channel_layout_default(&frame->ch_layout, channels);
+    for (int i = 0; i < planeCount; ++i) {
+        frame->data[i] = const_cast<uint8_t*>(planes[i]);
+    }
+    frame->linesize[0] = lineSize;
+    frame->extended_data = frame->data;
+    frame->pts = pts == MEDIA_PTS_AUTO ? AV_NOPTS_VALUE : pts;
+    return static_cast<size_t>(lineSize);
 }
 
 extern "C" {
 
-MediaWriterHandle* MediaWriter_Create(
+int MediaWriter_Create(
     int width,
     int height,
-    int fps_num,
-    int fps_den,
-    int video_bitrate,
+    int fpsNum,
+    int fpsDen,
     VideoCodec videoCodec,
-    int audio_bitrate,
-    AudioCodec audioCodec
+    int videoBitrate,
+    AudioCodec audioCodec,
+    int audioBitrate,
+    MediaWriterHandle** outWriter
 ) {
-    try {
-        auto* handle = new MediaWriterHandle();
-        handle->writer = std::make_unique<MediaWriter>(
+    if (!outWriter) return MEDIA_STATUS_INVALID_ARGUMENT;
+    *outWriter = nullptr;
+
+    std::unique_ptr<MediaWriterHandle> handle(new (std::nothrow) MediaWriterHandle());
+    if (!handle) return MEDIA_STATUS_OUT_OF_MEMORY;
+
+    int status = Guard(nullptr, [&] {
+        handle->writer = std::make_unique<MediaEncoder::MediaWriter>(
             width,
             height,
-            fps_num,
-            fps_den,
+            fpsNum,
+            fpsDen,
             CodecToString(videoCodec),
-            video_bitrate,
+            videoBitrate,
             CodecToString(audioCodec),
-            audio_bitrate
+            audioBitrate
         );
-        return handle;
-    } catch (const std::exception& ex) {
-        fprintf(stderr, "MediaWriter_Create error: %s\n", ex.what());
-        return nullptr;
+        handle->submitFrame = av_frame_alloc();
+        if (!handle->submitFrame) throw std::bad_alloc();
+    });
+    if (status == MEDIA_STATUS_OK) *outWriter = handle.release();
+    return status;
+}
+
+int MediaWriter_SetAudioFormat(MediaWriterHandle* handle, int sampleRate, int channels) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->SetAudioParameters(sampleRate, channels); });
+}
+
+int MediaWriter_UseSharedExecutor(MediaWriterHandle* handle) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->AttachExecutor(MediaEncoder::Executor::Shared()); });
+}
+
+int MediaWriter_SetInputTimeBase(MediaWriterHandle* handle, int num, int den) {
+    if (!handle || num < 0 || den <= 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->SetInputTimeBase(AVRational{num, den}); });
+}
+
+int MediaWriter_SetMaxInterleaveDelta(MediaWriterHandle* handle, int milliseconds) {
+    if (!handle || milliseconds < 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->SetMaxInterleaveDelta(milliseconds); });
+}
+
+int MediaWriter_Open(MediaWriterHandle* handle, const char* url, const char* format) {
+    if (!handle || !url) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->Open(url, format ? format : ""); });
+}
+
+int MediaWriter_GetAudioFrameInfo(MediaWriterHandle* handle, int* frameSize, int* sampleFormat) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    AVSampleFormat fmt = handle->writer->GetAudioSampleFormat();
+    if (fmt == AV_SAMPLE_FMT_NONE) return Fail(handle, MEDIA_STATUS_INVALID_STATE, "Audio stream is not open");
+    if (frameSize) *frameSize = handle->writer->GetAudioFrameSize();
+    if (sampleFormat) *sampleFormat = static_cast<int>(fmt);
+    return MEDIA_STATUS_OK;
+}
+
+int MediaWriter_EncodeVideoPlanes(MediaWriterHandle* handle,
+                                  const uint8_t* const planes[3], const int strides[3],
+                                  int64_t pts, MediaReleaseCallback release, void* opaque) {
+    if (!handle || !ValidVideoPlanes(planes, strides)) {
+        if (release) release(opaque, planes ? const_cast<uint8_t*>(planes[0]) : nullptr);
+        return Fail(handle, MEDIA_STATUS_INVALID_ARGUMENT, "Missing video planes");
     }
+
+    AVFrame* frame = handle->submitFrame;
+    int status = Guard(handle, [&] {
+        size_t size = FillVideoPlanes(*handle->writer, frame, planes, strides, pts);
+        AttachRelease(frame, size, release, opaque);
+        handle->writer->EncodeNativeVideoFrame(frame);
+    });
+
+    FinishSubmission(frame, planes[0], release, opaque);
+    return status;
 }
 
-int MediaWriter_Open(MediaWriterHandle* handle, const char* filename, const char* format) {
-    try {
-        handle->writer->Open(filename, format);
-        return 0;
-    } catch (const std::exception& ex) {
-        fprintf(stderr, "MediaWriter_Open error: %s\n", ex.what());
-        return -1;
+int MediaWriter_EncodeAudioPlanes(MediaWriterHandle* handle,
+                                  const uint8_t* const* planes, int planeCount, int samples,
+                                  int64_t pts, MediaReleaseCallback release, void* opaque) {
+    if (!handle || !ValidAudioPlanes(planes, planeCount, samples)) {
+        if (release) release(opaque, planes ? const_cast<uint8_t*>(planes[0]) : nullptr);
+        return Fail(handle, MEDIA_STATUS_INVALID_ARGUMENT, "Invalid audio planes");
     }
+
+    AVFrame* frame = handle->submitFrame;
+    int status = Guard(handle, [&] {
+        size_t size = FillAudioPlanes(*handle->writer, frame, planes, planeCount, samples, pts);
+        AttachRelease(frame, size, release, opaque);
+        handle->writer->EncodeNativeAudioFrame(frame);
+    });
+
+    FinishSubmission(frame, planes[0], release, opaque);
+    return status;
 }
 
-int MediaWriter_EncodeVideoFrame(MediaWriterHandle* handle, VideoFrame* frame) {
-    try {
-        handle->writer->EncodeVideoFrame(frame);
-        return 0;
-    } catch (const std::exception& ex) {
-        fprintf(stderr, "EncodeVideoFrame error: %s\n", ex.what());
-        return -1;
+int MediaWriter_SetCallbacks(MediaWriterHandle* handle, MediaReleaseCallback frameReleased,
+                             MediaPacketCallback packetWritten, void* opaque) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    if (handle->writer->IsAsync())
+        return Fail(handle, MEDIA_STATUS_INVALID_STATE, "Callbacks must be set before MediaWriter_StartAsync");
+
+    handle->frameReleased = frameReleased;
+    handle->packetWritten = packetWritten;
+    handle->callbackOpaque = opaque;
+    if (packetWritten) {
+        handle->writer->SetPacketCallback([packetWritten, opaque](int stream, int size, int64_t pts) {
+            packetWritten(opaque, stream, size, pts);
+        });
+    } else {
+        handle->writer->SetPacketCallback(nullptr);
     }
+    return MEDIA_STATUS_OK;
 }
 
-int MediaWriter_EncodeAudioFrame(MediaWriterHandle* handle, AudioFrame* frame) {
-    try {
-        handle->writer->EncodeAudioFrame(frame);
-        return 0;
-    } catch (const std::exception& ex) {
-        fprintf(stderr, "EncodeAudioFrame error: %s\n", ex.what());
-        return -1;
+int MediaWriter_StartAsync(MediaWriterHandle* handle, int queueCapacity) {
+    if (!handle || queueCapacity <= 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->StartAsync(static_cast<size_t>(queueCapacity)); });
+}
+
+int MediaWriter_SetMemoryBudget(MediaWriterHandle* handle, int64_t limitBytes, MediaMemoryPolicy policy) {
+    if (!handle || limitBytes < 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    MediaEncoder::MemoryPolicy memoryPolicy;
+    switch (policy) {
+    case MEDIA_MEMORY_BLOCK: memoryPolicy = MediaEncoder::MemoryPolicy::Block; break;
+    case MEDIA_MEMORY_DROP_NON_REFERENCE: memoryPolicy = MediaEncoder::MemoryPolicy::DropNonReference; break;
+    case MEDIA_MEMORY_FAIL: memoryPolicy = MediaEncoder::MemoryPolicy::Fail; break;
+    default: return Fail(handle, MEDIA_STATUS_INVALID_ARGUMENT, "Unknown memory policy");
     }
+    return Guard(handle, [&] {
+        handle->writer->SetMemoryBudget(MediaEncoder::MemoryGovernor::Shared(),
+                                        static_cast<size_t>(limitBytes), memoryPolicy);
+    });
 }
 
-int MediaWriter_Close(MediaWriterHandle* handle) {
-    try {
-        handle->writer->Close();
-        return 0;
-    } catch (const std::exception& ex) {
-        fprintf(stderr, "MediaWriter_Close error: %s\n", ex.what());
-        return -1;
+int MediaWriter_SetRealtime(MediaWriterHandle* handle, int targetLatencyMs) {
+    if (!handle || targetLatencyMs < 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->SetRealtimeMode(targetLatencyMs); });
+}
+
+int MediaWriter_SetSkipDuplicateFrames(MediaWriterHandle* handle, int enabled, int maxSkippedFrames) {
+    if (!handle || maxSkippedFrames < 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->SetDuplicateFrameSkipping(enabled != 0, maxSkippedFrames); });
+}
+
+void MediaEncoder_SetGlobalMemoryLimit(int64_t limitBytes) {
+    MediaEncoder::MemoryGovernor::Shared().SetGlobalLimit(limitBytes > 0 ? static_cast<size_t>(limitBytes) : 0);
+}
+
+int64_t MediaEncoder_GetMemoryUsage(void) {
+    return static_cast<int64_t>(MediaEncoder::MemoryGovernor::Shared().Usage());
+}
+
+int MediaWriter_SubmitVideoPlanes(MediaWriterHandle* handle,
+                                  const uint8_t* const planes[3], const int strides[3], int64_t pts) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    MediaReleaseCallback release = handle->frameReleased;
+    void* opaque = handle->callbackOpaque;
+    if (!ValidVideoPlanes(planes, strides)) {
+        if (release) release(opaque, planes ? const_cast<uint8_t*>(planes[0]) : nullptr);
+        return Fail(handle, MEDIA_STATUS_INVALID_ARGUMENT, "Missing video planes");
+    }
+
+    AVFrame* frame = handle->submitFrame;
+    bool accepted = false;
+    int status = Guard(handle, [&] {
+        size_t size = FillVideoPlanes(*handle->writer, frame, planes, strides, pts);
+        AttachRelease(frame, size, release, opaque);
+        accepted = handle->writer->TrySubmitVideoFrame(frame);
+    });
+
+    FinishSubmission(frame, planes[0], release, opaque);
+    if (status == MEDIA_STATUS_OK && !accepted) return MEDIA_STATUS_WOULD_BLOCK;
+    return status;
+}
+
+int MediaWriter_SubmitAudioPlanes(MediaWriterHandle* handle,
+                                  const uint8_t* const* planes, int planeCount, int samples, int64_t pts) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    MediaReleaseCallback release = handle->frameReleased;
+    void* opaque = handle->callbackOpaque;
+    if (!ValidAudioPlanes(planes, planeCount, samples)) {
+        if (release) release(opaque, planes ? const_cast<uint8_t*>(planes[0]) : nullptr);
+        return Fail(handle, MEDIA_STATUS_INVALID_ARGUMENT, "Invalid audio planes");
     }
+
+    AVFrame* frame = handle->submitFrame;
+    bool accepted = false;
+    int status = Guard(handle, [&] {
+        size_t size = FillAudioPlanes(*handle->writer, frame, planes, planeCount, samples, pts);
+        AttachRelease(frame, size, release, opaque);
+        accepted = handle->writer->TrySubmitAudioFrame(frame);
+    });
+
+    FinishSubmission(frame, planes[0], release, opaque);
+    if (status == MEDIA_STATUS_OK && !accepted) return MEDIA_STATUS_WOULD_BLOCK;
+    return status;
+}
+
+int MediaWriter_Flush(MediaWriterHandle* handle) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->Flush(); });
+}
+
+int MediaWriter_EncodeVideoFrame(MediaWriterHandle* handle, VideoFrameHandle* frame) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    auto* videoFrame = reinterpret_cast<MediaEncoder::VideoFrame*>(frame);
+    return Guard(handle, [&] { handle->writer->EncodeVideoFrame(videoFrame); });
+}
+
+int MediaWriter_EncodeAudioFrame(MediaWriterHandle* handle, AudioFrameHandle* frame) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    auto* audioFrame = reinterpret_cast<MediaEncoder::AudioFrame*>(frame);
+    return Guard(handle, [&] { handle->writer->EncodeAudioFrame(audioFrame); });
+}
+
+int MediaWriter_SetPreview(MediaWriterHandle* handle, const char* path, int intervalMs, int width) {
+    if (!handle || !path || intervalMs < 0 || width <= 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] {
+        MediaEncoder::PreviewOptions options;
+        options.path = path;
+        options.intervalMs = intervalMs;
+        options.width = width;
+        handle->writer->SetPreview(options);
+    });
+}
+
+int MediaWriter_SetPlacement(MediaWriterHandle* handle, const int* cpus, int cpuCount, int numaNode) {
+    if (!handle || cpuCount < 0 || (cpuCount > 0 && !cpus)) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] {
+        MediaEncoder::PlacementOptions options;
+        if (cpus) options.cpus.assign(cpus, cpus + cpuCount);
+        options.numaNode = numaNode;
+        handle->writer->SetPlacement(options);
+    });
+}
+
+int MediaWriter_SetAdaptiveQuality(MediaWriterHandle* handle, double degradeLoad, double upgradeLoad, int holdMs,
+                                   MediaQualityCallback callback, void* opaque) {
+    if (!handle || holdMs < 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] {
+        MediaEncoder::AdaptiveQualityOptions options;
+        options.degradeLoad = degradeLoad;
+        options.upgradeLoad = upgradeLoad;
+        options.holdMs = holdMs;
+        MediaEncoder::QualityCallback onChange;
+        if (callback) {
+            onChange = [callback, opaque](const MediaEncoder::QualityLevel&, const MediaEncoder::QualityLevel& level,
+                                          double) {
+                callback(opaque, level.index, level.width, level.height, level.preset.c_str());
+            };
+        }
+        handle->writer->SetAdaptiveQuality(options, std::move(onChange));
+    });
+}
+
+int MediaWriter_SetVideoFit(MediaWriterHandle* handle, int enabled, uint8_t r, uint8_t g, uint8_t b,
+                            int cropX, int cropY, int cropWidth, int cropHeight) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] {
+        MediaEncoder::FillColor fill;
+        fill.r = r;
+        fill.g = g;
+        fill.b = b;
+        handle->writer->SetVideoFit(enabled != 0, fill, {cropX, cropY, cropWidth, cropHeight});
+    });
+}
+
+int MediaWriter_AddOutput(MediaWriterHandle* handle, const char* url, const char* format, int queueCapacity) {
+    if (!handle || !url || queueCapacity <= 0) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] {
+        handle->writer->AddOutput(url, format ? format : "", static_cast<size_t>(queueCapacity));
+    });
+}
+
+int MediaWriter_Rollover(MediaWriterHandle* handle, const char* url) {
+    if (!handle || !url) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->Rollover(url); });
+}
+
+int MediaWriter_Close(MediaWriterHandle* handle) {
+    if (!handle) return MEDIA_STATUS_INVALID_ARGUMENT;
+    return Guard(handle, [&] { handle->writer->Close(); });
+}
+
+const char* MediaWriter_GetLastError(MediaWriterHandle* handle) {
+    return handle ? handle->lastError.c_str() : "";
 }
 
 void MediaWriter_Destroy(MediaWriterHandle* handle) {
     delete handle;
 }
 
-} // extern "C"
\ No newline at end of file
+} // extern "C"
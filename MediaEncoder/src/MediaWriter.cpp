@@ -1,11 +1,16 @@
 #include "MediaWriter.h"
 #include "VideoFrame.h"
 #include "AudioFrame.h"
+#include "Trace.h"
+#include "FrameHash.h"
+#include "MediaEncoder.h"
 
 #include <stdexcept>
 #include <string>
 #include <memory>
 #include <vector>
+#include <chrono>
+#include <algorithm>
 
 extern "C" {
     #include <libavformat/avformat.h>
@@ -18,34 +23,15 @@ extern "C" {
 }
 
 namespace MediaEncoder {
-    struct WriterPrivateData {
-    AVFormatContext* formatCtx = nullptr;
-    AVCodecContext* videoCtx = nullptr;
-    AVCodecContext* audioCtx = nullptr;
-    AVStream* videoStream = nullptr;
-    AVStream* audioStream = nullptr;
-    AVFrame* videoFrame = nullptr;
-    AVFrame* audioFrame = nullptr;
-    int64_t videoPts = 0;
-    int64_t audioPts = 0;
-
-    ~WriterPrivateData() {
-        if (videoCtx) avcodec_free_context(&videoCtx);
-        if (audioCtx) avcodec_free_context(&audioCtx);
-        if (formatCtx) {
-            if (!(formatCtx->oformat->flags & AVFMT_NOFILE)) {
-                avio_closep(&formatCtx->pb);
-            }
-            avformat_free_context(formatCtx);
-        }
-        if (videoFrame) av_frame_free(&videoFrame);
-        if (audioFrame) av_frame_free(&audioFrame);
-    }
-    };
 
 // Helper for writing frames
-static int WriteFrame(AVFormatContext* fmtCtx, AVCodecContext* codecCtx, AVStream* stream, AVFrame* frame) {
-    int ret = avcodec_send_frame(codecCtx, frame);
+void MediaWriter::WriteFrame(AVCodecContext* codecCtx, AVFrame* frame) {
+    const bool video = codecCtx == m_data->videoCtx;
+    int ret;
+    {
+        ME_TRACE_SCOPE("avcodec_send_frame", "encode", frame ? frame->pts : Trace::kNoPts);
+        ret = avcodec_send_frame(codecCtx, frame);
+    }
     if (ret < 0) throw std::runtime_error("avcodec_send_frame failed");
 
     while (ret >= 0) {
@@ -54,20 +40,101 @@ static int WriteFrame(AVFormatContext* fmtCtx, AVCodecContext* codecCtx, AVStrea
         pkt.data = nullptr;
         pkt.size = 0;
 
-        ret = avcodec_receive_packet(codecCtx, &pkt);
+        {
+            ME_TRACE_SCOPE("avcodec_receive_packet", "encode", Trace::kNoPts);
+            ret = avcodec_receive_packet(codecCtx, &pkt);
+        }
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
         if (ret < 0) throw std::runtime_error("avcodec_receive_packet failed");
 
+        {
+            // Tee outputs take their reference before timestamps are rebased.
+            std::lock_guard<std::mutex> lock(m_data->outputsMutex);
+            for (auto& output : m_data->outputs) output->Push(&pkt, video);
+        }
+
+        if (m_data->rolloverPending.load(std::memory_order_acquire)) SwitchMuxerIfDue(pkt, video);
+
+        Muxer* muxer = m_data->muxer.get();
+        if (!video && m_data->drainingMuxer) {
+            // Audio before the switch point still belongs to the previous file.
+            if (pkt.pts != AV_NOPTS_VALUE && pkt.pts < muxer->audioOffset) muxer = m_data->drainingMuxer.get();
+            else RetireDrainingMuxer();
+        }
+
+        AVStream* stream = video ? muxer->videoStream : muxer->audioStream;
+        int64_t offset = video ? muxer->videoOffset : muxer->audioOffset;
+        if (pkt.pts != AV_NOPTS_VALUE) pkt.pts -= offset;
+        if (pkt.dts != AV_NOPTS_VALUE) pkt.dts -= offset;
         av_packet_rescale_ts(&pkt, codecCtx->time_base, stream->time_base);
         pkt.stream_index = stream->index;
+        muxer->interleaver->Push(&pkt);
+        av_packet_unref(&pkt);
+    }
+}
 
-        if (av_interleaved_write_frame(fmtCtx, &pkt) < 0)
-            throw std::runtime_error("av_interleaved_write_frame failed");
+// Interleaver output
+void MediaWriter::WritePacket(Muxer& muxer, AVPacket* pkt) {
+    AVStream* stream = muxer.formatCtx->streams[pkt->stream_index];
+    const bool video = stream == muxer.videoStream;
+    AVCodecContext* codecCtx = video ? m_data->videoCtx : m_data->audioCtx;
+    int64_t codecPts = pkt->pts == AV_NOPTS_VALUE
+        ? pkt->pts
+        : av_rescale_q(pkt->pts, stream->time_base, codecCtx->time_base) + (video ? muxer.videoOffset : muxer.audioOffset);
+    int size = pkt->size;
 
-        av_packet_unref(&pkt);
+    {
+        ME_TRACE_SCOPE("av_write_frame", "mux", pkt->pts);
+        if (av_write_frame(muxer.formatCtx, pkt) < 0)
+            throw std::runtime_error("av_write_frame failed");
     }
 
-    return 0;
+    m_data->packetsWritten.fetch_add(1, std::memory_order_relaxed);
+    m_data->bytesWritten.fetch_add(static_cast<uint64_t>(size), std::memory_order_relaxed);
+    if (m_packetCallback) m_packetCallback(stream->index, size, codecPts);
+}
+
+// Output containers share the open encoders, so a muxer only needs streams
+// described from the codec contexts, a file and a header.
+std::unique_ptr<MediaWriter::Muxer> MediaWriter::CreateMuxer(const std::string& url) {
+    auto muxer = std::make_unique<Muxer>();
+    muxer->url = url;
+
+    avformat_alloc_output_context2(&muxer->formatCtx, m_data->outputFormat, nullptr, url.c_str());
+    if (!muxer->formatCtx) throw std::runtime_error("Failed to allocate output context");
+
+    if (m_data->videoCtx) {
+        muxer->videoStream = avformat_new_stream(muxer->formatCtx, nullptr);
+        if (!muxer->videoStream) throw std::runtime_error("Failed to create video stream");
+        std::lock_guard<std::mutex> lock(m_data->videoCtxMutex);
+        avcodec_parameters_from_context(muxer->videoStream->codecpar, m_data->videoCtx);
+        muxer->videoStream->time_base = m_data->videoCtx->time_base;
+    }
+    if (m_data->audioCtx) {
+        muxer->audioStream = avformat_new_stream(muxer->formatCtx, nullptr);
+        if (!muxer->audioStream) throw std::runtime_error("Failed to create audio stream");
+        avcodec_parameters_from_context(muxer->audioStream->codecpar, m_data->audioCtx);
+        muxer->audioStream->time_base = m_data->audioCtx->time_base;
+    }
+
+    if (!(muxer->formatCtx->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&muxer->formatCtx->pb, url.c_str(), AVIO_FLAG_WRITE) < 0)
+            throw std::runtime_error("Failed to open output file");
+    }
+
+    if (avformat_write_header(muxer->formatCtx, nullptr) < 0)
+        throw std::runtime_error("Failed to write header");
+
+    // Stream time bases are final once the header is written.
+    std::vector<AVRational> timeBases;
+    for (unsigned i = 0; i < muxer->formatCtx->nb_streams; ++i)
+        timeBases.push_back(muxer->formatCtx->streams[i]->time_base);
+    Muxer* target = muxer.get();
+    muxer->interleaver = std::make_unique<PacketInterleaver>(
+        std::move(timeBases), [this, target](AVPacket* pkt) { WritePacket(*target, pkt); });
+    muxer->interleaver->SetMaxDeltaMicroseconds(m_data->maxInterleaveUs);
+    if (m_data->memory) muxer->interleaver->SetMemoryAccount(m_data->memory.get());
+    return muxer;
 }
 
 // Constructor
@@ -78,121 +145,1270 @@ MediaWriter::MediaWriter(int width, int height, int videoNum, int videoDen,
       m_videoNumerator(videoNum), m_videoDenominator(videoDen),
       m_videoCodecName(videoCodec), m_videoBitrate(videoBitrate),
       m_audioCodecName(audioCodec), m_audioBitrate(audioBitrate),
+      m_audioSampleRate(48000), m_audioChannels(2),
       m_disposed(false)
 {
     m_data = std::make_unique<WriterPrivateData>();
 }
 
+MediaWriter::~MediaWriter() {
+    StopWorker();
+}
+
+void MediaWriter::SetAudioParameters(int sampleRate, int channels) {
+    if (m_data->opened) throw std::logic_error("Audio parameters must be set before Open");
+    if (sampleRate <= 0 || channels <= 0) throw std::invalid_argument("Invalid audio parameters");
+    m_audioSampleRate = sampleRate;
+    m_audioChannels = channels;
+}
+
+void MediaWriter::SetEncoderThreads(int threads) {
+    if (m_data->opened) throw std::logic_error("Encoder threads must be set before Open");
+    if (threads < 0) throw std::invalid_argument("Encoder thread count must not be negative");
+    m_data->encoderThreads = threads;
+}
+
+void MediaWriter::SetPlacement(const PlacementOptions& options) {
+    if (m_data->opened) throw std::logic_error("Placement must be set before Open");
+    m_data->placement = Placement::Resolve(options);
+}
+
+void MediaWriter::AttachExecutor(Executor& executor, const std::string& name) {
+    if (m_data->opened) throw std::logic_error("Executor must be attached before Open");
+    if (m_data->videoRing || m_data->audioRing)
+        throw std::logic_error("Frame rings cannot be used with a shared executor");
+    m_data->strand = executor.CreateClient(name);
+}
+
+void MediaWriter::SetInputTimeBase(AVRational timeBase) {
+    if (timeBase.num < 0 || timeBase.den <= 0) throw std::invalid_argument("Invalid input time base");
+    m_data->inputTimeBase = timeBase;
+    m_data->inputOrigin = AV_NOPTS_VALUE;
+}
+
+void MediaWriter::SetPreview(const PreviewOptions& options, PreviewCallback callback) {
+    if (m_data->async) throw std::logic_error("Preview must be set before StartAsync");
+    m_data->preview = std::make_unique<PreviewTap>(options, std::move(callback));
+}
+
+void MediaWriter::SetAdaptiveQuality(const AdaptiveQualityOptions& options, QualityCallback callback) {
+    if (m_data->opened) throw std::logic_error("Adaptive quality must be set before Open");
+    QualityController::Validate(options);
+    m_data->adaptiveQuality = true;
+    m_data->qualityOptions = options;
+    m_data->qualityCallback = std::move(callback);
+}
+
+void MediaWriter::SetVideoFit(bool enabled, FillColor fill, const ScaleRect& crop) {
+    if (m_data->opened) throw std::logic_error("Video fit must be set before Open");
+    if (crop.width < 0 || crop.height < 0 || (crop.width > 0) != (crop.height > 0) || crop.x < 0 || crop.y < 0)
+        throw std::invalid_argument("Invalid video crop rectangle");
+    m_data->fitVideo = enabled;
+    m_data->fitFill = fill;
+    m_data->fitCrop = enabled ? crop : ScaleRect();
+}
+
+void MediaWriter::SetMaxInterleaveDelta(int milliseconds) {
+    if (milliseconds < 0) throw std::invalid_argument("Interleave delta must not be negative");
+    // The encoding thread replaces the muxer on rollover.
+    std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+    m_data->maxInterleaveUs = static_cast<int64_t>(milliseconds) * 1000;
+    if (m_data->muxer) m_data->muxer->interleaver->SetMaxDeltaMicroseconds(m_data->maxInterleaveUs);
+    if (m_data->nextMuxer) m_data->nextMuxer->interleaver->SetMaxDeltaMicroseconds(m_data->maxInterleaveUs);
+}
+
 // Open method
 void MediaWriter::Open(const std::string& url, const std::string& format) {
     m_url = url;
     m_format = format;
 
-    avformat_alloc_output_context2(&m_data->formatCtx, nullptr, format.c_str(), url.c_str());
-    if (!m_data->formatCtx) throw std::runtime_error("Failed to allocate output context");
+    // Resolved against the cached capability index: no muxer or codec scans
+    // here, and incompatible combinations fail before anything is opened.
+    OutputPlan plan = MediaFormat::Validate(url, format, m_videoCodecName, m_audioCodecName);
+    bool globalHeader = (plan.muxer->format->flags & AVFMT_GLOBALHEADER) != 0;
+    for (const auto& spec : m_data->pendingOutputs)
+        globalHeader = globalHeader || (spec.format->flags & AVFMT_GLOBALHEADER);
 
-    // Video
-    if (!m_videoCodecName.empty()) {
-        const AVCodec* codec = avcodec_find_encoder_by_name(m_videoCodecName.c_str());
-        if (!codec) throw std::runtime_error("Video codec not found");
+    // Each quality change reopens the encoder with new parameter sets; a
+    // header written once at Open would keep describing the first one.
+    if (m_data->adaptiveQuality && plan.videoEncoder && globalHeader)
+        throw std::invalid_argument("Adaptive quality cannot be used with formats that need global headers");
 
-        m_data->videoStream = avformat_new_stream(m_data->formatCtx, nullptr);
-        m_data->videoCtx = avcodec_alloc_context3(codec);
-        AVCodecContext* ctx = m_data->videoCtx;
+    // Codec and output threads started from here inherit the placement.
+    ScopedPlacement placement(m_data->placement);
+    const int numaNode = m_data->placement.numaNode;
 
-        ctx->codec_id = codec->id;
-        ctx->width = m_width;
-        ctx->height = m_height;
-        ctx->time_base = {m_videoDenominator, m_videoNumerator};
-        ctx->framerate = {m_videoNumerator, m_videoDenominator};
-        ctx->pix_fmt = AV_PIX_FMT_YUV420P;
-        ctx->bit_rate = m_videoBitrate;
-
-        if (m_data->formatCtx->oformat->flags & AVFMT_GLOBALHEADER)
-            ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    m_data->opened = true;
+    m_data->outputFormat = plan.muxer->format;
 
-        if (avcodec_open2(ctx, codec, nullptr) < 0)
-            throw std::runtime_error("Failed to open video codec");
+    // Video
+    if (plan.videoEncoder) {
+        const AVCodec* codec = plan.videoEncoder->codec;
+        m_data->videoCodec = codec;
+
+        std::string preset;
+        if (m_data->adaptiveQuality && m_videoNumerator > 0) {
+            const bool presets = codec->priv_class &&
+                av_opt_find(const_cast<const AVClass**>(&codec->priv_class), "preset", nullptr, 0, AV_OPT_SEARCH_FAKE_OBJ);
+            const int64_t intervalUs = static_cast<int64_t>(1000000) * m_videoDenominator / m_videoNumerator;
+            m_data->quality = std::make_unique<QualityController>(m_data->qualityOptions, m_width, m_height,
+                                                                  intervalUs, presets);
+            preset = m_data->quality->Current().preset;
+        }
 
-        avcodec_parameters_from_context(m_data->videoStream->codecpar, ctx);
-        m_data->videoStream->time_base = ctx->time_base;
+        m_data->videoCtx = OpenVideoEncoder(m_width, m_height, preset, globalHeader);
+        AVCodecContext* ctx = m_data->videoCtx;
+        m_data->videoTimeBase = ctx->time_base;
+        m_data->videoPixelFormat = ctx->pix_fmt;
 
         m_data->videoFrame = av_frame_alloc();
         m_data->videoFrame->format = ctx->pix_fmt;
         m_data->videoFrame->width = ctx->width;
         m_data->videoFrame->height = ctx->height;
         av_frame_get_buffer(m_data->videoFrame, 32);
+        m_data->placementBoundBytes += Placement::BindFrame(m_data->videoFrame, numaNode);
     }
 
     // Audio
-    if (!m_audioCodecName.empty()) {
-        const AVCodec* codec = avcodec_find_encoder_by_name(m_audioCodecName.c_str());
-        if (!codec) throw std::runtime_error("Audio codec not found");
+    if (plan.audioEncoder) {
+        const AVCodec* codec = plan.audioEncoder->codec;
 
-        m_data->audioStream = avformat_new_stream(m_data->formatCtx, nullptr);
         m_data->audioCtx = avcodec_alloc_context3(codec);
         AVCodecContext* ctx = m_data->audioCtx;
 
         ctx->codec_id = codec->id;
-        if (av_channel_layout_copy(&m_data->audioFrame->ch_layout, &ctx->ch_layout) < 0) {
-            throw std::runtime_error("Failed to copy channel layout to frame");
-        }
+        ctx->sample_rate = m_audioSampleRate;
+        ctx->sample_fmt = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+        av_channel_layout_default(&ctx->ch_layout, m_audioChannels);
         ctx->bit_rate = m_audioBitrate;
+        if (m_data->strand) ctx->thread_count = 1;
+        else if (m_data->encoderThreads >= 0) ctx->thread_count = m_data->encoderThreads;
         ctx->time_base = {1, ctx->sample_rate};
 
-        if (m_data->formatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+        if (globalHeader)
             ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
         if (avcodec_open2(ctx, codec, nullptr) < 0)
             throw std::runtime_error("Failed to open audio codec");
 
-        avcodec_parameters_from_context(m_data->audioStream->codecpar, ctx);
-        m_data->audioStream->time_base = ctx->time_base;
-
         m_data->audioFrame = av_frame_alloc();
         m_data->audioFrame->format = ctx->sample_fmt;
         m_data->audioFrame->sample_rate = ctx->sample_rate;
         if (av_channel_layout_copy(&m_data->audioFrame->ch_layout, &ctx->ch_layout) < 0) {
             throw std::runtime_error("Failed to copy channel layout");
         }
-        m_data->audioFrame->nb_samples = ctx->frame_size;
+        m_data->audioFrame->nb_samples = ctx->frame_size > 0 ? ctx->frame_size : 1024;
         av_frame_get_buffer(m_data->audioFrame, 0);
+        m_data->placementBoundBytes += Placement::BindFrame(m_data->audioFrame, numaNode);
     }
 
-    // File open
-    if (!(m_data->formatCtx->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&m_data->formatCtx->pb, url.c_str(), AVIO_FLAG_WRITE) < 0)
-            throw std::runtime_error("Failed to open output file");
+    m_data->muxer = CreateMuxer(url);
+
+    std::vector<WriterPrivateData::OutputSpec> pending;
+    pending.swap(m_data->pendingOutputs);
+    for (const auto& spec : pending) {
+        auto output = std::make_unique<OutputSink>(spec.url, spec.format, m_data->videoCtx, m_data->audioCtx,
+                                                   spec.queueCapacity, m_data->maxInterleaveUs);
+        std::lock_guard<std::mutex> lock(m_data->outputsMutex);
+        m_data->outputs.push_back(std::move(output));
     }
+}
 
-    if (avformat_write_header(m_data->formatCtx, nullptr) < 0)
-        throw std::runtime_error("Failed to write header");
+AVCodecContext* MediaWriter::OpenVideoEncoder(int width, int height, const std::string& preset, bool globalHeader) {
+    const AVCodec* codec = m_data->videoCodec;
+    AVCodecContext* ctx = avcodec_alloc_context3(codec);
+    if (!ctx) throw std::bad_alloc();
+
+    ctx->codec_id = codec->id;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->time_base = {m_videoDenominator, m_videoNumerator};
+    ctx->framerate = {m_videoNumerator, m_videoDenominator};
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->bit_rate = m_videoBitrate;
+    // Parallelism comes from the shared executor, not from codec threads.
+    if (m_data->strand) ctx->thread_count = 1;
+    else if (m_data->encoderThreads >= 0) ctx->thread_count = m_data->encoderThreads;
+    // Reordering would make dts step back when the encoder is replaced.
+    if (m_data->quality) ctx->max_b_frames = 0;
+    if (!preset.empty()) av_opt_set(ctx->priv_data, "preset", preset.c_str(), 0);
+
+    if (globalHeader)
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (avcodec_open2(ctx, codec, nullptr) < 0) {
+        avcodec_free_context(&ctx);
+        throw std::runtime_error("Failed to open video codec");
+    }
+    return ctx;
+}
+
+size_t MediaWriter::AddOutput(const std::string& url, const std::string& format, size_t queueCapacity) {
+    if (queueCapacity == 0) throw std::invalid_argument("Output queue capacity must be positive");
+    OutputPlan plan = MediaFormat::Validate(url, format, m_videoCodecName, m_audioCodecName);
+
+    if (!m_data->opened) {
+        m_data->pendingOutputs.push_back({url, plan.muxer->format, queueCapacity});
+        return m_data->pendingOutputs.size() - 1;
+    }
+
+    std::unique_ptr<OutputSink> output;
+    {
+        std::lock_guard<std::mutex> lock(m_data->videoCtxMutex);
+        // The encoders' header placement was fixed by Open().
+        const bool globalHeader = plan.muxer->format->flags & AVFMT_GLOBALHEADER;
+        if (globalHeader &&
+            ((m_data->videoCtx && !(m_data->videoCtx->flags & AV_CODEC_FLAG_GLOBAL_HEADER)) ||
+             (m_data->audioCtx && !(m_data->audioCtx->flags & AV_CODEC_FLAG_GLOBAL_HEADER))))
+            throw std::logic_error("Outputs that need global headers must be added before Open");
+        output = std::make_unique<OutputSink>(url, plan.muxer->format, m_data->videoCtx, m_data->audioCtx,
+                                              queueCapacity, m_data->maxInterleaveUs);
+    }
+    std::lock_guard<std::mutex> lock(m_data->outputsMutex);
+    m_data->outputs.push_back(std::move(output));
+    return m_data->outputs.size() - 1;
+}
+
+std::vector<OutputStats> MediaWriter::GetOutputStats() const {
+    std::vector<OutputStats> stats;
+    std::lock_guard<std::mutex> lock(m_data->outputsMutex);
+    for (const auto& output : m_data->outputs) stats.push_back(output->Stats());
+    return stats;
 }
 
 // Encoding
-void MediaWriter::EncodeVideoFrame(VideoFrame* frame) {
+// Encodes through a reference so pts and picture type are set on this
+// writer's view; the caller's buffers are shared, never copied.
+static AVFrame* ReferenceInput(AVFrame*& view, const AVFrame* src, int64_t pts) {
+    if (!view) {
+        view = av_frame_alloc();
+        if (!view) throw std::bad_alloc();
+    }
+    if (av_frame_ref(view, src) < 0) throw std::runtime_error("Failed to reference input frame");
+    view->pts = pts;
+    return view;
+}
+
+void MediaWriter::EncodeVideoFrame(VideoFrame* frame, int64_t pts) {
     if (!frame) return;
-    AVFrame* src = frame->NativePointer();
-    src->pts = m_data->videoPts++;
-    WriteFrame(m_data->formatCtx, m_data->videoCtx, m_data->videoStream, src);
+    AVFrame* view = ReferenceInput(m_data->videoInput, frame->NativePointer(), pts);
+    struct Unref { AVFrame* f; ~Unref() { av_frame_unref(f); } } unref{view};
+    EncodeNativeVideoFrame(view);
 }
 
-void MediaWriter::EncodeAudioFrame(AudioFrame* frame) {
+void MediaWriter::EncodeAudioFrame(AudioFrame* frame, int64_t pts) {
     if (!frame) return;
-    AVFrame* src = frame->NativePointer();
-    src->pts = m_data->audioPts;
-    m_data->audioPts += src->nb_samples;
-    WriteFrame(m_data->formatCtx, m_data->audioCtx, m_data->audioStream, src);
+    AVFrame* view = ReferenceInput(m_data->audioInput, frame->NativePointer(), pts);
+    struct Unref { AVFrame* f; ~Unref() { av_frame_unref(f); } } unref{view};
+    EncodeNativeAudioFrame(view);
+}
+
+void MediaWriter::EncodeNativeVideoFrame(AVFrame* frame) {
+    if (!frame) return;
+    CheckDirectInput(true);
+    if (IsAsync()) {
+        Submit(frame, true, true);
+        return;
+    }
+    RethrowAsyncError();
+    // Validated first: a rejected frame must not become the duplicate reference.
+    PrepareVideoFrame(frame);
+    if (IsDuplicateVideoFrame(frame)) {
+        m_data->framesSkippedDuplicate.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    try {
+        if (m_data->realtimeTargetUs) EncodePacedVideo(frame, m_data->backlogUs);
+        else EncodeVideo(frame);
+    } catch (const MemoryLimitError&) {
+        FailWriter(std::current_exception());
+        throw;
+    }
+}
+
+void MediaWriter::EncodeNativeAudioFrame(AVFrame* frame) {
+    if (!frame) return;
+    CheckDirectInput(false);
+    if (IsAsync()) {
+        Submit(frame, false, true);
+        return;
+    }
+    RethrowAsyncError();
+    PrepareAudioFrame(frame);
+    try {
+        EncodeAudio(frame);
+    } catch (const MemoryLimitError&) {
+        FailWriter(std::current_exception());
+        throw;
+    }
+}
+
+// Validation and pts assignment run on the submitting thread so timestamps
+// follow submission order regardless of where encoding happens.
+void MediaWriter::PrepareVideoFrame(AVFrame* frame) {
+    // The encoder itself may be replaced on the encoding thread (adaptive quality).
+    if (m_data->videoPixelFormat == AV_PIX_FMT_NONE) throw std::logic_error("Video stream is not open");
+    if (m_data->fitVideo) {
+        // Checked here so a bad frame is rejected rather than failing the
+        // encoding thread.
+        const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+        if (GetPixelFormatTraits(format).planes == 0)
+            throw std::invalid_argument("Fitted video frames need a software pixel format");
+        if (m_data->fitCrop.width > 0) Scaler::CheckSourceRect(frame->width, frame->height, format, m_data->fitCrop);
+    } else if (frame->width != m_width || frame->height != m_height || frame->format != m_data->videoPixelFormat) {
+        throw std::invalid_argument("Video frame does not match the encoder format");
+    }
+
+    if (frame->pts == AV_NOPTS_VALUE) {
+        frame->pts = m_data->videoPts;
+    } else if (m_data->inputTimeBase.num) {
+        // Two capture times can round to the same encoder tick.
+        frame->pts = std::max(RebaseInputPts(frame->pts, m_data->videoTimeBase), m_data->videoPts);
+    }
+    m_data->videoPts = frame->pts + 1;
+
+    if (m_data->preview)
+        m_data->preview->Offer(frame, av_rescale_q(frame->pts, m_data->videoTimeBase, {1, 1000000}));
+}
+
+void MediaWriter::PrepareAudioFrame(AVFrame* frame) {
+    if (!m_data->audioCtx) throw std::logic_error("Audio stream is not open");
+    if (frame->format != m_data->audioCtx->sample_fmt ||
+        frame->ch_layout.nb_channels != m_data->audioCtx->ch_layout.nb_channels)
+        throw std::invalid_argument("Audio frame does not match the encoder format");
+
+    // Fixed-size encoders take exactly frame_size samples, except for one
+    // shorter frame that ends the stream. Checked here so a bad frame is
+    // rejected rather than failing the encoding thread.
+    const AVCodecContext* ctx = m_data->audioCtx;
+    if (ctx->frame_size > 0 && !(ctx->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        if (frame->nb_samples > ctx->frame_size)
+            throw std::invalid_argument("Audio frame exceeds the encoder frame size");
+        if (m_data->audioEnded)
+            throw std::invalid_argument("Audio frame follows a short final frame");
+        if (frame->nb_samples < ctx->frame_size) m_data->audioEnded = true;
+    }
+
+    if (frame->pts == AV_NOPTS_VALUE) {
+        frame->pts = m_data->audioPts;
+    } else if (m_data->inputTimeBase.num) {
+        // Capture jitter below half a frame is absorbed so frames stay
+        // contiguous; real gaps are kept and overlaps are pushed back.
+        int64_t pts = RebaseInputPts(frame->pts, m_data->audioCtx->time_base);
+        int64_t expected = m_data->audioPts;
+        frame->pts = pts - expected < frame->nb_samples / 2 ? expected : pts;
+    }
+    m_data->audioPts = frame->pts + frame->nb_samples;
+}
+
+int64_t MediaWriter::RebaseInputPts(int64_t pts, AVRational encoderTimeBase) {
+    if (m_data->inputOrigin == AV_NOPTS_VALUE) m_data->inputOrigin = pts;
+    return av_rescale_q(pts - m_data->inputOrigin, m_data->inputTimeBase, encoderTimeBase);
+}
+
+void MediaWriter::SetDuplicateFrameSkipping(bool enabled, int maxSkippedFrames) {
+    if (maxSkippedFrames < 0) throw std::invalid_argument("maxSkippedFrames must not be negative");
+    m_data->skipDuplicates = enabled;
+    m_data->maxSkippedFrames = maxSkippedFrames;
+    m_data->skippedRun = 0;
+    m_data->haveFrameHash = false;
+}
+
+uint64_t MediaWriter::HashForDuplicates(const AVFrame* frame) const {
+    if (!m_data->skipDuplicates) return 0;
+    ME_TRACE_SCOPE("HashVideoFrame", "writer", frame->pts);
+    return HashVideoFrame(frame);
+}
+
+bool MediaWriter::IsDuplicateVideoFrame(const AVFrame* frame) {
+    return IsDuplicateVideoFrame(frame, HashForDuplicates(frame));
+}
+
+// Records hash as the reference for the next frame unless it is a duplicate.
+bool MediaWriter::IsDuplicateVideoFrame(const AVFrame* frame, uint64_t hash) {
+    if (!m_data->skipDuplicates) return false;
+
+    bool reset = m_data->resetFrameHash.exchange(false, std::memory_order_relaxed);
+    bool duplicate = hash != 0 && !reset && m_data->haveFrameHash && hash == m_data->lastFrameHash &&
+                     frame->pict_type != AV_PICTURE_TYPE_I &&
+                     (m_data->maxSkippedFrames == 0 || m_data->skippedRun < m_data->maxSkippedFrames);
+    if (duplicate) {
+        ++m_data->skippedRun;
+        return true;
+    }
+
+    m_data->skippedRun = 0;
+    m_data->haveFrameHash = hash != 0;
+    m_data->lastFrameHash = hash;
+    return false;
+}
+
+static int64_t NowMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MediaWriter::EncodeVideo(AVFrame* input) {
+    ME_TRACE_SCOPE("EncodeVideoFrame", "writer", input->pts);
+    const int64_t start = m_data->quality ? NowMicroseconds() : 0;
+    const AVCodecContext* ctx = m_data->videoCtx;
+    AVFrame* frame = input->width == ctx->width && input->height == ctx->height && input->format == ctx->pix_fmt &&
+                     m_data->fitCrop.width == 0 ? input : ScaleForEncoder(input);
+
+    if (ClaimRolloverKeyframe(frame->pts)) {
+        // Forced on the encoder's copy only; the caller's frame is restored.
+        AVPictureType pictType = frame->pict_type;
+        frame->pict_type = AV_PICTURE_TYPE_I;
+        try {
+            WriteFrame(m_data->videoCtx, frame);
+        } catch (...) {
+            frame->pict_type = pictType;
+            throw;
+        }
+        frame->pict_type = pictType;
+    } else {
+        WriteFrame(m_data->videoCtx, frame);
+    }
+    m_data->videoFramesEncoded.fetch_add(1, std::memory_order_relaxed);
+
+    if (m_data->quality) {
+        const int64_t now = NowMicroseconds();
+        if (m_data->quality->Update(now - start, now)) ApplyQualityLevel();
+    }
+}
+
+void MediaWriter::EncodeAudio(AVFrame* frame) {
+    ME_TRACE_SCOPE("EncodeAudioFrame", "writer", frame->pts);
+    WriteFrame(m_data->audioCtx, frame);
+    m_data->audioFramesEncoded.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Realtime pacing
+void MediaWriter::SetRealtimeMode(int targetLatencyMs) {
+    if (IsAsync()) throw std::logic_error("Realtime mode must be set before StartAsync");
+    if (targetLatencyMs < 0) throw std::invalid_argument("Target latency must not be negative");
+    m_data->realtimeTargetUs = static_cast<int64_t>(targetLatencyMs) * 1000;
+    m_data->backlogUs = 0;
+}
+
+// ageUs is how far behind capture this frame already is. Dropping a frame
+// costs nothing and wins back one frame interval; encoding one costs its
+// encode time. In synchronous mode the difference accumulates in backlogUs,
+// which stands in for the caller's own capture queue.
+void MediaWriter::EncodePacedVideo(AVFrame* frame, int64_t ageUs) {
+    const int64_t target = m_data->realtimeTargetUs;
+    const int64_t intervalUs = m_videoNumerator > 0
+        ? static_cast<int64_t>(1000000) * m_videoDenominator / m_videoNumerator : 0;
+    int64_t ema = m_data->encodeEmaUs.load(std::memory_order_relaxed);
+
+    if (frame->pict_type != AV_PICTURE_TYPE_I && ageUs + ema > target) {
+        m_data->framesDroppedLate.fetch_add(1, std::memory_order_relaxed);
+        m_data->resetFrameHash.store(true, std::memory_order_relaxed);
+        m_data->backlogUs = std::max<int64_t>(0, m_data->backlogUs - intervalUs);
+        return;
+    }
+
+    int64_t start = NowMicroseconds();
+    EncodeVideo(frame);
+    int64_t spent = NowMicroseconds() - start;
+
+    ema = ema ? ema + (spent - ema) / 8 : spent;
+    m_data->encodeEmaUs.store(ema, std::memory_order_relaxed);
+    if (ageUs + spent > target) m_data->framesLate.fetch_add(1, std::memory_order_relaxed);
+    m_data->backlogUs = std::max<int64_t>(0, m_data->backlogUs + spent - intervalUs);
+}
+
+// Adaptive quality and video fit
+// A reduced level, or a frame that has to be fitted, is converted into the
+// writer's own frame, which is reallocated when the encoder still holds it.
+// Crop, scale and letterbox are a single ConvertRect pass; only the border
+// outside the picture is filled.
+AVFrame* MediaWriter::ScaleForEncoder(AVFrame* frame) {
+    AVFrame* scaled = m_data->videoFrame;
+    if (!av_frame_is_writable(scaled)) {
+        const int format = scaled->format;
+        const int width = scaled->width;
+        const int height = scaled->height;
+        av_frame_unref(scaled);
+        scaled->format = format;
+        scaled->width = width;
+        scaled->height = height;
+        if (av_frame_get_buffer(scaled, 32) < 0) throw std::runtime_error("Failed to allocate scaled frame");
+    }
+
+    {
+        ME_TRACE_SCOPE("ScaleVideoFrame", "writer", frame->pts);
+        const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+        const AVPixelFormat scaledFormat = static_cast<AVPixelFormat>(scaled->format);
+        const ScaleRect source = m_data->fitCrop.width > 0 ? m_data->fitCrop
+                                                           : ScaleRect{0, 0, frame->width, frame->height};
+        const ScaleRect target = m_data->fitVideo
+            ? Scaler::FitRect(source.width, source.height, scaled->width, scaled->height, scaledFormat)
+            : ScaleRect{0, 0, scaled->width, scaled->height};
+        if (!m_data->videoScaler.ConvertRect(frame->width, frame->height, format, frame->data, frame->linesize, source,
+                                             scaled->width, scaled->height, scaledFormat,
+                                             scaled->data, scaled->linesize, target, m_data->fitFill))
+            throw std::runtime_error("Failed to scale video frame");
+    }
+    av_frame_copy_props(scaled, frame);
+    return scaled;
+}
+
+// Runs on the encoding thread right after the controller changes level, so
+// the next frame goes to the new encoder. If the new encoder cannot be
+// opened the old one carries on and adapting stops.
+void MediaWriter::ApplyQualityLevel() {
+    ME_TRACE_SCOPE("ApplyQualityLevel", "writer", Trace::kNoPts);
+    QualityController& quality = *m_data->quality;
+    const QualityLevel& level = quality.Current();
+
+    AVCodecContext* next;
+    try {
+        ScopedPlacement placement(m_data->placement);
+        // Open() refused global headers for adaptive writers.
+        next = OpenVideoEncoder(level.width, level.height, level.preset, false);
+    } catch (const std::exception&) {
+        quality.Revert();
+        return;
+    }
+
+    // Pending pictures of the old encoder are written before the new keyframe.
+    try {
+        WriteFrame(m_data->videoCtx, nullptr);
+    } catch (...) {
+        avcodec_free_context(&next);
+        throw;
+    }
+    AVCodecContext* old = m_data->videoCtx;
+    {
+        std::lock_guard<std::mutex> lock(m_data->videoCtxMutex);
+        m_data->videoCtx = next;
+    }
+    avcodec_free_context(&old);
+
+    AVFrame* scaled = m_data->videoFrame;
+    if (scaled->width != level.width || scaled->height != level.height) {
+        const int format = scaled->format;
+        av_frame_unref(scaled);
+        scaled->format = format;
+        scaled->width = level.width;
+        scaled->height = level.height;
+        if (av_frame_get_buffer(scaled, 32) < 0) throw std::runtime_error("Failed to allocate scaled frame");
+        m_data->placementBoundBytes += Placement::BindFrame(scaled, m_data->placement.numaNode);
+    }
+
+    m_data->qualityLevel.store(level.index, std::memory_order_relaxed);
+    m_data->qualityChanges.fetch_add(1, std::memory_order_relaxed);
+    if (m_data->qualityCallback) m_data->qualityCallback(quality.Previous(), level, quality.Load());
+}
+
+// Async submission
+void MediaWriter::StartAsync(size_t queueCapacity) {
+    if (!m_data->muxer) throw std::logic_error("StartAsync requires an open writer");
+    if (IsAsync()) throw std::logic_error("Writer is already asynchronous");
+    if (queueCapacity == 0) throw std::invalid_argument("Queue capacity must be positive");
+
+    const int numaNode = m_data->placement.numaNode;
+    if (numaNode >= 0) {
+        size_t bound = 0;
+        if (m_data->videoRing)
+            m_data->videoRing->ForEachSlot([&](VideoFrame& slot) {
+                bound += Placement::BindFrame(slot.NativePointer(), numaNode);
+            });
+        if (m_data->audioRing)
+            m_data->audioRing->ForEachSlot([&](AudioFrame& slot) {
+                bound += Placement::BindFrame(slot.NativePointer(), numaNode);
+            });
+        m_data->placementBoundBytes += bound;
+    }
+
+    m_data->queueCapacity = queueCapacity;
+    m_data->stopWorker = false;
+    m_data->async = true;
+    if (!m_data->strand) m_data->worker = std::thread(&MediaWriter::WorkerLoop, this);
+    // Frames published before the worker started.
+    if (m_data->ringSignal) NotifyWorker();
+}
+
+bool MediaWriter::TrySubmitVideoFrame(AVFrame* frame) {
+    if (!frame) return true;
+    if (!IsAsync()) throw std::logic_error("TrySubmit requires StartAsync");
+    CheckDirectInput(true);
+    return Submit(frame, true, false);
+}
+
+bool MediaWriter::TrySubmitAudioFrame(AVFrame* frame) {
+    if (!frame) return true;
+    if (!IsAsync()) throw std::logic_error("TrySubmit requires StartAsync");
+    CheckDirectInput(false);
+    return Submit(frame, false, false);
+}
+
+void MediaWriter::SetMemoryBudget(MemoryGovernor& governor, size_t limitBytes, MemoryPolicy policy) {
+    if (IsAsync()) throw std::logic_error("Memory budget must be set before StartAsync");
+    if (m_data->muxer && m_data->muxer->interleaver->BufferedPackets())
+        throw std::logic_error("Memory budget must be set before encoding");
+    m_data->memory = governor.CreateAccount(m_url.empty() ? "MediaWriter" : m_url, limitBytes, policy);
+    if (m_data->muxer) m_data->muxer->interleaver->SetMemoryAccount(m_data->memory.get());
+}
+
+// Ring frames are numbered and prepared on the consuming thread, so frames
+// submitted for the same stream from elsewhere would race them for pts and
+// duplicate state and be encoded out of order.
+void MediaWriter::CheckDirectInput(bool video) const {
+    if (video && m_data->videoRing) throw std::logic_error("Video frames come from the attached ring");
+    if (!video && m_data->audioRing) throw std::logic_error("Audio frames come from the attached ring");
+}
+
+struct MediaWriter::RingSignal {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool pending = false;
+
+    void Notify() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = true;
+        }
+        cv.notify_one();
+    }
+
+    // A ring frame held back for the memory budget is retried after a
+    // millisecond; the governor has no wakeup of its own.
+    void Wait(bool retrySoon) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (retrySoon) cv.wait_for(lock, std::chrono::milliseconds(1), [this] { return pending; });
+        else cv.wait(lock, [this] { return pending; });
+        pending = false;
+    }
+};
+
+// With rings the worker sleeps on the signal, which the rings' producers,
+// Submit and StopWorker all notify. The signal is shared with the publish
+// callbacks, so a producer that outlives the writer touches only it.
+void MediaWriter::AttachRingSignal() {
+    if (!m_data->ringSignal) m_data->ringSignal = std::make_shared<RingSignal>();
+    auto notify = [signal = m_data->ringSignal] { signal->Notify(); };
+    if (m_data->videoRing) m_data->videoRing->SetPublishCallback(notify);
+    if (m_data->audioRing) m_data->audioRing->SetPublishCallback(notify);
+}
+
+void MediaWriter::NotifyWorker() {
+    if (m_data->ringSignal) m_data->ringSignal->Notify();
+    else m_data->queueCv.notify_one();
+}
+
+namespace {
+
+struct ChargeGuard {
+    MemoryAccount* account;
+    size_t bytes;
+    ~ChargeGuard() { if (account) account->Release(bytes); }
+};
+
+} // namespace
+
+// Bytes kept alive while a frame sits in the queue.
+static size_t FrameBytes(const AVFrame* frame) {
+    size_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i) bytes += frame->buf[i]->size;
+    if (bytes) return bytes;
+
+    int size = frame->nb_samples > 0
+        ? av_samples_get_buffer_size(nullptr, frame->ch_layout.nb_channels, frame->nb_samples,
+                                     static_cast<AVSampleFormat>(frame->format), 1)
+        : av_image_get_buffer_size(static_cast<AVPixelFormat>(frame->format), frame->width, frame->height, 1);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+bool MediaWriter::Submit(AVFrame* frame, bool video, bool wait) {
+    RethrowAsyncError();
+    ME_TRACE_SCOPE(video ? "SubmitVideoFrame" : "SubmitAudioFrame", "writer", frame->pts);
+
+    // Hashed here, outside the queue lock, but only recorded once the frame
+    // is taken and has passed PrepareVideoFrame: a rejected frame must not
+    // become the duplicate reference, or retrying it would skip it.
+    const uint64_t hash = video ? HashForDuplicates(frame) : 0;
+
+    // Charge before taking the queue lock: a blocked charge waits for the
+    // worker, which needs the lock to release memory.
+    size_t bytes = 0;
+    if (m_data->memory) {
+        bytes = FrameBytes(frame);
+        bool droppable = video && frame->pict_type != AV_PICTURE_TYPE_I;
+        bool charged;
+        try {
+            charged = m_data->memory->Charge(bytes, droppable, wait);
+        } catch (const MemoryLimitError&) {
+            FailWriter(std::current_exception());
+            throw;
+        }
+        if (!charged) {
+            if (m_data->memory->Policy() != MemoryPolicy::DropNonReference) return false;
+            // Dropped frames still consume their timestamp.
+            std::lock_guard<std::mutex> lock(m_data->queueMutex);
+            PrepareVideoFrame(frame);
+            m_data->framesDroppedForMemory.fetch_add(1, std::memory_order_relaxed);
+            m_data->resetFrameHash.store(true, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    ChargeGuard charge{m_data->memory.get(), bytes};
+
+    std::unique_lock<std::mutex> lock(m_data->queueMutex);
+    if (m_data->queue.size() >= m_data->queueCapacity) {
+        if (!wait) return false;
+        m_data->spaceCv.wait(lock, [this] {
+            return m_data->queue.size() < m_data->queueCapacity || m_data->asyncError;
+        });
+        if (m_data->asyncError) {
+            lock.unlock();
+            RethrowAsyncError();
+        }
+    }
+
+    if (video) PrepareVideoFrame(frame);
+    else PrepareAudioFrame(frame);
+
+    if (video && IsDuplicateVideoFrame(frame, hash)) {
+        m_data->framesSkippedDuplicate.fetch_add(1, std::memory_order_relaxed);
+        return true;    // the charge is released on return
+    }
+
+    // A reference to refcounted caller buffers, or a copy of unowned ones.
+    AVFrame* queued = av_frame_alloc();
+    if (!queued || av_frame_ref(queued, frame) < 0) {
+        av_frame_free(&queued);
+        throw std::runtime_error("Failed to reference submitted frame");
+    }
+    m_data->queue.push_back({queued, video, bytes, NowMicroseconds()});
+    charge.account = nullptr;   // released by the worker
+
+    if (m_data->strand) {
+        bool schedule = !m_data->pumpScheduled;
+        m_data->pumpScheduled = true;
+        lock.unlock();
+        if (schedule) m_data->strand->Post([this] { PumpQueue(); });
+        return true;
+    }
+    lock.unlock();
+    NotifyWorker();
+    return true;
+}
+
+void MediaWriter::EncodeQueued(WriterPrivateData::QueuedFrame& item) {
+    try {
+        bool failed;
+        {
+            std::lock_guard<std::mutex> errorLock(m_data->queueMutex);
+            failed = static_cast<bool>(m_data->asyncError);
+        }
+        if (!failed) {
+            if (!item.video) EncodeAudio(item.frame);
+            else if (m_data->realtimeTargetUs) EncodePacedVideo(item.frame, NowMicroseconds() - item.enqueuedUs);
+            else EncodeVideo(item.frame);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> errorLock(m_data->queueMutex);
+        m_data->asyncError = std::current_exception();
+    }
+    // Dropping our reference is what tells the caller the buffer is reusable.
+    av_frame_free(&item.frame);
+    if (m_data->memory) m_data->memory->Release(item.bytes);
+}
+
+// Executor mode: encode one frame per task and repost, so writers sharing
+// the executor interleave instead of one draining its whole queue.
+void MediaWriter::PumpQueue() {
+    std::unique_lock<std::mutex> lock(m_data->queueMutex);
+    if (m_data->queue.empty()) {
+        m_data->pumpScheduled = false;
+        m_data->spaceCv.notify_all();
+        WakeWaiters(lock);
+        return;
+    }
+    WriterPrivateData::QueuedFrame item = m_data->queue.front();
+    m_data->queue.pop_front();
+    ++m_data->inFlight;
+    lock.unlock();
+    m_data->spaceCv.notify_one();
+
+    EncodeQueued(item);
+
+    lock.lock();
+    --m_data->inFlight;
+    if (m_data->queue.empty()) {
+        m_data->pumpScheduled = false;
+        m_data->spaceCv.notify_all();
+        WakeWaiters(lock);
+        return;
+    }
+    WakeWaiters(lock);
+    lock.unlock();
+    m_data->strand->Post([this] { PumpQueue(); });
+}
+
+void MediaWriter::WorkerLoop() {
+    Placement::ApplyToCurrentThread(m_data->placement);
+    RingSignal* const rings = m_data->ringSignal.get();
+    auto guarded = [this](auto&& fn) {
+        try {
+            fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> errorLock(m_data->queueMutex);
+            m_data->asyncError = std::current_exception();
+        }
+    };
+
+    std::unique_lock<std::mutex> lock(m_data->queueMutex);
+    while (true) {
+        if (!rings) {
+            m_data->queueCv.wait(lock, [this] { return m_data->stopWorker || !m_data->queue.empty(); });
+        } else if (m_data->queue.empty() && !m_data->stopWorker) {
+            const bool retrySoon = m_data->ringWaitingForMemory;
+            lock.unlock();
+            rings->Wait(retrySoon);
+            lock.lock();
+        }
+        bool stopping = m_data->stopWorker;
+
+        if (!m_data->queue.empty()) {
+            WriterPrivateData::QueuedFrame item = m_data->queue.front();
+            m_data->queue.pop_front();
+            ++m_data->inFlight;
+            lock.unlock();
+            m_data->spaceCv.notify_one();
+
+            EncodeQueued(item);
+
+            lock.lock();
+            --m_data->inFlight;
+            m_data->spaceCv.notify_all();
+            WakeWaiters(lock);
+        }
+
+        if (rings) {
+            lock.unlock();
+            guarded([this] { ConsumeRings(); });
+            lock.lock();
+        }
+
+        if (stopping && m_data->queue.empty()) break;
+    }
+}
+
+// Frame rings
+void MediaWriter::AttachVideoRing(FrameRing<VideoFrame>* ring) {
+    if (IsAsync()) throw std::logic_error("Rings must be attached before StartAsync");
+    if (m_data->strand) throw std::logic_error("Frame rings cannot be used with a shared executor");
+    m_data->videoRing = ring;
+    AttachRingSignal();
+}
+
+void MediaWriter::AttachAudioRing(FrameRing<AudioFrame>* ring) {
+    if (IsAsync()) throw std::logic_error("Rings must be attached before StartAsync");
+    if (m_data->strand) throw std::logic_error("Frame rings cannot be used with a shared executor");
+    m_data->audioRing = ring;
+    AttachRingSignal();
+}
+
+// Ring slots are handed back to the producer as soon as EndRead() runs, so the
+// encoder must not keep a reference to them. Sending a non-refcounted view
+// makes libavcodec copy whatever it needs to retain.
+static void MakeUnownedView(AVFrame* view, const AVFrame* src) {
+    av_frame_unref(view);
+    av_frame_copy_props(view, src);
+    view->format = src->format;
+    view->width = src->width;
+    view->height = src->height;
+    view->nb_samples = src->nb_samples;
+    view->sample_rate = src->sample_rate;
+    av_channel_layout_copy(&view->ch_layout, &src->ch_layout);
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i) {
+        view->data[i] = src->data[i];
+        view->linesize[i] = src->linesize[i];
+    }
+    view->extended_data = view->data;
+}
+
+size_t MediaWriter::ConsumeRings() {
+    size_t consumed = 0;
+    if (!m_data->ringView) {
+        m_data->ringView = av_frame_alloc();
+        if (!m_data->ringView) throw std::bad_alloc();
+    }
+    AVFrame* view = m_data->ringView;
+    m_data->ringWaitingForMemory = false;
+
+    // A frame the budget cannot take yet stays claimed: BeginRead() hands
+    // the same slot back on the next pass.
+    if (FrameRing<VideoFrame>* ring = m_data->videoRing) {
+        while (VideoFrame* slot = ring->BeginRead()) {
+            bool taken;
+            try {
+                MakeUnownedView(view, slot->NativePointer());
+                view->pts = AV_NOPTS_VALUE;
+                taken = EncodeRingFrame(view, true);
+            } catch (...) {
+                av_frame_unref(view);
+                ring->EndRead();
+                throw;
+            }
+            av_frame_unref(view);
+            if (!taken) break;
+            ring->EndRead();
+            ++consumed;
+        }
+    }
+
+    if (FrameRing<AudioFrame>* ring = m_data->audioRing) {
+        while (AudioFrame* slot = ring->BeginRead()) {
+            bool taken;
+            try {
+                MakeUnownedView(view, slot->NativePointer());
+                view->pts = AV_NOPTS_VALUE;
+                taken = EncodeRingFrame(view, false);
+            } catch (...) {
+                av_frame_unref(view);
+                ring->EndRead();
+                throw;
+            }
+            av_frame_unref(view);
+            if (!taken) break;
+            ring->EndRead();
+            ++consumed;
+        }
+    }
+    return consumed;
+}
+
+// Same handling as a submitted frame, minus the queue: charged to the
+// memory budget while it is encoded, and paced in realtime mode. Returns
+// false when the budget has no room and the frame must wait in its ring.
+bool MediaWriter::EncodeRingFrame(AVFrame* frame, bool video) {
+    size_t bytes = 0;
+    if (m_data->memory) {
+        bytes = FrameBytes(frame);
+        bool droppable = video && frame->pict_type != AV_PICTURE_TYPE_I;
+        bool charged;
+        try {
+            // Never waits: the budget may be held by this writer's own
+            // queue, which only this thread drains.
+            charged = m_data->memory->Charge(bytes, droppable, false);
+        } catch (const MemoryLimitError&) {
+            FailWriter(std::current_exception());
+            throw;
+        }
+        if (!charged) {
+            if (m_data->memory->Policy() != MemoryPolicy::DropNonReference) {
+                m_data->ringWaitingForMemory = true;
+                return false;
+            }
+            // Dropped frames still consume their timestamp.
+            PrepareVideoFrame(frame);
+            m_data->framesDroppedForMemory.fetch_add(1, std::memory_order_relaxed);
+            m_data->resetFrameHash.store(true, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    ChargeGuard charge{m_data->memory.get(), bytes};
+
+    if (!video) {
+        PrepareAudioFrame(frame);
+        EncodeAudio(frame);
+        return true;
+    }
+    PrepareVideoFrame(frame);
+    if (IsDuplicateVideoFrame(frame)) {
+        m_data->framesSkippedDuplicate.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    if (m_data->realtimeTargetUs) EncodePacedVideo(frame, m_data->backlogUs);
+    else EncodeVideo(frame);
+    return true;
+}
+
+MediaWriter::WriterStats MediaWriter::GetStats() const {
+    WriterStats stats;
+    stats.videoFramesEncoded = m_data->videoFramesEncoded.load(std::memory_order_relaxed);
+    stats.audioFramesEncoded = m_data->audioFramesEncoded.load(std::memory_order_relaxed);
+    stats.packetsWritten = m_data->packetsWritten.load(std::memory_order_relaxed);
+    stats.bytesWritten = m_data->bytesWritten.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_data->queueMutex);
+        stats.queueDepth = m_data->queue.size();
+    }
+    if (m_data->videoRing) stats.videoRing = m_data->videoRing->Stats();
+    if (m_data->audioRing) stats.audioRing = m_data->audioRing->Stats();
+    if (m_data->strand) {
+        stats.executorQueueDepth = m_data->strand->QueueDepth();
+        stats.executorTasksRun = m_data->strand->TasksRun();
+        stats.executorSteals = m_data->strand->Steals();
+    }
+    if (m_data->memory) stats.memoryUsage = m_data->memory->Usage();
+    stats.framesDroppedForMemory = m_data->framesDroppedForMemory.load(std::memory_order_relaxed);
+    stats.framesDroppedLate = m_data->framesDroppedLate.load(std::memory_order_relaxed);
+    stats.framesLate = m_data->framesLate.load(std::memory_order_relaxed);
+    stats.averageEncodeMicroseconds = m_data->encodeEmaUs.load(std::memory_order_relaxed);
+    stats.framesSkippedDuplicate = m_data->framesSkippedDuplicate.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+        if (m_data->muxer) {
+            stats.interleaveBufferedBytes = m_data->muxer->interleaver->BufferedBytes();
+            stats.interleaveForcedWrites = m_data->muxer->interleaver->ForcedWrites();
+        }
+    }
+    stats.rollovers = m_data->rollovers.load(std::memory_order_relaxed);
+    if (m_data->preview) {
+        stats.previewsEncoded = m_data->preview->PreviewsEncoded();
+        stats.previewsSkipped = m_data->preview->PreviewsSkipped();
+    }
+    stats.qualityLevel = m_data->qualityLevel.load(std::memory_order_relaxed);
+    stats.qualityChanges = m_data->qualityChanges.load(std::memory_order_relaxed);
+    stats.placement = m_data->placement;
+    stats.placement.boundBytes = m_data->placementBoundBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MediaWriter::Flush() {
+    if (!IsAsync()) {
+        RethrowAsyncError();
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_data->queueMutex);
+    m_data->spaceCv.wait(lock, [this] {
+        return m_data->queue.empty() && m_data->inFlight == 0 && !m_data->pumpScheduled;
+    });
+    lock.unlock();
+    RethrowAsyncError();
+}
+
+void MediaWriter::StopWorker() {
+    if (!IsAsync()) return;
+    m_data->async = false;
+    if (m_data->strand) {
+        // The pump captures `this`; it must finish before the writer goes away,
+        // including the waiter callbacks it runs after clearing pumpScheduled.
+        std::unique_lock<std::mutex> lock(m_data->queueMutex);
+        m_data->spaceCv.wait(lock, [this] {
+            return m_data->queue.empty() && m_data->inFlight == 0 && !m_data->pumpScheduled &&
+                   m_data->wakingWaiters == 0;
+        });
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_data->queueMutex);
+            m_data->stopWorker = true;
+        }
+        NotifyWorker();
+        m_data->worker.join();
+    }
+    // Nothing will make progress any more; waiters find the writer synchronous.
+    std::unique_lock<std::mutex> lock(m_data->queueMutex);
+    WakeWaiters(lock);
+}
+
+bool MediaWriter::NotifyWhenWritable(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(m_data->queueMutex);
+    if (!m_data->async || (m_data->queue.empty() && m_data->inFlight == 0)) return false;
+    m_data->writableWaiters.push_back(std::move(callback));
+    return true;
+}
+
+void MediaWriter::NotifyWhenFlushed(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(m_data->queueMutex);
+        if (m_data->async && !(m_data->queue.empty() && m_data->inFlight == 0 && !m_data->pumpScheduled)) {
+            m_data->flushedWaiters.push_back(std::move(callback));
+            return;
+        }
+    }
+    callback();
+}
+
+// Called with queueMutex held, which is released while the callbacks run.
+// A callback may resume a coroutine that closes and destroys the writer, so
+// StopWorker waits on wakingWaiters until the caller is done with m_data;
+// callers must not touch it again once they release the lock.
+void MediaWriter::WakeWaiters(std::unique_lock<std::mutex>& lock) {
+    std::vector<std::function<void()>> due;
+    due.swap(m_data->writableWaiters);
+    if (m_data->queue.empty() && m_data->inFlight == 0 && !m_data->pumpScheduled) {
+        for (auto& callback : m_data->flushedWaiters) due.push_back(std::move(callback));
+        m_data->flushedWaiters.clear();
+    }
+    if (due.empty()) return;
+    ++m_data->wakingWaiters;
+    lock.unlock();
+    for (auto& callback : due) callback();
+    lock.lock();
+    if (--m_data->wakingWaiters == 0) m_data->spaceCv.notify_all();
+}
+
+void MediaWriter::RethrowAsyncError() {
+    std::lock_guard<std::mutex> lock(m_data->queueMutex);
+    if (m_data->asyncError) std::rethrow_exception(m_data->asyncError);
+}
+
+// A memory limit under MemoryPolicy::Fail is fatal like an encoding error:
+// the first error is kept and producers blocked on the queue are released.
+void MediaWriter::FailWriter(std::exception_ptr error) {
+    {
+        std::lock_guard<std::mutex> lock(m_data->queueMutex);
+        if (!m_data->asyncError) m_data->asyncError = error;
+    }
+    m_data->spaceCv.notify_all();
+}
+
+AVPixelFormat MediaWriter::GetVideoPixelFormat() const {
+    return m_data->videoPixelFormat;
+}
+
+AVSampleFormat MediaWriter::GetAudioSampleFormat() const {
+    return m_data->audioCtx ? m_data->audioCtx->sample_fmt : AV_SAMPLE_FMT_NONE;
+}
+
+int MediaWriter::GetAudioFrameSize() const {
+    if (!m_data->audioCtx) return 0;
+    return m_data->audioCtx->frame_size;
+}
+
+// Rollover
+void MediaWriter::Rollover(const std::string& newUrl) {
+    if (!m_data->muxer) throw std::logic_error("Rollover requires an open writer");
+    CollectRetiredMuxers(false);
+    {
+        std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+        if (m_data->nextMuxer) throw std::logic_error("A rollover is already pending");
+    }
+
+    // File creation and the header happen here, off the encoding thread.
+    std::unique_ptr<Muxer> next = CreateMuxer(newUrl);
+    {
+        std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+        m_data->nextMuxer = std::move(next);
+        m_data->rolloverPts = AV_NOPTS_VALUE;
+    }
+    m_data->rolloverPending.store(true, std::memory_order_release);
+}
+
+// The first video frame actually encoded after Rollover() becomes the
+// keyframe the new file starts with.
+bool MediaWriter::ClaimRolloverKeyframe(int64_t pts) {
+    if (!m_data->rolloverPending.load(std::memory_order_acquire)) return false;
+    std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+    if (!m_data->nextMuxer || m_data->rolloverPts != AV_NOPTS_VALUE) return false;
+    m_data->rolloverPts = pts;
+    return true;
+}
+
+// Runs on the encoding thread for each packet while a rollover is pending.
+// Video switches at the forced keyframe's packet; audio-only writers switch
+// at the next packet.
+void MediaWriter::SwitchMuxerIfDue(const AVPacket& pkt, bool video) {
+    std::unique_ptr<Muxer> next;
+    {
+        std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+        if (!m_data->nextMuxer) return;
+        if (video) {
+            if (m_data->rolloverPts == AV_NOPTS_VALUE || !(pkt.flags & AV_PKT_FLAG_KEY) ||
+                pkt.pts < m_data->rolloverPts)
+                return;
+        } else if (m_data->videoCtx) {
+            return;
+        }
+        next = std::move(m_data->nextMuxer);
+        m_data->rolloverPts = AV_NOPTS_VALUE;
+        m_data->rolloverPending.store(false, std::memory_order_release);
+    }
+
+    if (video) {
+        next->videoOffset = pkt.pts;
+        if (m_data->audioCtx)
+            next->audioOffset = av_rescale_q(pkt.pts, m_data->videoCtx->time_base, m_data->audioCtx->time_base);
+    } else {
+        next->audioOffset = pkt.pts;
+    }
+
+    RetireDrainingMuxer();
+    {
+        // Readers on other threads (GetStats, SetMaxInterleaveDelta) take
+        // the lock; the encoding thread itself needs none to use muxer.
+        std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+        m_data->drainingMuxer = std::move(m_data->muxer);
+        m_data->muxer = std::move(next);
+    }
+    if (!video || !m_data->audioCtx) RetireDrainingMuxer();
+    m_data->rollovers.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Buffered packets are written here (bounded by the interleave delta);
+// the trailer and file close run on a background thread.
+void MediaWriter::RetireDrainingMuxer() {
+    std::shared_ptr<Muxer> old(std::move(m_data->drainingMuxer));
+    if (!old) return;
+    old->interleaver->Flush();
+
+    std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+    m_data->retiring.push_back(std::async(std::launch::async, [old] {
+        ME_TRACE_SCOPE("av_write_trailer", "mux", Trace::kNoPts);
+        if (av_write_trailer(old->formatCtx) < 0)
+            throw std::runtime_error("Failed to write trailer for " + old->url);
+    }));
+}
+
+void MediaWriter::CollectRetiredMuxers(bool wait) {
+    std::vector<std::future<void>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+        auto& retiring = m_data->retiring;
+        for (auto it = retiring.begin(); it != retiring.end();) {
+            if (wait || it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                finished.push_back(std::move(*it));
+                it = retiring.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& done : finished) done.get();
 }
 
 // Cleanup
 void MediaWriter::Close() {
-    if (!m_data || !m_data->formatCtx) return;
+    if (!m_data || !m_data->muxer) return;
+
+    {
+        ME_TRACE_SCOPE("Close", "writer", Trace::kNoPts);
+        StopWorker();
+        RethrowAsyncError();
+
+        if (m_data->videoCtx) WriteFrame(m_data->videoCtx, nullptr);
+        if (m_data->audioCtx) WriteFrame(m_data->audioCtx, nullptr);
+
+        // A rollover that never reached its keyframe leaves an empty file.
+        RetireDrainingMuxer();
+        {
+            std::lock_guard<std::mutex> lock(m_data->rolloverMutex);
+            m_data->drainingMuxer = std::move(m_data->nextMuxer);
+            m_data->rolloverPending.store(false, std::memory_order_release);
+        }
+        RetireDrainingMuxer();
 
-    if (m_data->videoCtx) WriteFrame(m_data->formatCtx, m_data->videoCtx, m_data->videoStream, nullptr);
-    if (m_data->audioCtx) WriteFrame(m_data->formatCtx, m_data->audioCtx, m_data->audioStream, nullptr);
+        m_data->muxer->interleaver->Flush();
+        av_write_trailer(m_data->muxer->formatCtx);
 
-    av_write_trailer(m_data->formatCtx);
+        // Tee outputs report their own failures through GetOutputStats().
+        {
+            std::lock_guard<std::mutex> lock(m_data->outputsMutex);
+            for (auto& output : m_data->outputs) output->Finish();
+        }
+        m_data->preview.reset();
+        CollectRetiredMuxers(true);
+    }
+
+    if (!m_traceOutput.empty() && Trace::IsEnabled()) {
+        Trace::WriteChromeTrace(m_traceOutput);
+    }
 }
 
-} // namespace MediaEncoder
\ No newline at end of file
+} // namespace MediaEncoder
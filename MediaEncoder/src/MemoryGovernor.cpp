@@ -0,0 +1,140 @@
+#include "MemoryGovernor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace MediaEncoder {
+
+MemoryAccount::MemoryAccount(MemoryGovernor& governor, std::string name, size_t limit, MemoryPolicy policy)
+    : m_governor(governor), m_name(std::move(name)), m_limit(limit), m_policy(policy) {}
+
+MemoryAccount::~MemoryAccount() {
+    std::lock_guard<std::mutex> lock(m_governor.m_mutex);
+    m_governor.m_usage -= m_usage;
+    m_usage = 0;
+    m_governor.m_released.notify_all();
+}
+
+// A charge always fits when nothing at all is outstanding, so a single frame
+// larger than the limit cannot wait forever.
+bool MemoryAccount::Fits(size_t bytes) const {
+    if (m_governor.m_usage == 0) return true;
+    if (m_limit && m_usage + bytes > m_limit) return false;
+    if (m_governor.m_limit && m_governor.m_usage + bytes > m_governor.m_limit) return false;
+    return true;
+}
+
+bool MemoryAccount::Charge(size_t bytes, bool droppable, bool wait) {
+    std::unique_lock<std::mutex> lock(m_governor.m_mutex);
+    if (!Fits(bytes)) {
+        switch (m_policy) {
+        case MemoryPolicy::Block:
+            if (!wait) return false;
+            ++m_blocked;
+            m_governor.m_released.wait(lock, [&] { return Fits(bytes); });
+            break;
+
+        case MemoryPolicy::DropNonReference:
+            if (droppable) {
+                ++m_dropped;
+                return false;
+            }
+            break;
+
+        case MemoryPolicy::Fail:
+            ++m_failed;
+            throw MemoryLimitError("Memory limit exceeded for " + m_name);
+        }
+    }
+
+    m_usage += bytes;
+    m_peak = std::max(m_peak, m_usage);
+    m_governor.m_usage += bytes;
+    m_governor.m_peak = std::max(m_governor.m_peak, m_governor.m_usage);
+    return true;
+}
+
+void MemoryAccount::Release(size_t bytes) {
+    if (bytes == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(m_governor.m_mutex);
+        bytes = std::min(bytes, m_usage);
+        m_usage -= bytes;
+        m_governor.m_usage -= bytes;
+    }
+    m_governor.m_released.notify_all();
+}
+
+size_t MemoryAccount::Usage() const {
+    std::lock_guard<std::mutex> lock(m_governor.m_mutex);
+    return m_usage;
+}
+
+MemoryAccountStats MemoryAccount::Stats() const {
+    std::lock_guard<std::mutex> lock(m_governor.m_mutex);
+    MemoryAccountStats stats;
+    stats.name = m_name;
+    stats.usage = m_usage;
+    stats.peak = m_peak;
+    stats.limit = m_limit;
+    stats.blocked = m_blocked;
+    stats.dropped = m_dropped;
+    stats.failed = m_failed;
+    return stats;
+}
+
+MemoryGovernor::MemoryGovernor(size_t globalLimit) : m_limit(globalLimit) {}
+
+MemoryGovernor& MemoryGovernor::Shared() {
+    static MemoryGovernor governor;
+    return governor;
+}
+
+void MemoryGovernor::SetGlobalLimit(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_limit = bytes;
+    }
+    m_released.notify_all();
+}
+
+size_t MemoryGovernor::GlobalLimit() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limit;
+}
+
+size_t MemoryGovernor::Usage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_usage;
+}
+
+size_t MemoryGovernor::PeakUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peak;
+}
+
+std::shared_ptr<MemoryAccount> MemoryGovernor::CreateAccount(const std::string& name, size_t limit,
+                                                            MemoryPolicy policy) {
+    auto account = std::make_shared<MemoryAccount>(*this, name, limit, policy);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_accounts.erase(std::remove_if(m_accounts.begin(), m_accounts.end(),
+                                    [](const std::weak_ptr<MemoryAccount>& a) { return a.expired(); }),
+                     m_accounts.end());
+    m_accounts.push_back(account);
+    return account;
+}
+
+std::vector<MemoryAccountStats> MemoryGovernor::GetStats() const {
+    std::vector<std::shared_ptr<MemoryAccount>> accounts;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& weak : m_accounts) {
+            if (auto account = weak.lock()) accounts.push_back(std::move(account));
+        }
+    }
+    std::vector<MemoryAccountStats> stats;
+    for (const auto& account : accounts) stats.push_back(account->Stats());
+    return stats;
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,213 @@
+#include "OutputSink.h"
+#include "PacketInterleaver.h"
+#include "Trace.h"
+
+#include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+namespace MediaEncoder {
+
+OutputSink::OutputSink(std::string url, const AVOutputFormat* format,
+                       const AVCodecContext* videoCtx, const AVCodecContext* audioCtx,
+                       size_t queueCapacity, int64_t maxInterleaveUs)
+    : m_url(std::move(url)), m_format(format),
+      m_capacity(queueCapacity), m_maxInterleaveUs(maxInterleaveUs)
+{
+    if (queueCapacity == 0) throw std::invalid_argument("Output queue capacity must be positive");
+
+    if (videoCtx) {
+        m_videoPar = avcodec_parameters_alloc();
+        if (!m_videoPar || avcodec_parameters_from_context(m_videoPar, videoCtx) < 0) {
+            avcodec_parameters_free(&m_videoPar);
+            throw std::runtime_error("Failed to copy video parameters");
+        }
+        m_videoTimeBase = videoCtx->time_base;
+        // The first packet handed over may be mid-GOP; start at a keyframe.
+        m_resync = true;
+    }
+    if (audioCtx) {
+        m_audioPar = avcodec_parameters_alloc();
+        if (!m_audioPar || avcodec_parameters_from_context(m_audioPar, audioCtx) < 0) {
+            avcodec_parameters_free(&m_videoPar);
+            avcodec_parameters_free(&m_audioPar);
+            throw std::runtime_error("Failed to copy audio parameters");
+        }
+        m_audioTimeBase = audioCtx->time_base;
+    }
+
+    m_thread = std::thread(&OutputSink::Run, this);
+}
+
+OutputSink::~OutputSink() {
+    Finish();
+    for (auto& item : m_queue) av_packet_free(&item.packet);
+    avcodec_parameters_free(&m_videoPar);
+    avcodec_parameters_free(&m_audioPar);
+}
+
+void OutputSink::Push(const AVPacket* pkt, bool video) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_failed || m_finishing) return;
+
+    if (m_resync) {
+        if (!(video && (pkt->flags & AV_PKT_FLAG_KEY))) {
+            ++m_dropped;
+            return;
+        }
+        m_resync = false;
+    }
+    if (m_queue.size() >= m_capacity) {
+        ++m_dropped;
+        m_resync = m_videoPar != nullptr;
+        return;
+    }
+
+    // A new reference to the encoder's buffer; the payload is not copied.
+    AVPacket* ref = av_packet_clone(pkt);
+    if (!ref) {
+        ++m_dropped;
+        return;
+    }
+    m_queue.push_back({ref, video});
+    m_cv.notify_one();
+}
+
+void OutputSink::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finishing = true;
+    }
+    m_cv.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+OutputStats OutputSink::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    OutputStats stats;
+    stats.url = m_url;
+    stats.packetsWritten = m_written.load(std::memory_order_relaxed);
+    stats.packetsDropped = m_dropped;
+    stats.queueDepth = m_queue.size();
+    stats.failed = m_failed;
+    stats.error = m_error;
+    return stats;
+}
+
+void OutputSink::Run() {
+    try {
+        // Opening can block (pipes, network), so it happens here too.
+        OpenOutput();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_cv.wait(lock, [this] { return m_finishing || !m_queue.empty(); });
+            if (m_queue.empty()) break;
+
+            QueuedPacket item = m_queue.front();
+            m_queue.pop_front();
+            lock.unlock();
+            try {
+                WritePacket(item.packet, item.video);
+            } catch (...) {
+                av_packet_free(&item.packet);
+                throw;
+            }
+            av_packet_free(&item.packet);
+            lock.lock();
+        }
+        lock.unlock();
+
+        m_interleaver->Flush();
+        if (av_write_trailer(m_formatCtx) < 0) throw std::runtime_error("Failed to write trailer");
+        CloseOutput();
+    } catch (const std::exception& ex) {
+        CloseOutput();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = true;
+        m_error = ex.what();
+        for (auto& item : m_queue) av_packet_free(&item.packet);
+        m_queue.clear();
+    }
+}
+
+void OutputSink::OpenOutput() {
+    avformat_alloc_output_context2(&m_formatCtx, m_format, nullptr, m_url.c_str());
+    if (!m_formatCtx) throw std::runtime_error("Failed to allocate output context");
+
+    if (m_videoPar) {
+        m_videoStream = avformat_new_stream(m_formatCtx, nullptr);
+        if (!m_videoStream || avcodec_parameters_copy(m_videoStream->codecpar, m_videoPar) < 0)
+            throw std::runtime_error("Failed to create video stream");
+        m_videoStream->time_base = m_videoTimeBase;
+
+        // Encoders opened for a global-header container keep SPS/PPS out of
+        // the bitstream; formats such as MPEG-TS need them before keyframes.
+        if (m_videoPar->extradata_size > 0 && !(m_format->flags & AVFMT_GLOBALHEADER)) {
+            const AVBitStreamFilter* filter = av_bsf_get_by_name("dump_extra");
+            if (filter && av_bsf_alloc(filter, &m_headerFilter) >= 0) {
+                avcodec_parameters_copy(m_headerFilter->par_in, m_videoPar);
+                m_headerFilter->time_base_in = m_videoTimeBase;
+                av_opt_set(m_headerFilter->priv_data, "freq", "keyframe", 0);
+                if (av_bsf_init(m_headerFilter) < 0) av_bsf_free(&m_headerFilter);
+            }
+        }
+    }
+    if (m_audioPar) {
+        m_audioStream = avformat_new_stream(m_formatCtx, nullptr);
+        if (!m_audioStream || avcodec_parameters_copy(m_audioStream->codecpar, m_audioPar) < 0)
+            throw std::runtime_error("Failed to create audio stream");
+        m_audioStream->time_base = m_audioTimeBase;
+    }
+
+    if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&m_formatCtx->pb, m_url.c_str(), AVIO_FLAG_WRITE) < 0)
+            throw std::runtime_error("Failed to open " + m_url);
+    }
+    if (avformat_write_header(m_formatCtx, nullptr) < 0)
+        throw std::runtime_error("Failed to write header for " + m_url);
+
+    std::vector<AVRational> timeBases;
+    for (unsigned i = 0; i < m_formatCtx->nb_streams; ++i)
+        timeBases.push_back(m_formatCtx->streams[i]->time_base);
+    m_interleaver = std::make_unique<PacketInterleaver>(std::move(timeBases), [this](AVPacket* pkt) {
+        ME_TRACE_SCOPE("av_write_frame", "tee", pkt->pts);
+        if (av_write_frame(m_formatCtx, pkt) < 0) throw std::runtime_error("Failed to write to " + m_url);
+        m_written.fetch_add(1, std::memory_order_relaxed);
+    });
+    m_interleaver->SetMaxDeltaMicroseconds(m_maxInterleaveUs);
+}
+
+void OutputSink::WritePacket(AVPacket* pkt, bool video) {
+    AVStream* stream = video ? m_videoStream : m_audioStream;
+    AVRational codecTimeBase = video ? m_videoTimeBase : m_audioTimeBase;
+
+    if (video && m_headerFilter) {
+        if (av_bsf_send_packet(m_headerFilter, pkt) < 0) throw std::runtime_error("dump_extra failed");
+        while (av_bsf_receive_packet(m_headerFilter, pkt) == 0) {
+            av_packet_rescale_ts(pkt, codecTimeBase, stream->time_base);
+            pkt->stream_index = stream->index;
+            m_interleaver->Push(pkt);
+        }
+        return;
+    }
+
+    av_packet_rescale_ts(pkt, codecTimeBase, stream->time_base);
+    pkt->stream_index = stream->index;
+    m_interleaver->Push(pkt);
+}
+
+void OutputSink::CloseOutput() {
+    m_interleaver.reset();
+    if (m_headerFilter) av_bsf_free(&m_headerFilter);
+    if (m_formatCtx) {
+        if (!(m_formatCtx->oformat->flags & AVFMT_NOFILE)) avio_closep(&m_formatCtx->pb);
+        avformat_free_context(m_formatCtx);
+        m_formatCtx = nullptr;
+    }
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,126 @@
+#include "PacketInterleaver.h"
+#include "MemoryGovernor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+namespace MediaEncoder {
+
+PacketInterleaver::PacketInterleaver(std::vector<AVRational> timeBases, WriteFunction write)
+    : m_timeBases(std::move(timeBases)), m_queues(m_timeBases.size()), m_write(std::move(write)) {}
+
+PacketInterleaver::~PacketInterleaver() {
+    Clear();
+}
+
+int64_t PacketInterleaver::Timestamp(const AVPacket* pkt) const {
+    return pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+}
+
+int64_t PacketInterleaver::Microseconds(int stream, int64_t ts) const {
+    return av_rescale_q(ts, m_timeBases[stream], AVRational{1, 1000000});
+}
+
+void PacketInterleaver::Push(AVPacket* pkt) {
+    if (pkt->stream_index < 0 || pkt->stream_index >= static_cast<int>(m_queues.size()))
+        throw std::invalid_argument("Packet stream index out of range");
+
+    AVPacket* owned = av_packet_alloc();
+    if (!owned) throw std::bad_alloc();
+    av_packet_move_ref(owned, pkt);
+    if (av_packet_make_refcounted(owned) < 0) {
+        av_packet_free(&owned);
+        throw std::runtime_error("Failed to reference packet");
+    }
+
+    size_t size = static_cast<size_t>(owned->size);
+    size_t charged = 0;
+    try {
+        if (m_memory && m_memory->Charge(size, false, false)) charged = size;
+    } catch (...) {
+        av_packet_free(&owned);
+        throw;
+    }
+
+    int stream = owned->stream_index;
+    int64_t ts = Timestamp(owned);
+    if (ts != AV_NOPTS_VALUE) m_newest = std::max(m_newest, Microseconds(stream, ts));
+    m_queues[stream].push_back({owned, charged});
+    m_bufferedBytes.fetch_add(size, std::memory_order_relaxed);
+    m_bufferedPackets.fetch_add(1, std::memory_order_relaxed);
+
+    Drain(false);
+}
+
+void PacketInterleaver::Flush() {
+    Drain(true);
+}
+
+void PacketInterleaver::Clear() {
+    for (auto& queue : m_queues) {
+        for (auto& entry : queue) {
+            if (m_memory) m_memory->Release(entry.charged);
+            av_packet_free(&entry.packet);
+        }
+        queue.clear();
+    }
+    m_bufferedBytes.store(0, std::memory_order_relaxed);
+    m_bufferedPackets.store(0, std::memory_order_relaxed);
+}
+
+void PacketInterleaver::Drain(bool flush) {
+    while (true) {
+        int next = -1;
+        bool everyStreamQueued = true;
+        for (int i = 0; i < static_cast<int>(m_queues.size()); ++i) {
+            if (m_queues[i].empty()) {
+                everyStreamQueued = false;
+                continue;
+            }
+            if (next < 0) {
+                next = i;
+                continue;
+            }
+            int64_t candidate = Timestamp(m_queues[i].front().packet);
+            int64_t best = Timestamp(m_queues[next].front().packet);
+            if (best == AV_NOPTS_VALUE) continue;
+            if (candidate == AV_NOPTS_VALUE ||
+                av_compare_ts(candidate, m_timeBases[i], best, m_timeBases[next]) < 0)
+                next = i;
+        }
+        if (next < 0) return;
+
+        if (!flush && !everyStreamQueued) {
+            int64_t ts = Timestamp(m_queues[next].front().packet);
+            const int64_t maxDelta = m_maxDelta.load(std::memory_order_relaxed);
+            bool overdue = maxDelta > 0 && ts != AV_NOPTS_VALUE &&
+                           m_newest - Microseconds(next, ts) > maxDelta;
+            if (!overdue) return;
+            m_forcedWrites.fetch_add(1, std::memory_order_relaxed);
+        }
+        WriteHead(next);
+    }
+}
+
+void PacketInterleaver::WriteHead(int stream) {
+    Entry entry = m_queues[stream].front();
+    m_queues[stream].pop_front();
+    m_bufferedBytes.fetch_sub(static_cast<size_t>(entry.packet->size), std::memory_order_relaxed);
+    m_bufferedPackets.fetch_sub(1, std::memory_order_relaxed);
+
+    struct Cleanup {
+        Entry& entry;
+        MemoryAccount* memory;
+        ~Cleanup() {
+            if (memory) memory->Release(entry.charged);
+            av_packet_free(&entry.packet);
+        }
+    } cleanup{entry, m_memory};
+    m_write(entry.packet);
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,224 @@
+#include "Placement.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(SYS_mbind) && defined(SYS_set_mempolicy) && defined(SYS_get_mempolicy)
+#define MEDIAENCODER_HAVE_NUMA 1
+#endif
+#endif
+
+namespace MediaEncoder {
+
+namespace {
+
+#if defined(MEDIAENCODER_HAVE_NUMA)
+// From <linux/mempolicy.h>; not every libc ships numaif.h.
+constexpr int kMpolPreferred = 1;
+constexpr unsigned kMpolMfMove = 1u << 1;
+#endif
+
+// Matches cpu_set_t; also used for node masks.
+constexpr size_t kMaskBits = 1024;
+constexpr size_t kWordBits = 8 * sizeof(unsigned long);
+constexpr size_t kMaskWords = kMaskBits / kWordBits;
+
+// "0-3,8,10-11", the format of the sysfs cpulist and online files.
+std::vector<int> ParseList(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream stream(text);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        try {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int value = first; value <= last; ++value) values.push_back(value);
+        } catch (const std::exception&) {
+        }
+    }
+    return values;
+}
+
+std::string ReadLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+std::vector<int> OnlineNodes() {
+    return ParseList(ReadLine("/sys/devices/system/node/online"));
+}
+
+#if defined(__linux__)
+std::vector<unsigned long> ToMask(const std::vector<int>& bits) {
+    std::vector<unsigned long> mask(kMaskWords, 0);
+    for (int bit : bits) {
+        if (bit >= 0 && static_cast<size_t>(bit) < kMaskBits)
+            mask[bit / kWordBits] |= 1ul << (bit % kWordBits);
+    }
+    return mask;
+}
+
+std::vector<int> AllowedCpus() {
+    std::vector<unsigned long> mask(kMaskWords, 0);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, mask.size() * sizeof(unsigned long), reinterpret_cast<cpu_set_t*>(mask.data())) != 0)
+        return cpus;
+    for (size_t bit = 0; bit < kMaskBits; ++bit) {
+        if (mask[bit / kWordBits] & (1ul << (bit % kWordBits))) cpus.push_back(static_cast<int>(bit));
+    }
+    return cpus;
+}
+#endif
+
+} // namespace
+
+bool Placement::NumaAvailable() {
+#if defined(MEDIAENCODER_HAVE_NUMA)
+    static const bool available = [] {
+        int mode = 0;
+        return OnlineNodes().size() > 1 && syscall(SYS_get_mempolicy, &mode, nullptr, 0, nullptr, 0) == 0;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> Placement::CpusOfNode(int node) {
+#if defined(__linux__)
+    if (node >= 0) return ParseList(ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+#else
+    (void)node;
+#endif
+    return {};
+}
+
+int Placement::NodeOfCpu(int cpu) {
+    for (int node : OnlineNodes()) {
+        std::vector<int> cpus = CpusOfNode(node);
+        if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) return node;
+    }
+    return -1;
+}
+
+PlacementInfo Placement::Resolve(const PlacementOptions& options) {
+    PlacementInfo info;
+    info.numaAvailable = NumaAvailable();
+    if (options.Empty()) return info;
+
+#if defined(__linux__)
+    std::vector<int> requested = options.cpus;
+    if (options.numaNode >= 0 && info.numaAvailable) {
+        std::vector<int> nodeCpus = CpusOfNode(options.numaNode);
+        if (nodeCpus.empty()) throw std::invalid_argument("Unknown NUMA node");
+        if (requested.empty()) requested = nodeCpus;
+    }
+    if (requested.empty()) return info;
+
+    std::sort(requested.begin(), requested.end());
+    requested.erase(std::unique(requested.begin(), requested.end()), requested.end());
+    std::vector<int> allowed = AllowedCpus();
+    std::set_intersection(requested.begin(), requested.end(), allowed.begin(), allowed.end(),
+                          std::back_inserter(info.cpus));
+    if (info.cpus.empty()) throw std::invalid_argument("None of the requested CPUs are available to this process");
+
+    if (info.numaAvailable) {
+        int node = options.numaNode;
+        if (node < 0) {
+            node = NodeOfCpu(info.cpus.front());
+            for (int cpu : info.cpus) {
+                if (NodeOfCpu(cpu) != node) {
+                    node = -1;
+                    break;
+                }
+            }
+        }
+        info.numaNode = node;
+    }
+#endif
+    return info;
+}
+
+bool Placement::ApplyToCurrentThread(const PlacementInfo& placement) {
+    bool applied = false;
+#if defined(__linux__)
+    if (!placement.cpus.empty()) {
+        std::vector<unsigned long> mask = ToMask(placement.cpus);
+        if (sched_setaffinity(0, mask.size() * sizeof(unsigned long), reinterpret_cast<cpu_set_t*>(mask.data())) == 0)
+            applied = true;
+    }
+#endif
+#if defined(MEDIAENCODER_HAVE_NUMA)
+    if (placement.numaNode >= 0) {
+        std::vector<unsigned long> nodes = ToMask({placement.numaNode});
+        if (syscall(SYS_set_mempolicy, kMpolPreferred, nodes.data(), kMaskBits + 1) == 0) applied = true;
+    }
+#endif
+    return applied;
+}
+
+size_t Placement::BindFrame(const AVFrame* frame, int node) {
+    size_t bound = 0;
+#if defined(MEDIAENCODER_HAVE_NUMA)
+    if (!frame || node < 0) return 0;
+    const std::vector<unsigned long> nodes = ToMask({node});
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+    // Only pages entirely inside the buffer, so neighbouring allocations stay put.
+    auto bind = [&](const AVBufferRef* buf) {
+        if (!buf) return;
+        uintptr_t begin = (reinterpret_cast<uintptr_t>(buf->data) + page - 1) & ~(page - 1);
+        uintptr_t end = (reinterpret_cast<uintptr_t>(buf->data) + buf->size) & ~(page - 1);
+        if (end <= begin) return;
+        if (syscall(SYS_mbind, begin, end - begin, kMpolPreferred, nodes.data(), kMaskBits + 1, kMpolMfMove) == 0)
+            bound += end - begin;
+    };
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i) bind(frame->buf[i]);
+    for (int i = 0; i < frame->nb_extended_buf; ++i) bind(frame->extended_buf[i]);
+#else
+    (void)frame;
+    (void)node;
+#endif
+    return bound;
+}
+
+ScopedPlacement::ScopedPlacement(const PlacementInfo& placement) {
+#if defined(__linux__)
+    if (!placement.cpus.empty()) {
+        m_cpuMask.assign(kMaskWords, 0);
+        m_affinitySaved = sched_getaffinity(0, m_cpuMask.size() * sizeof(unsigned long),
+                                            reinterpret_cast<cpu_set_t*>(m_cpuMask.data())) == 0;
+    }
+#endif
+#if defined(MEDIAENCODER_HAVE_NUMA)
+    if (placement.numaNode >= 0) {
+        m_nodeMask.assign(kMaskWords, 0);
+        m_policySaved = syscall(SYS_get_mempolicy, &m_policyMode, m_nodeMask.data(), kMaskBits + 1, nullptr, 0) == 0;
+    }
+#endif
+    Placement::ApplyToCurrentThread(placement);
+}
+
+ScopedPlacement::~ScopedPlacement() {
+#if defined(__linux__)
+    if (m_affinitySaved)
+        sched_setaffinity(0, m_cpuMask.size() * sizeof(unsigned long), reinterpret_cast<cpu_set_t*>(m_cpuMask.data()));
+#endif
+#if defined(MEDIAENCODER_HAVE_NUMA)
+    if (m_policySaved) syscall(SYS_set_mempolicy, m_policyMode, m_nodeMask.data(), kMaskBits + 1);
+#endif
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,55 @@
+#include "PlaneKernels.h"
+
+#include <utility>
+
+namespace MediaEncoder {
+
+namespace {
+
+template <PixelFormat... Formats>
+struct PixelFormatList {
+    // Calls fn with std::integral_constant<PixelFormat, format>; false when
+    // the format is not in the list.
+    template <typename Fn>
+    static bool Dispatch(PixelFormat format, Fn&& fn) {
+        return ((format == Formats ? (fn(std::integral_constant<PixelFormat, Formats>()), true) : false) || ...);
+    }
+};
+
+// Every PixelFormat with traits, i.e. all but the hardware surfaces.
+using SoftwarePixelFormats = PixelFormatList<
+    PixelFormat::YUV420P, PixelFormat::YUVJ420P, PixelFormat::YUV422P, PixelFormat::YUVJ422P,
+    PixelFormat::YUV444P, PixelFormat::YUVJ444P, PixelFormat::YUV440P, PixelFormat::YUVJ440P,
+    PixelFormat::YUV410P, PixelFormat::YUV411P,
+    PixelFormat::YUVA420P, PixelFormat::YUVA422P, PixelFormat::YUVA444P,
+    PixelFormat::YUVA420P9LE, PixelFormat::YUVA422P9LE, PixelFormat::YUVA444P9LE,
+    PixelFormat::YUVA420P10LE, PixelFormat::YUVA422P10LE, PixelFormat::YUVA444P10LE,
+    PixelFormat::YUV420P16LE, PixelFormat::YUV420P16BE, PixelFormat::YUV422P16LE, PixelFormat::YUV422P16BE,
+    PixelFormat::YUV444P16LE, PixelFormat::YUV444P16BE,
+    PixelFormat::NV12, PixelFormat::NV21, PixelFormat::YUYV422, PixelFormat::UYVY422, PixelFormat::UYYVYY411,
+    PixelFormat::GBRP, PixelFormat::GBRP16LE, PixelFormat::GBRP16BE,
+    PixelFormat::GRAY8, PixelFormat::GRAY16LE, PixelFormat::GRAY16BE,
+    PixelFormat::RGB24, PixelFormat::BGR24, PixelFormat::ARGB, PixelFormat::ABGR, PixelFormat::RGBA, PixelFormat::BGRA,
+    PixelFormat::RGB48LE, PixelFormat::RGB48BE,
+    PixelFormat::RGBA64LE, PixelFormat::RGBA64BE, PixelFormat::BGRA64LE, PixelFormat::BGRA64BE,
+    PixelFormat::RGB565LE, PixelFormat::RGB565BE, PixelFormat::BGR565LE, PixelFormat::BGR565BE,
+    PixelFormat::RGB555LE, PixelFormat::RGB555BE, PixelFormat::BGR555LE, PixelFormat::BGR555BE,
+    PixelFormat::RGB8, PixelFormat::BGR8, PixelFormat::RGB4_BYTE, PixelFormat::BGR4_BYTE,
+    PixelFormat::RGB4, PixelFormat::BGR4, PixelFormat::MONOWHITE, PixelFormat::MONOBLACK, PixelFormat::PAL8>;
+
+} // namespace
+
+bool CopyImage(AVPixelFormat format, uint8_t* const dst[4], const int dstLinesize[4],
+               const uint8_t* const src[4], const int srcLinesize[4], int width, int height) {
+    return SoftwarePixelFormats::Dispatch(static_cast<PixelFormat>(format), [&](auto tag) {
+        CopyPlanes<decltype(tag)::value>(dst, dstLinesize, src, srcLinesize, width, height);
+    });
+}
+
+bool ClearImage(AVPixelFormat format, uint8_t* const dst[4], const int dstLinesize[4], int width, int height) {
+    return SoftwarePixelFormats::Dispatch(static_cast<PixelFormat>(format), [&](auto tag) {
+        ClearPlanes<decltype(tag)::value>(dst, dstLinesize, width, height);
+    });
+}
+
+} // namespace MediaEncoder
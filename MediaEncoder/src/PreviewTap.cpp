@@ -0,0 +1,191 @@
+#include "PreviewTap.h"
+#include "MediaEncoder.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#if defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace MediaEncoder {
+
+namespace {
+
+// Previews are best effort: let the encoders win every contended core.
+void LowerThreadPriority() {
+#if defined(__APPLE__)
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+} // namespace
+
+PreviewTap::PreviewTap(PreviewOptions options, PreviewCallback callback)
+    : m_options(std::move(options)), m_callback(std::move(callback))
+{
+    if (m_options.intervalMs < 0) throw std::invalid_argument("Preview interval must not be negative");
+    if (m_options.width <= 0 || m_options.height < 0) throw std::invalid_argument("Invalid preview size");
+    if (m_options.codec != "mjpeg" && m_options.codec != "png")
+        throw std::invalid_argument("Preview codec must be mjpeg or png");
+    if (!m_callback && m_options.path.empty())
+        throw std::invalid_argument("Preview needs a callback or an output path");
+
+    m_thread = std::thread(&PreviewTap::Run, this);
+}
+
+PreviewTap::~PreviewTap() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+
+    av_frame_free(&m_pending);
+    av_frame_free(&m_scaled);
+    av_packet_free(&m_packet);
+    avcodec_free_context(&m_encoder);
+}
+
+void PreviewTap::Offer(const AVFrame* frame, int64_t ptsMicroseconds) {
+    if (m_nextDueUs != INT64_MIN && ptsMicroseconds < m_nextDueUs) return;
+
+    // Never wait on the worker: if it holds the lock or is still encoding
+    // the previous preview, this one is skipped.
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || m_busy) {
+        m_skipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (!m_pending) m_pending = av_frame_alloc();
+    // A reference for refcounted frames; unowned ones are copied once.
+    if (!m_pending || av_frame_ref(m_pending, frame) < 0) {
+        m_skipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_pendingPts = ptsMicroseconds;
+    m_busy = true;
+    m_nextDueUs = ptsMicroseconds + static_cast<int64_t>(m_options.intervalMs) * 1000;
+    lock.unlock();
+    m_cv.notify_one();
+}
+
+void PreviewTap::Run() {
+    LowerThreadPriority();
+
+    AVFrame* source = av_frame_alloc();
+    while (source) {
+        int64_t pts;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || m_busy; });
+            if (m_stop) break;
+            av_frame_move_ref(source, m_pending);
+            pts = m_pendingPts;
+        }
+
+        try {
+            Encode(source, pts);
+            m_encoded.fetch_add(1, std::memory_order_relaxed);
+        } catch (...) {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        av_frame_unref(source);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy = false;
+    }
+    av_frame_free(&source);
+}
+
+void PreviewTap::OpenEncoder(const AVFrame* source) {
+    const EncoderInfo* info = CapabilityIndex::Get().ResolveEncoder(m_options.codec);
+    if (!info) throw std::runtime_error("Preview encoder not available: " + m_options.codec);
+
+    int height = m_options.height;
+    if (height == 0) height = static_cast<int>(static_cast<int64_t>(m_options.width) * source->height / source->width);
+    height = (height + 1) & ~1;
+
+    m_encoder = avcodec_alloc_context3(info->codec);
+    if (!m_encoder) throw std::bad_alloc();
+    m_encoder->width = m_options.width;
+    m_encoder->height = height;
+    m_encoder->time_base = {1, 1000000};
+    m_encoder->thread_count = 1;
+    if (info->id == AV_CODEC_ID_PNG) {
+        m_encoder->pix_fmt = AV_PIX_FMT_RGB24;
+    } else {
+        m_encoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        m_encoder->color_range = AVCOL_RANGE_JPEG;
+        m_encoder->flags |= AV_CODEC_FLAG_QSCALE;
+        m_encoder->global_quality = FF_QP2LAMBDA * m_options.quality;
+    }
+    if (avcodec_open2(m_encoder, info->codec, nullptr) < 0) {
+        avcodec_free_context(&m_encoder);
+        throw std::runtime_error("Failed to open preview encoder");
+    }
+
+    m_scaled = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    if (!m_scaled || !m_packet) throw std::bad_alloc();
+    m_scaled->format = m_encoder->pix_fmt;
+    m_scaled->width = m_encoder->width;
+    m_scaled->height = m_encoder->height;
+    if (av_frame_get_buffer(m_scaled, 32) < 0) throw std::runtime_error("Failed to allocate preview frame");
+}
+
+void PreviewTap::Encode(AVFrame* source, int64_t ptsMicroseconds) {
+    if (!m_encoder) OpenEncoder(source);
+
+    // The encoder releases its reference once the packet is out, so the
+    // scaled frame is normally writable again without a copy.
+    if (av_frame_make_writable(m_scaled) < 0) throw std::runtime_error("Preview frame is not writable");
+    if (!m_scaler.Convert(source->width, source->height, static_cast<AVPixelFormat>(source->format),
+                          m_scaled->width, m_scaled->height, static_cast<AVPixelFormat>(m_scaled->format),
+                          source->data, source->linesize, m_scaled->data, m_scaled->linesize)) {
+        throw std::runtime_error("Preview scaling failed");
+    }
+    m_scaled->pts = ptsMicroseconds;
+
+    if (avcodec_send_frame(m_encoder, m_scaled) < 0) throw std::runtime_error("Preview encode failed");
+    while (avcodec_receive_packet(m_encoder, m_packet) == 0) {
+        Deliver(m_packet, ptsMicroseconds);
+        av_packet_unref(m_packet);
+    }
+}
+
+void PreviewTap::Deliver(const AVPacket* packet, int64_t ptsMicroseconds) {
+    if (m_callback) m_callback(packet->data, static_cast<size_t>(packet->size), ptsMicroseconds);
+    if (m_options.path.empty()) return;
+
+    // The path is never a format string: only a single %d (with optional
+    // width) is expanded, and any other path is used as given.
+    std::string target = m_options.path;
+    char name[4096];
+    const bool numbered = av_get_frame_filename2(name, sizeof(name), m_options.path.c_str(), m_fileIndex, 0) == 0;
+    if (numbered) {
+        ++m_fileIndex;
+        target = name;
+    }
+
+    // Readers of a fixed path never see a partially written image.
+    const std::string temporary = numbered ? target : target + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) throw std::runtime_error("Cannot write preview " + temporary);
+    const bool written = std::fwrite(packet->data, 1, static_cast<size_t>(packet->size), file) ==
+                         static_cast<size_t>(packet->size);
+    if (std::fclose(file) != 0 || !written) throw std::runtime_error("Failed to write preview " + temporary);
+    if (!numbered && std::rename(temporary.c_str(), target.c_str()) != 0)
+        throw std::runtime_error("Failed to replace preview " + target);
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,105 @@
+#include "QualityController.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace MediaEncoder {
+
+namespace {
+
+// Encoders want even dimensions for 4:2:0.
+int ScaledDimension(int size, double scale) {
+    return std::max(2, static_cast<int>(size * scale) & ~1);
+}
+
+} // namespace
+
+void QualityController::Validate(const AdaptiveQualityOptions& options) {
+    if (!(options.upgradeLoad > 0) || !(options.degradeLoad > options.upgradeLoad))
+        throw std::invalid_argument("Adaptive quality needs 0 < upgradeLoad < degradeLoad");
+    if (options.holdMs < 0) throw std::invalid_argument("Adaptive quality hold time must not be negative");
+    double previous = 1.0;
+    for (double scale : options.scales) {
+        if (!(scale > 0) || !(scale < previous))
+            throw std::invalid_argument("Adaptive quality scales must be below 1 and decreasing");
+        previous = scale;
+    }
+}
+
+QualityController::QualityController(const AdaptiveQualityOptions& options, int width, int height,
+                                     int64_t intervalUs, bool presets)
+    : m_intervalUs(intervalUs), m_degradeLoad(options.degradeLoad), m_upgradeLoad(options.upgradeLoad),
+      m_holdUs(static_cast<int64_t>(options.holdMs) * 1000)
+{
+    Validate(options);
+    if (width <= 0 || height <= 0 || intervalUs <= 0)
+        throw std::invalid_argument("Adaptive quality needs a frame size and frame rate");
+
+    if (presets) {
+        for (const auto& preset : options.presets)
+            m_levels.push_back({static_cast<int>(m_levels.size()), preset, width, height});
+    }
+    if (m_levels.empty()) m_levels.push_back({0, "", width, height});
+
+    const std::string fastest = m_levels.back().preset;
+    for (double scale : options.scales) {
+        int w = ScaledDimension(width, scale);
+        int h = ScaledDimension(height, scale);
+        if (w == m_levels.back().width && h == m_levels.back().height) continue;
+        m_levels.push_back({static_cast<int>(m_levels.size()), fastest, w, h});
+    }
+}
+
+double QualityController::Load() const {
+    return static_cast<double>(m_encodeEmaUs) / m_intervalUs;
+}
+
+bool QualityController::Update(int64_t encodeUs, int64_t nowUs) {
+    m_encodeEmaUs = m_encodeEmaUs ? m_encodeEmaUs + (encodeUs - m_encodeEmaUs) / 8 : encodeUs;
+    if (!m_enabled || m_levels.size() < 2) return false;
+    if (m_changedAtUs < 0) m_changedAtUs = nowUs;
+
+    const double load = Load();
+    if (load > m_degradeLoad) {
+        if (m_overSinceUs < 0) m_overSinceUs = nowUs;
+        m_underSinceUs = -1;
+    } else if (load < m_upgradeLoad) {
+        if (m_underSinceUs < 0) m_underSinceUs = nowUs;
+        m_overSinceUs = -1;
+    } else {
+        m_overSinceUs = -1;
+        m_underSinceUs = -1;
+    }
+
+    const int64_t sinceChange = nowUs - m_changedAtUs;
+    if (m_overSinceUs >= 0 && m_level + 1 < m_levels.size() &&
+        nowUs - m_overSinceUs >= m_holdUs && sinceChange >= m_holdUs) {
+        if (m_lastWasUpgrade)
+            m_upgradeBackoff = sinceChange < 2 * m_holdUs * m_upgradeBackoff ? std::min(m_upgradeBackoff * 2, 8) : 1;
+        Step(1, nowUs);
+        return true;
+    }
+
+    const int64_t upgradeHoldUs = m_holdUs * m_upgradeBackoff;
+    if (m_underSinceUs >= 0 && m_level > 0 && nowUs - m_underSinceUs >= upgradeHoldUs && sinceChange >= upgradeHoldUs) {
+        Step(-1, nowUs);
+        return true;
+    }
+    return false;
+}
+
+void QualityController::Step(int delta, int64_t nowUs) {
+    m_previous = m_level;
+    m_level = static_cast<size_t>(static_cast<int>(m_level) + delta);
+    m_changedAtUs = nowUs;
+    m_lastWasUpgrade = delta < 0;
+    m_overSinceUs = -1;
+    m_underSinceUs = -1;
+}
+
+void QualityController::Revert() {
+    m_level = m_previous;
+    m_enabled = false;
+}
+
+} // namespace MediaEncoder
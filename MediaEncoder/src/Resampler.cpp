@@ -1,6 +1,12 @@
 #include "Resampler.h"
 #include "SampleFormat.h"
+#include "Trace.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
 #include <stdexcept>
 #include <cstdint>
 #include <libswresample/swresample.h>
@@ -9,6 +15,54 @@
 
 namespace MediaEncoder {
 
+namespace {
+
+SwrContext* CreateContext(int srcChannels, AVSampleFormat srcSampleFormat, int srcSampleRate,
+                          int destChannels, AVSampleFormat destSampleFormat, int destSampleRate)
+{
+    AVChannelLayout srcLayout, dstLayout;
+    av_channel_layout_default(&srcLayout, srcChannels);
+    av_channel_layout_default(&dstLayout, destChannels);
+
+    SwrContext* context = nullptr;
+    int ret = swr_alloc_set_opts2(&context,
+                                  &dstLayout, destSampleFormat, destSampleRate,
+                                  &srcLayout, srcSampleFormat, srcSampleRate,
+                                  0, nullptr);
+    if (ret >= 0) ret = swr_init(context);
+
+    av_channel_layout_uninit(&srcLayout);
+    av_channel_layout_uninit(&dstLayout);
+    if (ret < 0) {
+        swr_free(&context);
+        throw std::runtime_error("Failed to initialize SwrContext");
+    }
+    return context;
+}
+
+// One Resample() call in split mode. Groups are claimed by whoever gets to
+// them first, the caller or a worker; workers that arrive late only touch
+// this state, which they keep alive.
+struct GroupBatch {
+    explicit GroupBatch(size_t groups) : claimed(groups), results(groups, 0), remaining(static_cast<int>(groups)) {}
+
+    std::vector<std::atomic<bool>> claimed;
+    std::vector<int> results;
+    std::mutex mutex;
+    std::condition_variable done;
+    int remaining;
+
+    void Run(size_t group, SwrContext* context, uint8_t** output, int maxDstSamples,
+             const uint8_t** input, int srcSamples) {
+        if (claimed[group].exchange(true, std::memory_order_acq_rel)) return;
+        results[group] = swr_convert(context, output, maxDstSamples, input, srcSamples);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) done.notify_all();
+    }
+};
+
+} // namespace
+
 Resampler::Resampler()
     : m_swrContext(nullptr),
       m_srcChannels(-1), m_destChannels(-1),
@@ -19,13 +73,26 @@ Resampler::Resampler()
 {}
 
 Resampler::~Resampler()
+{
+    FreeContexts();
+    av_buffer_unref(&m_resampledBuffer);
+}
+
+void Resampler::FreeContexts()
 {
     if (m_swrContext) {
         swr_free(&m_swrContext);
     }
-    if (m_resampledBuffer) {
-        av_free(m_resampledBuffer);
-    }
+    for (auto& group : m_groups) swr_free(&group.context);
+    m_groups.clear();
+}
+
+void Resampler::SetParallelChannels(int channelsPerGroup, Executor* executor)
+{
+    if (channelsPerGroup < 0) throw std::invalid_argument("channelsPerGroup must not be negative");
+    m_channelsPerGroup = channelsPerGroup;
+    m_groupExecutor = executor;
+    m_srcChannels = -1;     // rebuild the contexts at the next Initialize()
 }
 
 void Resampler::SwrContextValidation(int srcChannels, AVSampleFormat srcSampleFormat, int srcSampleRate,
@@ -41,25 +108,29 @@ void Resampler::SwrContextValidation(int srcChannels, AVSampleFormat srcSampleFo
         m_destSampleFormat = destSampleFormat;
         m_destSampleRate = destSampleRate;
 
-        if (m_swrContext) {
-            swr_free(&m_swrContext);
-            m_swrContext = nullptr;
-        }
+        FreeContexts();
+        m_outputPlanes.assign(av_sample_fmt_is_planar(destSampleFormat) ? destChannels : 1, nullptr);
 
-        AVChannelLayout srcLayout, dstLayout;
-        av_channel_layout_default(&srcLayout, srcChannels);
-        av_channel_layout_default(&dstLayout, destChannels);
-
-        if (swr_alloc_set_opts2(&m_swrContext,
-                                &dstLayout, destSampleFormat, destSampleRate,
-                                &srcLayout, srcSampleFormat, srcSampleRate,
-                                0, nullptr) < 0 || swr_init(m_swrContext) < 0)
-        {
-            throw std::runtime_error("Failed to initialize SwrContext");
+        const bool split = m_channelsPerGroup > 0 && srcChannels > m_channelsPerGroup &&
+                           srcChannels == destChannels &&
+                           av_sample_fmt_is_planar(srcSampleFormat) && av_sample_fmt_is_planar(destSampleFormat);
+        if (!split) {
+            m_swrContext = CreateContext(srcChannels, srcSampleFormat, srcSampleRate,
+                                         destChannels, destSampleFormat, destSampleRate);
+            return;
         }
 
-        av_channel_layout_uninit(&srcLayout);
-        av_channel_layout_uninit(&dstLayout);
+        // Same layout in and out: no rematrixing, so each group resamples
+        // its channels exactly as a context for all of them would.
+        Executor& executor = m_groupExecutor ? *m_groupExecutor : Executor::Shared();
+        for (int first = 0; first < srcChannels; first += m_channelsPerGroup) {
+            const int channels = std::min(m_channelsPerGroup, srcChannels - first);
+            ChannelGroup group{nullptr, first, nullptr};
+            if (first > 0) group.strand = executor.CreateClient("Resampler channels " + std::to_string(first));
+            m_groups.push_back(group);
+            m_groups.back().context = CreateContext(channels, srcSampleFormat, srcSampleRate,
+                                                    channels, destSampleFormat, destSampleRate);
+        }
     }
 }
 
@@ -72,11 +143,12 @@ void Resampler::Initialize(int srcChannels, AVSampleFormat srcSampleFormat, int
 
 uint8_t* Resampler::Resample(const uint8_t** srcData, int srcSamples, int& destSamples)
 {
-    if (!m_swrContext) {
+    SwrContext* primary = m_groups.empty() ? m_swrContext : m_groups.front().context;
+    if (!primary) {
         throw std::runtime_error("SwrContext is not initialized");
     }
 
-    int maxDstSamples = swr_get_out_samples(m_swrContext, srcSamples);
+    int maxDstSamples = swr_get_out_samples(primary, srcSamples);
     int bufferSize = av_samples_get_buffer_size(nullptr, m_destChannels, maxDstSamples, m_destSampleFormat, 1);
 
     if (bufferSize < 0) {
@@ -84,34 +156,103 @@ uint8_t* Resampler::Resample(const uint8_t** srcData, int srcSamples, int& destS
     }
 
     if (m_resampledBufferSize < bufferSize) {
-        if (m_resampledBuffer) {
-            av_free(m_resampledBuffer);
-        }
-        m_resampledBuffer = static_cast<uint8_t*>(av_malloc(bufferSize));
-        if (!m_resampledBuffer) {
-            throw std::runtime_error("Failed to allocate resample buffer");
-        }
+        av_buffer_unref(&m_resampledBuffer);
+        m_resampledBufferSize = -1;
+        if (!m_allocator) m_allocator = FrameAllocator::Default();
+        m_resampledBuffer = m_allocator->Allocate(static_cast<size_t>(bufferSize));
         m_resampledBufferSize = bufferSize;
     }
 
-    destSamples = swr_convert(
-        m_swrContext, &m_resampledBuffer, maxDstSamples,
-        srcData, srcSamples
-    );
+    ME_TRACE_SCOPE("swr_convert", "resample", Trace::kNoPts);
+    uint8_t* output = m_resampledBuffer->data;
+    // One plane per channel for planar output, maxDstSamples apart.
+    if (av_samples_fill_arrays(m_outputPlanes.data(), nullptr, output, m_destChannels, maxDstSamples,
+                               m_destSampleFormat, 1) < 0) {
+        throw std::runtime_error("Failed to set up output planes");
+    }
+
+    if (m_groups.empty()) {
+        destSamples = swr_convert(
+            m_swrContext, m_outputPlanes.data(), maxDstSamples,
+            srcData, srcSamples
+        );
+    } else {
+        destSamples = ConvertGroups(srcData, srcSamples, maxDstSamples);
+    }
 
     if (destSamples < 0) {
         throw std::runtime_error("swr_convert() failed");
     }
 
-    return m_resampledBuffer;
+    // Close the gaps a short conversion leaves between planes.
+    if (m_outputPlanes.size() > 1 && destSamples < maxDstSamples) {
+        const size_t planeSize = static_cast<size_t>(destSamples) * av_get_bytes_per_sample(m_destSampleFormat);
+        for (size_t plane = 1; plane < m_outputPlanes.size(); ++plane)
+            std::memmove(output + plane * planeSize, m_outputPlanes[plane], planeSize);
+    }
+
+    return output;
+}
+
+int Resampler::ConvertGroups(const uint8_t** srcData, int srcSamples, int maxDstSamples)
+{
+    auto batch = std::make_shared<GroupBatch>(m_groups.size());
+    auto run = [&](size_t index) {
+        const ChannelGroup& group = m_groups[index];
+        batch->Run(index, group.context, m_outputPlanes.data() + group.firstChannel, maxDstSamples,
+                   srcData + group.firstChannel, srcSamples);
+    };
+
+    for (size_t index = 1; index < m_groups.size(); ++index) {
+        const ChannelGroup& group = m_groups[index];
+        SwrContext* context = group.context;
+        uint8_t** output = m_outputPlanes.data() + group.firstChannel;
+        const uint8_t** input = srcData + group.firstChannel;
+        group.strand->Post([batch, index, context, output, maxDstSamples, input, srcSamples] {
+            batch->Run(index, context, output, maxDstSamples, input, srcSamples);
+        });
+    }
+    // Help rather than wait, so a Resampler running on the executor itself
+    // cannot deadlock it.
+    for (size_t index = 0; index < m_groups.size(); ++index) run(index);
+    {
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->done.wait(lock, [&] { return batch->remaining == 0; });
+    }
+
+    // Every group sees the same rate and delay, so they agree on the count.
+    for (int result : batch->results) {
+        if (result < 0) return result;
+        if (result != batch->results.front()) throw std::runtime_error("Channel groups produced different sample counts");
+    }
+    return batch->results.front();
 }
 
 int Resampler::EstimateOutputSamples(int srcSamples) const
 {
-    if (!m_swrContext) {
+    SwrContext* primary = m_groups.empty() ? m_swrContext : m_groups.front().context;
+    if (!primary) {
         throw std::runtime_error("SwrContext is not initialized");
     }
-    return swr_get_out_samples(m_swrContext, srcSamples);
+    return swr_get_out_samples(primary, srcSamples);
+}
+
+void Resampler::AttachExecutor(Executor& executor, const std::string& name)
+{
+    m_strand = executor.CreateClient(name);
+}
+
+std::future<Resampler::ResampleResult> Resampler::ResampleAsync(const uint8_t** srcData, int srcSamples)
+{
+    auto task = std::make_shared<std::packaged_task<ResampleResult()>>([this, srcData, srcSamples] {
+        ResampleResult result;
+        result.data = Resample(srcData, srcSamples, result.samples);
+        return result;
+    });
+    std::future<ResampleResult> result = task->get_future();
+    if (m_strand) m_strand->Post([task] { (*task)(); });
+    else (*task)();
+    return result;
 }
 
 } // namespace MediaEncoder
\ No newline at end of file
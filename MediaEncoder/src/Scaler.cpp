@@ -1,12 +1,79 @@
 #include "Scaler.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace MediaEncoder {
 
+namespace {
+
+// Fill patterns are converted from this many pixels, a multiple of every
+// format's horizontal alignment; the rows cover the tallest chroma block.
+constexpr int kPatternWidth = 16;
+constexpr int kPatternHeight = 4;
+
+// Horizontal step at which every plane starts on a whole chroma block and
+// a whole byte, e.g. 2 for NV12 and YUYV422, 8 for MONOWHITE.
+int AlignmentX(const PixelFormatTraits& traits) {
+    int align = traits.yuv ? 1 << traits.log2ChromaW : 1;
+    for (int plane = 0; plane < traits.planes; ++plane) {
+        const int shift = traits.subsampled[plane] ? traits.log2ChromaW : 0;
+        while (((align >> shift) * traits.bitsPerPixel[plane]) % 8) align *= 2;
+    }
+    return align;
+}
+
+int AlignmentY(const PixelFormatTraits& traits) {
+    return traits.yuv ? 1 << traits.log2ChromaH : 1;
+}
+
+void CheckRect(const PixelFormatTraits& traits, int width, int height, const ScaleRect& rect, bool alignEnd) {
+    if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 ||
+        rect.width > width - rect.x || rect.height > height - rect.y)
+        throw std::invalid_argument("Scale rectangle is outside the image");
+
+    const int alignX = AlignmentX(traits);
+    const int alignY = AlignmentY(traits);
+    const int right = rect.x + rect.width;
+    const int bottom = rect.y + rect.height;
+    if (rect.x % alignX || rect.y % alignY ||
+        (alignEnd && ((right % alignX && right != width) || (bottom % alignY && bottom != height))))
+        throw std::invalid_argument("Scale rectangle is not aligned to the pixel format");
+}
+
+// Plane pointers moved to the rectangle's origin; a palette is passed as is.
+void OffsetPlanes(const PixelFormatTraits& traits, uint8_t* const data[4], const int stride[4],
+                  int x, int y, uint8_t* out[4]) {
+    for (int plane = 0; plane < 4; ++plane) {
+        out[plane] = data[plane];
+        if (plane >= traits.planes || !data[plane]) continue;
+        const int px = traits.subsampled[plane] ? x >> traits.log2ChromaW : x;
+        const int py = traits.subsampled[plane] ? y >> traits.log2ChromaH : y;
+        out[plane] += static_cast<ptrdiff_t>(py) * stride[plane] +
+                      (static_cast<ptrdiff_t>(px) * traits.bitsPerPixel[plane] >> 3);
+    }
+}
+
+// Repeats pattern over bytes, doubling the copied run each step.
+void FillRow(uint8_t* row, size_t bytes, const std::vector<uint8_t>& pattern) {
+    size_t filled = std::min(bytes, pattern.size());
+    std::memcpy(row, pattern.data(), filled);
+    while (filled < bytes) {
+        const size_t chunk = std::min(filled, bytes - filled);
+        std::memcpy(row + filled, row, chunk);
+        filled += chunk;
+    }
+}
+
+} // namespace
+
 Scaler::Scaler()
     : sws_ctx(nullptr),
       currentSrcW(0), currentSrcH(0),
       currentDstW(0), currentDstH(0),
-      currentSrcFmt(AV_PIX_FMT_NONE), currentDstFmt(AV_PIX_FMT_NONE) {}
+      currentSrcFmt(AV_PIX_FMT_NONE), currentDstFmt(AV_PIX_FMT_NONE),
+      fillFormat(AV_PIX_FMT_NONE) {}
 
 Scaler::~Scaler() {
     ResetContext();
@@ -52,6 +119,7 @@ bool Scaler::Convert(int srcW, int srcH, AVPixelFormat srcFormat,
         throw std::runtime_error("Failed to ensure scaling context.");
     }
 
+    ME_TRACE_SCOPE("sws_scale", "scale", Trace::kNoPts);
     sws_scale(sws_ctx, &src, &srcStride, 0, srcH, &dst, &dstStride);
     return true;
 }
@@ -64,8 +132,183 @@ bool Scaler::Convert(int srcW, int srcH, AVPixelFormat srcFormat,
         throw std::runtime_error("Failed to ensure scaling context.");
     }
 
+    ME_TRACE_SCOPE("sws_scale", "scale", Trace::kNoPts);
     sws_scale(sws_ctx, srcData, srcStride, 0, srcH, dstData, dstStride);
     return true;
 }
 
+bool Scaler::ConvertRect(int srcW, int srcH, AVPixelFormat srcFormat,
+                         uint8_t* const srcData[4], const int srcStride[4], const ScaleRect& srcRect,
+                         int dstW, int dstH, AVPixelFormat dstFormat,
+                         uint8_t* const dstData[4], const int dstStride[4], const ScaleRect& dstRect,
+                         FillColor fill) {
+    const PixelFormatTraits srcTraits = GetPixelFormatTraits(srcFormat);
+    const PixelFormatTraits dstTraits = GetPixelFormatTraits(dstFormat);
+    if (srcTraits.planes == 0 || dstTraits.planes == 0)
+        throw std::invalid_argument("ConvertRect needs software pixel formats");
+    CheckRect(srcTraits, srcW, srcH, srcRect, false);
+    CheckRect(dstTraits, dstW, dstH, dstRect, true);
+
+    if (!EnsureContext(srcRect.width, srcRect.height, srcFormat, dstRect.width, dstRect.height, dstFormat)) {
+        throw std::runtime_error("Failed to ensure scaling context.");
+    }
+
+    if (dstRect.width != dstW || dstRect.height != dstH) {
+        ME_TRACE_SCOPE("FillBorder", "scale", Trace::kNoPts);
+        EnsureFillPattern(dstFormat, dstTraits, fill);
+        FillBorder(dstTraits, dstW, dstH, dstData, dstStride, dstRect);
+    }
+
+    uint8_t* src[4];
+    uint8_t* dst[4];
+    OffsetPlanes(srcTraits, srcData, srcStride, srcRect.x, srcRect.y, src);
+    OffsetPlanes(dstTraits, dstData, dstStride, dstRect.x, dstRect.y, dst);
+
+    ME_TRACE_SCOPE("sws_scale", "scale", Trace::kNoPts);
+    sws_scale(sws_ctx, src, srcStride, 0, srcRect.height, dst, dstStride);
+    return true;
+}
+
+void Scaler::CheckSourceRect(int width, int height, AVPixelFormat format, const ScaleRect& rect) {
+    const PixelFormatTraits traits = GetPixelFormatTraits(format);
+    if (traits.planes == 0) throw std::invalid_argument("ConvertRect needs software pixel formats");
+    CheckRect(traits, width, height, rect, false);
+}
+
+ScaleRect Scaler::FitRect(int srcW, int srcH, int dstW, int dstH, AVPixelFormat dstFormat) {
+    const PixelFormatTraits traits = GetPixelFormatTraits(dstFormat);
+    if (traits.planes == 0) throw std::invalid_argument("FitRect needs a software pixel format");
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) throw std::invalid_argument("Invalid image size");
+
+    const int alignX = AlignmentX(traits);
+    const int alignY = AlignmentY(traits);
+    ScaleRect rect;
+    rect.width = dstW;
+    rect.height = dstH;
+    if (static_cast<int64_t>(srcW) * dstH > static_cast<int64_t>(dstW) * srcH) {
+        const int height = static_cast<int>(static_cast<int64_t>(dstW) * srcH / srcW);
+        if (height < dstH) rect.height = std::max(alignY, height / alignY * alignY);
+    } else {
+        const int width = static_cast<int>(static_cast<int64_t>(dstH) * srcW / srcH);
+        if (width < dstW) rect.width = std::max(alignX, width / alignX * alignX);
+    }
+    rect.x = (dstW - rect.width) / 2 / alignX * alignX;
+    rect.y = (dstH - rect.height) / 2 / alignY * alignY;
+    return rect;
+}
+
+// The pattern is the first row of a small image of the fill colour
+// converted by swscale, so range, matrix and packing follow the format.
+void Scaler::EnsureFillPattern(AVPixelFormat format, const PixelFormatTraits& traits, FillColor fill) {
+    if (format == fillFormat && fill == fillColor) return;
+
+    uint8_t rgb[kPatternWidth * 3 * kPatternHeight];
+    for (int i = 0; i < kPatternWidth * kPatternHeight; ++i) {
+        rgb[i * 3] = fill.r;
+        rgb[i * 3 + 1] = fill.g;
+        rgb[i * 3 + 2] = fill.b;
+    }
+
+    uint8_t* image[4] = {};
+    int linesize[4] = {};
+    if (av_image_alloc(image, linesize, kPatternWidth, kPatternHeight, format, 1) < 0)
+        throw std::runtime_error("Failed to allocate fill pattern");
+    SwsContext* ctx = sws_getContext(kPatternWidth, kPatternHeight, AV_PIX_FMT_RGB24,
+                                     kPatternWidth, kPatternHeight, format,
+                                     SWS_POINT, nullptr, nullptr, nullptr);
+    if (!ctx) {
+        av_freep(&image[0]);
+        throw std::runtime_error("Failed to create SwsContext.");
+    }
+
+    const uint8_t* src[4] = {rgb, nullptr, nullptr, nullptr};
+    const int srcStride[4] = {kPatternWidth * 3, 0, 0, 0};
+    sws_scale(ctx, src, srcStride, 0, kPatternHeight, image, linesize);
+    sws_freeContext(ctx);
+
+    for (int plane = 0; plane < 4; ++plane) {
+        if (plane < traits.planes) {
+            const uint8_t* row = image[plane];
+            fillPattern[plane].assign(row, row + traits.PlaneRowBytes(plane, kPatternWidth));
+        } else {
+            fillPattern[plane].clear();
+        }
+    }
+    av_freep(&image[0]);
+    fillFormat = format;
+    fillColor = fill;
+}
+
+// Paints the bands above, below, left and right of dstRect: one row of each
+// band is built from the pattern and copied to the band's other rows.
+void Scaler::FillBorder(const PixelFormatTraits& traits, int dstW, int dstH,
+                        uint8_t* const dstData[4], const int dstStride[4], const ScaleRect& dstRect) {
+    for (int plane = 0; plane < traits.planes; ++plane) {
+        uint8_t* data = dstData[plane];
+        const int stride = dstStride[plane];
+        const std::vector<uint8_t>& pattern = fillPattern[plane];
+        if (!data || pattern.empty()) continue;
+
+        const int shiftX = traits.subsampled[plane] ? traits.log2ChromaW : 0;
+        const int shiftY = traits.subsampled[plane] ? traits.log2ChromaH : 0;
+        const int rows = traits.PlaneHeight(plane, dstH);
+        const size_t rowBytes = traits.PlaneRowBytes(plane, dstW);
+        const int right = dstRect.x + dstRect.width;
+        const int bottom = dstRect.y + dstRect.height;
+
+        const int top = dstRect.y >> shiftY;
+        const int end = bottom == dstH ? rows : bottom >> shiftY;
+        const size_t left = static_cast<size_t>(dstRect.x >> shiftX) * traits.bitsPerPixel[plane] >> 3;
+        const size_t inner = right == dstW ? rowBytes
+            : static_cast<size_t>(right >> shiftX) * traits.bitsPerPixel[plane] >> 3;
+
+        auto row = [&](int y) { return data + static_cast<ptrdiff_t>(y) * stride; };
+        auto fillRows = [&](int first, int last) {
+            if (first >= last) return;
+            FillRow(row(first), rowBytes, pattern);
+            for (int y = first + 1; y < last; ++y) std::memcpy(row(y), row(first), rowBytes);
+        };
+
+        fillRows(0, top);
+        fillRows(end, rows);
+        if (top < end && (left > 0 || inner < rowBytes)) {
+            uint8_t* first = row(top);
+            if (left > 0) FillRow(first, left, pattern);
+            if (inner < rowBytes) FillRow(first + inner, rowBytes - inner, pattern);
+            for (int y = top + 1; y < end; ++y) {
+                if (left > 0) std::memcpy(row(y), first, left);
+                if (inner < rowBytes) std::memcpy(row(y) + inner, first + inner, rowBytes - inner);
+            }
+        }
+    }
+}
+
+void Scaler::AttachExecutor(Executor& executor, const std::string& name) {
+    strand = executor.CreateClient(name);
+}
+
+std::future<bool> Scaler::ConvertAsync(int srcW, int srcH, AVPixelFormat srcFormat,
+                                       int dstW, int dstH, AVPixelFormat dstFormat,
+                                       uint8_t* const srcData[4], const int srcStride[4],
+                                       uint8_t* const dstData[4], const int dstStride[4]) {
+    std::array<uint8_t*, 4> src, dst;
+    std::array<int, 4> srcLines, dstLines;
+    for (int i = 0; i < 4; ++i) {
+        src[i] = srcData[i];
+        dst[i] = dstData[i];
+        srcLines[i] = srcStride[i];
+        dstLines[i] = dstStride[i];
+    }
+
+    auto task = std::make_shared<std::packaged_task<bool()>>(
+        [this, srcW, srcH, srcFormat, dstW, dstH, dstFormat, src, srcLines, dst, dstLines] {
+            return Convert(srcW, srcH, srcFormat, dstW, dstH, dstFormat,
+                           src.data(), srcLines.data(), dst.data(), dstLines.data());
+        });
+    std::future<bool> result = task->get_future();
+    if (strand) strand->Post([task] { (*task)(); });
+    else (*task)();
+    return result;
+}
+
 } // namespace MediaEncoder
\ No newline at end of file
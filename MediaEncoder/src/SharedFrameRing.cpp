@@ -0,0 +1,546 @@
+#include "SharedFrameRing.h"
+#include "PlaneKernels.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/imgutils.h>
+}
+
+namespace MediaEncoder {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x4d455352;    // "MESR"
+constexpr uint32_t kVersion = 1;
+constexpr int kVideoAlign = 32;
+constexpr int kLivenessPollMs = 100;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared ring needs lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared ring needs lock-free 32-bit atomics");
+
+// Lives at the start of the mapping. Written once by the consumer before
+// magic is published; the atomics are shared by both processes.
+struct RingHeader {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t video;
+    int32_t width;
+    int32_t height;
+    int32_t pixelFormat;
+    int32_t sampleRate;
+    int32_t channels;
+    int32_t sampleFormat;
+    int32_t samples;
+    uint64_t slotBytes;
+    uint64_t slotStride;
+    uint64_t dataOffset;
+    uint64_t mappingBytes;
+
+    alignas(64) std::atomic<uint64_t> writePosition;
+    std::atomic<int32_t> producerPid;
+    std::atomic<uint32_t> producerGeneration;
+    std::atomic<int64_t> heartbeatNs;
+    std::atomic<int32_t> consumerPid;
+
+    // Futex words: bumped after every publish / release.
+    alignas(64) std::atomic<uint32_t> publishSeq;
+    alignas(64) std::atomic<uint32_t> releaseSeq;
+};
+
+// sequence == position: free for the producer writing that position;
+// position + 1: published; position + slotCount: released by the consumer.
+struct SlotHeader {
+    alignas(64) std::atomic<uint64_t> sequence;
+    int64_t pts;
+    uint32_t generation;
+};
+
+int64_t NowNanoseconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+bool ProcessAlive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+void WaitOn(std::atomic<uint32_t>& word, uint32_t seen, int timeoutMs) {
+    if (timeoutMs <= 0) return;
+#if defined(__linux__)
+    timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000;
+    // Not FUTEX_PRIVATE: the word is shared between processes.
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &ts, nullptr, 0);
+#else
+    // No portable cross-process wait; poll at sub-frame granularity.
+    const int64_t deadline = NowNanoseconds() + static_cast<int64_t>(timeoutMs) * 1000000;
+    while (word.load(std::memory_order_acquire) == seen && NowNanoseconds() < deadline) {
+        std::this_thread::sleep_for(std::chrono::microseconds(250));
+    }
+#endif
+}
+
+void WakeAll(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+size_t RoundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+SharedFrameFormat FormatFromHeader(const RingHeader& header) {
+    SharedFrameFormat format;
+    format.video = header.video != 0;
+    format.width = header.width;
+    format.height = header.height;
+    format.pixelFormat = static_cast<AVPixelFormat>(header.pixelFormat);
+    format.sampleRate = header.sampleRate;
+    format.channels = header.channels;
+    format.sampleFormat = static_cast<AVSampleFormat>(header.sampleFormat);
+    format.samples = header.samples;
+    return format;
+}
+
+size_t SlotBytes(const SharedFrameFormat& format) {
+    int size = format.video
+        ? av_image_get_buffer_size(format.pixelFormat, format.width, format.height, kVideoAlign)
+        : av_samples_get_buffer_size(nullptr, format.channels, format.samples, format.sampleFormat, 0);
+    if (size <= 0) throw std::invalid_argument("Unsupported shared frame format");
+    return static_cast<size_t>(size);
+}
+
+// Describes a slot's memory on an AVFrame (format fields and plane pointers, no buffer ref).
+void DescribeSlot(AVFrame* frame, const SharedFrameFormat& format, uint8_t* data) {
+    if (format.video) {
+        frame->format = format.pixelFormat;
+        frame->width = format.width;
+        frame->height = format.height;
+        av_image_fill_arrays(frame->data, frame->linesize, data, format.pixelFormat,
+                             format.width, format.height, kVideoAlign);
+    } else {
+        frame->format = format.sampleFormat;
+        frame->sample_rate = format.sampleRate;
+        frame->nb_samples = format.samples;
+        av_channel_layout_uninit(&frame->ch_layout);
+        av_channel_layout_default(&frame->ch_layout, format.channels);
+        av_samples_fill_arrays(frame->data, frame->linesize, data, format.channels,
+                               format.samples, format.sampleFormat, 0);
+    }
+    frame->extended_data = frame->data;
+}
+
+} // namespace
+
+namespace detail {
+
+struct SharedRingMapping {
+    void* base = nullptr;
+    size_t bytes = 0;
+    RingHeader* header = nullptr;
+    SlotHeader* slots = nullptr;
+    std::atomic<size_t> inFlight{0};
+
+    // Local copies of the layout: the other process can write the header.
+    uint64_t slotCount = 0;
+    uint64_t slotBytes = 0;
+    uint64_t slotStride = 0;
+    uint64_t dataOffset = 0;
+
+    SharedRingMapping(int fd, size_t size) : bytes(size) {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) throw std::runtime_error(std::string("mmap failed: ") + std::strerror(errno));
+        header = static_cast<RingHeader*>(base);
+        slots = reinterpret_cast<SlotHeader*>(static_cast<uint8_t*>(base) + RoundUp(sizeof(RingHeader), 64));
+    }
+
+    ~SharedRingMapping() {
+        if (base && base != MAP_FAILED) munmap(base, bytes);
+    }
+
+    void SetLayout(uint64_t count, uint64_t slotSize, uint64_t stride, uint64_t offset) {
+        slotCount = count;
+        slotBytes = slotSize;
+        slotStride = stride;
+        dataOffset = offset;
+    }
+
+    uint8_t* SlotData(uint64_t position) const {
+        return static_cast<uint8_t*>(base) + dataOffset + (position % slotCount) * slotStride;
+    }
+
+    SlotHeader& Slot(uint64_t position) const { return slots[position % slotCount]; }
+
+    void Release(uint64_t position) {
+        Slot(position).sequence.store(position + slotCount, std::memory_order_release);
+        inFlight.fetch_sub(1, std::memory_order_relaxed);
+        header->releaseSeq.fetch_add(1, std::memory_order_release);
+        WakeAll(header->releaseSeq);
+    }
+};
+
+} // namespace detail
+
+namespace {
+
+// Opaque of the AVBufferRef wrapping a slot; keeps the mapping alive after
+// the ring object is gone.
+struct SlotReference {
+    std::shared_ptr<detail::SharedRingMapping> mapping;
+    uint64_t position;
+};
+
+void ReleaseSlot(void* opaque, uint8_t*) {
+    auto* ref = static_cast<SlotReference*>(opaque);
+    ref->mapping->Release(ref->position);
+    delete ref;
+}
+
+} // namespace
+
+SharedFrameFormat SharedFrameFormat::Video(int width, int height, AVPixelFormat format) {
+    SharedFrameFormat result;
+    result.video = true;
+    result.width = width;
+    result.height = height;
+    result.pixelFormat = format;
+    return result;
+}
+
+SharedFrameFormat SharedFrameFormat::Audio(int sampleRate, int channels, AVSampleFormat format, int samples) {
+    SharedFrameFormat result;
+    result.video = false;
+    result.sampleRate = sampleRate;
+    result.channels = channels;
+    result.sampleFormat = format;
+    result.samples = samples;
+    return result;
+}
+
+// Consumer
+SharedFrameRing::SharedFrameRing(const std::string& name, const SharedFrameFormat& format, size_t slotCount)
+    : m_name(name), m_format(format)
+{
+    if (slotCount < 2 || slotCount > UINT32_MAX) throw std::invalid_argument("Shared ring needs at least two slots");
+    if (!format.video && av_sample_fmt_is_planar(format.sampleFormat) && format.channels > AV_NUM_DATA_POINTERS)
+        throw std::invalid_argument("Too many planar channels for a shared ring");
+
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t slotBytes = SlotBytes(format);
+    const size_t slotStride = RoundUp(slotBytes, page);
+    const size_t dataOffset = RoundUp(RoundUp(sizeof(RingHeader), 64) + slotCount * sizeof(SlotHeader), page);
+    const size_t mappingBytes = dataOffset + slotCount * slotStride;
+
+    // A ring left behind by a crashed consumer is replaced.
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd < 0) throw std::runtime_error("shm_open failed for " + name + ": " + std::strerror(errno));
+
+    try {
+        if (ftruncate(fd, static_cast<off_t>(mappingBytes)) != 0)
+            throw std::runtime_error(std::string("ftruncate failed: ") + std::strerror(errno));
+        m_mapping = std::make_shared<detail::SharedRingMapping>(fd, mappingBytes);
+    } catch (...) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw;
+    }
+    close(fd);
+    m_mapping->SetLayout(slotCount, slotBytes, slotStride, dataOffset);
+
+    RingHeader* header = new (m_mapping->base) RingHeader();
+    header->version = kVersion;
+    header->slotCount = static_cast<uint32_t>(slotCount);
+    header->video = format.video ? 1 : 0;
+    header->width = format.width;
+    header->height = format.height;
+    header->pixelFormat = format.pixelFormat;
+    header->sampleRate = format.sampleRate;
+    header->channels = format.channels;
+    header->sampleFormat = format.sampleFormat;
+    header->samples = format.samples;
+    header->slotBytes = slotBytes;
+    header->slotStride = slotStride;
+    header->dataOffset = dataOffset;
+    header->mappingBytes = mappingBytes;
+    header->writePosition.store(0, std::memory_order_relaxed);
+    header->producerPid.store(0, std::memory_order_relaxed);
+    header->producerGeneration.store(0, std::memory_order_relaxed);
+    header->heartbeatNs.store(0, std::memory_order_relaxed);
+    header->consumerPid.store(static_cast<int32_t>(getpid()), std::memory_order_relaxed);
+    header->publishSeq.store(0, std::memory_order_relaxed);
+    header->releaseSeq.store(0, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < slotCount; ++i) {
+        SlotHeader* slot = new (&m_mapping->slots[i]) SlotHeader();
+        slot->sequence.store(i, std::memory_order_relaxed);
+        slot->pts = AV_NOPTS_VALUE;
+        slot->generation = 0;
+    }
+    header->magic.store(kMagic, std::memory_order_release);
+}
+
+SharedFrameRing::~SharedFrameRing() {
+    // Frames still referenced keep the mapping alive; only the name goes away.
+    m_mapping->header->consumerPid.store(0, std::memory_order_release);
+    m_mapping->header->releaseSeq.fetch_add(1, std::memory_order_release);
+    WakeAll(m_mapping->header->releaseSeq);
+    shm_unlink(m_name.c_str());
+}
+
+bool SharedFrameRing::HasProducer() const {
+    return m_mapping->header->producerPid.load(std::memory_order_acquire) != 0;
+}
+
+bool SharedFrameRing::ProducerLost() {
+    RingHeader* header = m_mapping->header;
+    int32_t pid = header->producerPid.load(std::memory_order_acquire);
+    if (pid == 0) return false;
+
+    const int64_t silentNs = NowNanoseconds() - header->heartbeatNs.load(std::memory_order_acquire);
+    if (ProcessAlive(pid) && silentNs < static_cast<int64_t>(m_producerTimeoutMs) * 1000000) return false;
+
+    // Report each lost producer once; a replacement may have attached meanwhile.
+    if (!header->producerPid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel)) return false;
+    ++m_producersLost;
+    return true;
+}
+
+SharedRingStatus SharedFrameRing::Read(AVFrame* frame, int timeoutMs) {
+    RingHeader* header = m_mapping->header;
+    SlotHeader& slot = m_mapping->Slot(m_readPosition);
+    const int64_t deadline = NowNanoseconds() + static_cast<int64_t>(std::max(timeoutMs, 0)) * 1000000;
+
+    while (true) {
+        // Snapshot the futex word before checking, so a publish in between wakes us.
+        const uint32_t seen = header->publishSeq.load(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_acquire) == m_readPosition + 1) break;
+        if (ProducerLost()) return SharedRingStatus::ProducerLost;
+
+        const int64_t remainingMs = (deadline - NowNanoseconds()) / 1000000;
+        if (remainingMs <= 0) return SharedRingStatus::Timeout;
+        WaitOn(header->publishSeq, seen, static_cast<int>(std::min<int64_t>(remainingMs, kLivenessPollMs)));
+    }
+
+    uint8_t* data = m_mapping->SlotData(m_readPosition);
+    DescribeSlot(frame, m_format, data);
+    auto* ref = new SlotReference{m_mapping, m_readPosition};
+    frame->buf[0] = av_buffer_create(data, static_cast<size_t>(m_mapping->slotBytes), &ReleaseSlot, ref, 0);
+    if (!frame->buf[0]) {
+        delete ref;
+        throw std::bad_alloc();
+    }
+    frame->pts = slot.pts;
+
+    m_mapping->inFlight.fetch_add(1, std::memory_order_relaxed);
+    ++m_readPosition;
+    ++m_framesRead;
+    return SharedRingStatus::Frame;
+}
+
+SharedRingStatus SharedFrameRing::ReadVideoFrame(std::shared_ptr<VideoFrame>& frame, int timeoutMs) {
+    if (!m_format.video) throw std::logic_error("Shared ring carries audio frames");
+    AVFrame* slot = av_frame_alloc();
+    if (!slot) throw std::bad_alloc();
+    try {
+        SharedRingStatus status = Read(slot, timeoutMs);
+        if (status == SharedRingStatus::Frame) frame = VideoFrame::Wrap(slot);
+        av_frame_free(&slot);
+        return status;
+    } catch (...) {
+        av_frame_free(&slot);
+        throw;
+    }
+}
+
+SharedRingStatus SharedFrameRing::ReadAudioFrame(std::shared_ptr<AudioFrame>& frame, int timeoutMs) {
+    if (m_format.video) throw std::logic_error("Shared ring carries video frames");
+    AVFrame* slot = av_frame_alloc();
+    if (!slot) throw std::bad_alloc();
+    try {
+        SharedRingStatus status = Read(slot, timeoutMs);
+        if (status == SharedRingStatus::Frame) frame = AudioFrame::Wrap(slot);
+        av_frame_free(&slot);
+        return status;
+    } catch (...) {
+        av_frame_free(&slot);
+        throw;
+    }
+}
+
+SharedRingStats SharedFrameRing::Stats() const {
+    SharedRingStats stats;
+    stats.framesRead = m_framesRead;
+    stats.framesInFlight = m_mapping->inFlight.load(std::memory_order_relaxed);
+    stats.producerGeneration = m_mapping->header->producerGeneration.load(std::memory_order_relaxed);
+    stats.producersLost = m_producersLost;
+    return stats;
+}
+
+// Producer
+SharedFrameProducer::SharedFrameProducer(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) throw std::runtime_error("shm_open failed for " + name + ": " + std::strerror(errno));
+
+    try {
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RingHeader))
+            throw std::runtime_error("Shared ring " + name + " is not initialized");
+        m_mapping = std::make_shared<detail::SharedRingMapping>(fd, static_cast<size_t>(info.st_size));
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+
+    RingHeader* header = m_mapping->header;
+    if (header->magic.load(std::memory_order_acquire) != kMagic || header->version != kVersion)
+        throw std::runtime_error("Shared ring " + name + " has an incompatible layout");
+    m_format = FormatFromHeader(*header);
+    const uint64_t slotCount = header->slotCount;
+    const uint64_t slotStride = header->slotStride;
+    const uint64_t dataOffset = header->dataOffset;
+    if (slotCount < 2 || header->slotBytes < SlotBytes(m_format) || slotStride < header->slotBytes ||
+        dataOffset < RoundUp(sizeof(RingHeader), 64) + slotCount * sizeof(SlotHeader) ||
+        dataOffset + slotCount * slotStride > m_mapping->bytes) {
+        throw std::runtime_error("Shared ring " + name + " has an incompatible layout");
+    }
+    if (!m_format.video && av_sample_fmt_is_planar(m_format.sampleFormat) && m_format.channels > AV_NUM_DATA_POINTERS)
+        throw std::runtime_error("Shared ring " + name + " has too many planar channels");
+    m_mapping->SetLayout(slotCount, header->slotBytes, slotStride, dataOffset);
+
+    // Take over from a producer that died without detaching.
+    const int32_t self = static_cast<int32_t>(getpid());
+    int32_t current = header->producerPid.load(std::memory_order_acquire);
+    do {
+        if (current != 0 && current != self && ProcessAlive(current))
+            throw std::runtime_error("Shared ring " + name + " already has a producer");
+    } while (!header->producerPid.compare_exchange_weak(current, self, std::memory_order_acq_rel));
+    m_generation = header->producerGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
+    Heartbeat();
+
+    // The previous producer may have published a slot without recording it.
+    m_writePosition = header->writePosition.load(std::memory_order_acquire);
+    while (m_mapping->Slot(m_writePosition).sequence.load(std::memory_order_acquire) > m_writePosition) {
+        ++m_writePosition;
+    }
+    header->writePosition.store(m_writePosition, std::memory_order_release);
+
+    m_slotFrame = av_frame_alloc();
+    if (!m_slotFrame) throw std::bad_alloc();
+}
+
+SharedFrameProducer::~SharedFrameProducer() {
+    int32_t self = static_cast<int32_t>(getpid());
+    m_mapping->header->producerPid.compare_exchange_strong(self, 0, std::memory_order_acq_rel);
+    av_frame_free(&m_slotFrame);
+}
+
+void SharedFrameProducer::Heartbeat() {
+    m_mapping->header->heartbeatNs.store(NowNanoseconds(), std::memory_order_release);
+}
+
+bool SharedFrameProducer::ConsumerAlive() const {
+    return ProcessAlive(m_mapping->header->consumerPid.load(std::memory_order_acquire));
+}
+
+AVFrame* SharedFrameProducer::BeginWrite(int timeoutMs) {
+    if (m_writing) return m_slotFrame;
+
+    RingHeader* header = m_mapping->header;
+    SlotHeader& slot = m_mapping->Slot(m_writePosition);
+    const int64_t deadline = NowNanoseconds() + static_cast<int64_t>(std::max(timeoutMs, 0)) * 1000000;
+
+    while (true) {
+        const uint32_t seen = header->releaseSeq.load(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_acquire) == m_writePosition) break;
+        if (!ConsumerAlive()) throw std::runtime_error("Shared ring consumer is gone");
+        Heartbeat();
+
+        const int64_t remainingMs = (deadline - NowNanoseconds()) / 1000000;
+        if (remainingMs <= 0) return nullptr;
+        WaitOn(header->releaseSeq, seen, static_cast<int>(std::min<int64_t>(remainingMs, kLivenessPollMs)));
+    }
+
+    DescribeSlot(m_slotFrame, m_format, m_mapping->SlotData(m_writePosition));
+    m_writing = true;
+    return m_slotFrame;
+}
+
+void SharedFrameProducer::Publish(int64_t pts) {
+    if (!m_writing) return;
+    RingHeader* header = m_mapping->header;
+    SlotHeader& slot = m_mapping->Slot(m_writePosition);
+    slot.pts = pts;
+    slot.generation = m_generation;
+    slot.sequence.store(m_writePosition + 1, std::memory_order_release);
+    ++m_writePosition;
+    m_writing = false;
+
+    header->writePosition.store(m_writePosition, std::memory_order_release);
+    Heartbeat();
+    header->publishSeq.fetch_add(1, std::memory_order_release);
+    WakeAll(header->publishSeq);
+}
+
+bool SharedFrameProducer::WriteVideoFrame(const AVFrame* frame, int timeoutMs) {
+    if (!m_format.video || frame->width != m_format.width || frame->height != m_format.height ||
+        frame->format != m_format.pixelFormat) {
+        throw std::invalid_argument("Frame does not match the shared ring format");
+    }
+    AVFrame* slot = BeginWrite(timeoutMs);
+    if (!slot) return false;
+    if (!CopyImage(m_format.pixelFormat, slot->data, slot->linesize, frame->data, frame->linesize,
+                   m_format.width, m_format.height)) {
+        av_image_copy(slot->data, slot->linesize, const_cast<const uint8_t**>(frame->data), frame->linesize,
+                      m_format.pixelFormat, m_format.width, m_format.height);
+    }
+    Publish(frame->pts);
+    return true;
+}
+
+bool SharedFrameProducer::WriteAudioFrame(const AVFrame* frame, int timeoutMs) {
+    if (m_format.video || frame->nb_samples != m_format.samples || frame->format != m_format.sampleFormat ||
+        frame->ch_layout.nb_channels != m_format.channels) {
+        throw std::invalid_argument("Frame does not match the shared ring format");
+    }
+    AVFrame* slot = BeginWrite(timeoutMs);
+    if (!slot) return false;
+    av_samples_copy(slot->extended_data, frame->extended_data, 0, 0,
+                    m_format.samples, m_format.channels, m_format.sampleFormat);
+    Publish(frame->pts);
+    return true;
+}
+
+} // namespace MediaEncoder
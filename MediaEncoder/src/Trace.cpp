@@ -0,0 +1,238 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace MediaEncoder {
+
+std::atomic<bool> Trace::s_enabled(false);
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    int64_t begin;
+    int64_t end;
+    int64_t pts;
+};
+
+// Written only by its owning thread; the dumper reads [0, count).
+struct ThreadBuffer {
+    uint64_t threadId = 0;
+    size_t capacity = 0;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> count{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+// Events of a thread that has exited, kept without the unused capacity.
+struct RetiredEvents {
+    uint64_t threadId;
+    std::vector<TraceEvent> events;
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<RetiredEvents> retired;
+    uint64_t retiredDropped = 0;
+    std::atomic<size_t> eventsPerThread{1 << 16};
+};
+
+TraceRegistry& Registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+uint64_t CurrentThreadId() {
+#if defined(__APPLE__)
+    uint64_t tid = 0;
+    pthread_threadid_np(nullptr, &tid);
+    return tid;
+#elif defined(__linux__)
+    return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+}
+
+int64_t ProcessId() {
+#if defined(__APPLE__) || defined(__linux__)
+    return static_cast<int64_t>(getpid());
+#else
+    return 0;
+#endif
+}
+
+// Moves the thread's events into the registry and unregisters its buffer,
+// so short-lived threads (executor strands, writers) do not each leave a
+// full-capacity buffer behind.
+void RetireBuffer(const std::shared_ptr<ThreadBuffer>& buffer) {
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const size_t count = buffer->count.load(std::memory_order_acquire);
+    if (count > 0) {
+        const TraceEvent* events = buffer->events.get();
+        registry.retired.push_back({buffer->threadId, std::vector<TraceEvent>(events, events + count)});
+    }
+    registry.retiredDropped += buffer->dropped.load(std::memory_order_relaxed);
+    auto& buffers = registry.buffers;
+    for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+        if (*it == buffer) {
+            buffers.erase(it);
+            break;
+        }
+    }
+}
+
+struct LocalRegistration {
+    std::shared_ptr<ThreadBuffer> buffer;
+    ~LocalRegistration() {
+        if (buffer) RetireBuffer(buffer);
+    }
+};
+
+// Registration happens once per thread; recording after that is lock-free.
+ThreadBuffer& LocalBuffer() {
+    thread_local LocalRegistration registration;
+    std::shared_ptr<ThreadBuffer>& local = registration.buffer;
+    if (!local) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        TraceRegistry& registry = Registry();
+        buffer->threadId = CurrentThreadId();
+        buffer->capacity = registry.eventsPerThread.load(std::memory_order_relaxed);
+        buffer->events.reset(new TraceEvent[buffer->capacity]);
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(buffer);
+        local = std::move(buffer);
+    }
+    return *local;
+}
+
+void AppendEscaped(std::string& out, const char* text) {
+    for (const char* c = text ? text : ""; *c; ++c) {
+        if (*c == '"' || *c == '\\') out += '\\';
+        out += *c;
+    }
+}
+
+void AppendEvent(std::string& json, const TraceEvent& ev, int64_t pid, uint64_t threadId) {
+    char number[160];
+    json += "{\"name\":\"";
+    AppendEscaped(json, ev.name);
+    json += "\",\"cat\":\"";
+    AppendEscaped(json, ev.category);
+    std::snprintf(number, sizeof(number),
+                  "\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%lld,\"tid\":%llu",
+                  static_cast<long long>(ev.begin),
+                  static_cast<long long>(ev.end - ev.begin),
+                  static_cast<long long>(pid),
+                  static_cast<unsigned long long>(threadId));
+    json += number;
+    if (ev.pts != Trace::kNoPts) {
+        std::snprintf(number, sizeof(number), ",\"args\":{\"pts\":%lld}",
+                      static_cast<long long>(ev.pts));
+        json += number;
+    }
+    json += '}';
+}
+
+} // namespace
+
+void Trace::Enable(bool enabled, size_t eventsPerThread) {
+    if (eventsPerThread > 0) {
+        Registry().eventsPerThread.store(eventsPerThread, std::memory_order_relaxed);
+    }
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Trace::NowMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::Record(const char* name, const char* category,
+                   int64_t beginUs, int64_t endUs, int64_t pts) {
+    ThreadBuffer& buffer = LocalBuffer();
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index >= buffer.capacity) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[index] = TraceEvent{name, category, beginUs, endUs, pts};
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+std::string Trace::ToChromeTraceJson() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    const int64_t pid = ProcessId();
+    {
+        std::lock_guard<std::mutex> lock(Registry().mutex);
+        buffers = Registry().buffers;
+        for (const auto& retired : Registry().retired) {
+            for (const TraceEvent& ev : retired.events) {
+                if (!first) json += ',';
+                first = false;
+                AppendEvent(json, ev, pid, retired.threadId);
+            }
+        }
+    }
+
+    for (const auto& buffer : buffers) {
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            if (!first) json += ',';
+            first = false;
+            AppendEvent(json, buffer->events[i], pid, buffer->threadId);
+        }
+    }
+
+    json += "]}";
+    return json;
+}
+
+bool Trace::WriteChromeTrace(const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out << ToChromeTraceJson();
+    return static_cast<bool>(out);
+}
+
+void Trace::Clear() {
+    std::lock_guard<std::mutex> lock(Registry().mutex);
+    Registry().retired.clear();
+    Registry().retiredDropped = 0;
+    for (auto& buffer : Registry().buffers) {
+        buffer->count.store(0, std::memory_order_release);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Trace::DroppedEvents() {
+    std::lock_guard<std::mutex> lock(Registry().mutex);
+    uint64_t dropped = Registry().retiredDropped;
+    for (const auto& buffer : Registry().buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+} // namespace MediaEncoder
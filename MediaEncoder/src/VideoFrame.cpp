@@ -1,14 +1,18 @@
 #include "VideoFrame.h"
+#include "PlaneKernels.h"
 
 extern "C" {
 #include <libavutil/imgutils.h>
 #include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
 }
 
 namespace MediaEncoder {
 
-VideoFrame::VideoFrame(int width, int height, AVPixelFormat pixelFormat)
-    : m_disposed(false)
+VideoFrame::VideoFrame(int width, int height, AVPixelFormat pixelFormat,
+                       std::shared_ptr<FrameAllocator> allocator)
+    : m_disposed(false), m_allocator(allocator ? std::move(allocator) : FrameAllocator::Default()),
+      m_traits(GetPixelFormatTraits(pixelFormat))
 {
     m_frame = av_frame_alloc();
     if (!m_frame) {
@@ -19,39 +23,79 @@ VideoFrame::VideoFrame(int width, int height, AVPixelFormat pixelFormat)
     m_frame->height = height;
     m_frame->format = pixelFormat;
 
-    int ret = av_image_alloc(m_frame->data, m_frame->linesize, width, height, pixelFormat, 32);
-    if (ret < 0) {
+    try {
+        m_allocator->AllocateVideo(m_frame);
+    } catch (...) {
         av_frame_free(&m_frame);
-        throw std::runtime_error("Failed to allocate raw picture buffer");
+        throw;
     }
 }
 
-VideoFrame::VideoFrame(const VideoFrame& other)
-    : m_disposed(false)
+VideoFrame::VideoFrame(const AVFrame* source)
+    : m_disposed(false), m_allocator(FrameAllocator::Default()),
+      m_traits(GetPixelFormatTraits(static_cast<AVPixelFormat>(source->format)))
 {
-    m_frame = av_frame_clone(other.m_frame);
+    m_frame = av_frame_alloc();
     if (!m_frame) {
-        throw std::runtime_error("Failed to clone AVFrame");
+        throw std::runtime_error("Failed to allocate AVFrame");
     }
+
+    // av_frame_ref() shares refcounted buffers and copies unowned ones.
+    if (av_frame_ref(m_frame, source) < 0) {
+        av_frame_free(&m_frame);
+        throw std::runtime_error("Failed to reference AVFrame");
+    }
+}
+
+VideoFrame::VideoFrame(const VideoFrame& other)
+    : VideoFrame(other.NativePointer())
+{
+    m_allocator = other.m_allocator;
 }
 
 VideoFrame::VideoFrame(VideoFrame&& other) noexcept
-    : m_frame(other.m_frame), m_disposed(other.m_disposed)
+    : m_frame(other.m_frame), m_disposed(other.m_disposed), m_allocator(std::move(other.m_allocator)),
+      m_traits(other.m_traits)
 {
     other.m_frame = nullptr;
     other.m_disposed = true;
 }
 
+VideoFrame& VideoFrame::operator=(const VideoFrame& other)
+{
+    if (this == &other) return *this;
+    VideoFrame copy(other);
+    return *this = std::move(copy);
+}
+
+VideoFrame& VideoFrame::operator=(VideoFrame&& other) noexcept
+{
+    if (this == &other) return *this;
+    Dispose();
+    m_frame = other.m_frame;
+    m_disposed = other.m_disposed;
+    m_allocator = std::move(other.m_allocator);
+    m_traits = other.m_traits;
+    other.m_frame = nullptr;
+    other.m_disposed = true;
+    return *this;
+}
+
 VideoFrame::~VideoFrame()
 {
     Dispose();
 }
 
+std::shared_ptr<VideoFrame> VideoFrame::Wrap(const AVFrame* frame)
+{
+    if (!frame) throw std::invalid_argument("Cannot wrap a null AVFrame");
+    return std::shared_ptr<VideoFrame>(new VideoFrame(frame));
+}
+
 void VideoFrame::Dispose()
 {
     if (!m_disposed) {
         if (m_frame) {
-            av_freep(&m_frame->data[0]);
             av_frame_free(&m_frame);
         }
         m_disposed = true;
@@ -61,9 +105,65 @@ void VideoFrame::Dispose()
 void VideoFrame::FillFrame(const uint8_t* srcData, int srcStride)
 {
     CheckIfDisposed();
-    av_image_fill_arrays(m_frame->data, m_frame->linesize, srcData,
-                         static_cast<AVPixelFormat>(m_frame->format),
-                         m_frame->width, m_frame->height, 1);
+    MakeWritable();
+
+    const AVPixelFormat format = static_cast<AVPixelFormat>(m_frame->format);
+    if (m_traits.planes > 0) {
+        // Planes back to back, rows tightly packed (palette last).
+        const uint8_t* planes[4] = {};
+        int linesizes[4] = {};
+        const uint8_t* next = srcData;
+        for (int plane = 0; plane < m_traits.planes; ++plane) {
+            planes[plane] = next;
+            linesizes[plane] = m_traits.PlaneRowBytes(plane, m_frame->width);
+            next += static_cast<size_t>(linesizes[plane]) * m_traits.PlaneHeight(plane, m_frame->height);
+        }
+        if (m_traits.palette) planes[1] = next;
+        if (srcStride > 0 && m_traits.planes == 1) linesizes[0] = srcStride;
+        CopyImage(format, m_frame->data, m_frame->linesize, planes, linesizes, m_frame->width, m_frame->height);
+        return;
+    }
+
+    uint8_t* srcPlanes[4] = {};
+    int srcLinesizes[4] = {};
+    if (av_image_fill_arrays(srcPlanes, srcLinesizes, srcData, format,
+                             m_frame->width, m_frame->height, 1) < 0) {
+        throw std::runtime_error("Unsupported pixel format for FillFrame");
+    }
+    if (srcStride > 0 && av_pix_fmt_count_planes(format) == 1) {
+        srcLinesizes[0] = srcStride;
+    }
+
+    av_image_copy(m_frame->data, m_frame->linesize,
+                  const_cast<const uint8_t**>(srcPlanes), srcLinesizes,
+                  format, m_frame->width, m_frame->height);
+}
+
+void VideoFrame::ClearFrame()
+{
+    CheckIfDisposed();
+    MakeWritable();
+
+    const AVPixelFormat format = static_cast<AVPixelFormat>(m_frame->format);
+    if (ClearImage(format, m_frame->data, m_frame->linesize, m_frame->width, m_frame->height)) return;
+
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; ++i) linesizes[i] = m_frame->linesize[i];
+    if (av_image_fill_black(m_frame->data, linesizes, format, AVCOL_RANGE_MPEG, m_frame->width, m_frame->height) < 0) {
+        throw std::runtime_error("Unsupported pixel format for ClearFrame");
+    }
+}
+
+void VideoFrame::MakeWritable()
+{
+    CheckIfDisposed();
+    m_allocator->MakeWritable(m_frame);
+}
+
+bool VideoFrame::IsWritable() const
+{
+    CheckIfDisposed();
+    return av_frame_is_writable(m_frame) != 0;
 }
 
 AVFrame* VideoFrame::NativePointer() const {
@@ -104,10 +204,43 @@ std::vector<uint8_t*> VideoFrame::DataPointer() const {
     return result;
 }
 
+std::array<uint8_t*, 4> VideoFrame::Planes() const {
+    CheckIfDisposed();
+    return {m_frame->data[0], m_frame->data[1], m_frame->data[2], m_frame->data[3]};
+}
+
+std::array<int, 4> VideoFrame::Strides() const {
+    CheckIfDisposed();
+    return {m_frame->linesize[0], m_frame->linesize[1], m_frame->linesize[2], m_frame->linesize[3]};
+}
+
+PlaneView VideoFrame::Plane(int index) const {
+    CheckIfDisposed();
+    PlaneView view;
+    if (index < 0 || index >= 4 || !m_frame->data[index]) return view;
+    view.data = m_frame->data[index];
+    view.linesize = m_frame->linesize[index];
+    if (m_traits.planes > 0) {
+        if (index >= m_traits.planes) return PlaneView();
+        view.rowBytes = m_traits.PlaneRowBytes(index, m_frame->width);
+        view.rows = m_traits.PlaneHeight(index, m_frame->height);
+        return view;
+    }
+
+    // Formats without traits: ask libavutil.
+    const AVPixelFormat format = static_cast<AVPixelFormat>(m_frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc || index >= av_pix_fmt_count_planes(format)) return PlaneView();
+    const bool chroma = (index == 1 || index == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+    view.rowBytes = av_image_get_linesize(format, m_frame->width, index);
+    view.rows = chroma ? AV_CEIL_RSHIFT(m_frame->height, desc->log2_chroma_h) : m_frame->height;
+    return view;
+}
+
 void VideoFrame::CheckIfDisposed() const {
     if (m_disposed || !m_frame) {
         throw std::runtime_error("The object was already disposed.");
     }
 }
 
-} // namespace MediaEncoder
\ No newline at end of file
+} // namespace MediaEncoder
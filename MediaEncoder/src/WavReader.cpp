@@ -0,0 +1,138 @@
+#include "WavReader.h"
+
+#include <bitset>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+namespace MediaEncoder {
+
+namespace {
+
+constexpr uint16_t kFormatPcm = 0x0001;
+constexpr uint16_t kFormatFloat = 0x0003;
+constexpr uint16_t kFormatExtensible = 0xFFFE;
+
+uint16_t ReadLe16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+AVSampleFormat SampleFormatFor(uint16_t format, int bits) {
+    if (format == kFormatFloat) {
+        if (bits == 32) return AV_SAMPLE_FMT_FLT;
+        if (bits == 64) return AV_SAMPLE_FMT_DBL;
+    } else if (format == kFormatPcm) {
+        if (bits == 8) return AV_SAMPLE_FMT_U8;
+        if (bits == 16) return AV_SAMPLE_FMT_S16;
+        if (bits == 32) return AV_SAMPLE_FMT_S32;
+    }
+    throw std::invalid_argument("Unsupported WAV sample format (" + std::to_string(bits) + "-bit, tag " +
+                                std::to_string(format) + ")");
+}
+
+} // namespace
+
+WavReader::WavReader(const std::string& path, int samplesPerFrame)
+    : m_file(MappedFile::Open(path)), m_samplesPerFrame(samplesPerFrame)
+{
+    if (samplesPerFrame <= 0) throw std::invalid_argument("samplesPerFrame must be positive");
+    ParseHeader();
+    m_file->WillNeed(m_dataOffset, m_blockAlign * m_samplesPerFrame * static_cast<size_t>(m_readahead));
+}
+
+void WavReader::SetSamplesPerFrame(int samples) {
+    if (samples <= 0) throw std::invalid_argument("samplesPerFrame must be positive");
+    m_samplesPerFrame = samples;
+}
+
+void WavReader::ParseHeader() {
+    const uint8_t* data = m_file->Data();
+    const size_t size = m_file->Size();
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0)
+        throw std::invalid_argument(m_file->Path() + " is not a RIFF/WAVE file");
+
+    bool haveFormat = false;
+    uint16_t formatTag = 0;
+    int bits = 0;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* chunk = data + pos;
+        size_t chunkSize = ReadLe32(chunk + 4);
+        const size_t body = pos + 8;
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkSize < 16 || size - body < chunkSize) throw std::invalid_argument("Truncated WAV fmt chunk");
+            formatTag = ReadLe16(data + body);
+            m_channels = ReadLe16(data + body + 2);
+            m_sampleRate = static_cast<int>(ReadLe32(data + body + 4));
+            m_blockAlign = ReadLe16(data + body + 12);
+            bits = ReadLe16(data + body + 14);
+            if (formatTag == kFormatExtensible && chunkSize >= 40) {
+                m_channelMask = ReadLe32(data + body + 20);
+                formatTag = ReadLe16(data + body + 24);     // first bytes of the subformat GUID
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) throw std::invalid_argument("WAV data chunk precedes fmt chunk");
+            // Streamed WAVs leave the size at 0 or 0xFFFFFFFF; use what is on disk.
+            if (chunkSize == 0 || chunkSize > size - body) chunkSize = size - body;
+            m_dataOffset = body;
+            m_dataBytes = chunkSize;
+            break;
+        }
+        pos = body + chunkSize + (chunkSize & 1);
+    }
+
+    if (!haveFormat || m_dataOffset == 0) throw std::invalid_argument("WAV file has no fmt or data chunk");
+    if (m_channels <= 0 || m_sampleRate <= 0) throw std::invalid_argument("WAV file has an invalid format");
+    m_sampleFormat = SampleFormatFor(formatTag, bits);
+    if (m_blockAlign != static_cast<size_t>(m_channels) * (bits / 8))
+        throw std::invalid_argument("WAV block alignment does not match its sample format");
+    m_dataBytes -= m_dataBytes % m_blockAlign;
+}
+
+bool WavReader::ReadFrame(std::shared_ptr<AudioFrame>& frame) {
+    const size_t consumed = static_cast<size_t>(m_samplesRead) * m_blockAlign;
+    if (consumed >= m_dataBytes) return false;
+
+    const size_t remaining = (m_dataBytes - consumed) / m_blockAlign;
+    const int samples = remaining < static_cast<size_t>(m_samplesPerFrame) ? static_cast<int>(remaining) : m_samplesPerFrame;
+    const size_t offset = m_dataOffset + consumed;
+    const size_t bytes = static_cast<size_t>(samples) * m_blockAlign;
+
+    AVFrame* view = av_frame_alloc();
+    if (!view) throw std::bad_alloc();
+    try {
+        view->format = m_sampleFormat;
+        view->sample_rate = m_sampleRate;
+        view->nb_samples = samples;
+        if (m_channelMask && std::bitset<64>(m_channelMask).count() == static_cast<size_t>(m_channels))
+            av_channel_layout_from_mask(&view->ch_layout, m_channelMask);
+        else
+            av_channel_layout_default(&view->ch_layout, m_channels);
+        view->pts = m_samplesRead;
+        view->buf[0] = m_file->Reference(offset, bytes);
+        view->data[0] = view->buf[0]->data;
+        view->linesize[0] = static_cast<int>(bytes);
+        view->extended_data = view->data;
+        frame = AudioFrame::Wrap(view);
+    } catch (...) {
+        av_frame_free(&view);
+        throw;
+    }
+    av_frame_free(&view);
+
+    m_samplesRead += samples;
+    m_file->WillNeed(offset + bytes, m_blockAlign * m_samplesPerFrame * static_cast<size_t>(m_readahead));
+    return true;
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,135 @@
+#include "MediaWriter.h"
+
+#if defined(MEDIAENCODER_COROUTINES)
+
+#include "Executor.h"
+#include "VideoFrame.h"
+#include "AudioFrame.h"
+
+#include <new>
+#include <stdexcept>
+
+namespace MediaEncoder {
+
+namespace {
+
+void Resume(const ResumeExecutor& resume, std::function<void()> task) {
+    if (resume) resume(std::move(task));
+    else task();
+}
+
+// Same view as Encode*Frame: pts is set on a reference, never on the caller's frame.
+AVFrame* ReferenceFrame(const AVFrame* source, int64_t pts) {
+    AVFrame* view = av_frame_alloc();
+    if (!view) throw std::bad_alloc();
+    if (av_frame_ref(view, source) < 0) {
+        av_frame_free(&view);
+        throw std::runtime_error("Failed to reference input frame");
+    }
+    view->pts = pts;
+    return view;
+}
+
+} // namespace
+
+ResumeExecutor ResumeOn(std::shared_ptr<ExecutorClient> client) {
+    return [client = std::move(client)](std::function<void()> task) { client->Post(std::move(task)); };
+}
+
+WriterSubmitAwaitable::WriterSubmitAwaitable(MediaWriter& writer, AVFrame* frame, bool video,
+                                             const ResumeExecutor& resume)
+    : m_writer(writer), m_frame(frame), m_video(video), m_resume(resume) {}
+
+WriterSubmitAwaitable::~WriterSubmitAwaitable() {
+    av_frame_free(&m_frame);
+}
+
+// True once the frame is queued, encoded (synchronous writer) or failed.
+bool WriterSubmitAwaitable::TrySubmit() {
+    if (!m_frame) return true;
+    try {
+        if (!m_writer.IsAsync()) {
+            if (m_video) m_writer.EncodeNativeVideoFrame(m_frame);
+            else m_writer.EncodeNativeAudioFrame(m_frame);
+            return true;
+        }
+        return m_video ? m_writer.TrySubmitVideoFrame(m_frame) : m_writer.TrySubmitAudioFrame(m_frame);
+    } catch (...) {
+        m_error = std::current_exception();
+        return true;
+    }
+}
+
+// Returns false when the submission completed here instead of suspending.
+bool WriterSubmitAwaitable::Wait(std::coroutine_handle<> handle) {
+    bool waiting = m_writer.NotifyWhenWritable([this, handle] {
+        Resume(m_resume, [this, handle] {
+            if (TrySubmit() || !Wait(handle)) handle.resume();
+        });
+    });
+    if (waiting) return true;
+
+    // Nothing queued to wait for: only a memory budget held by other
+    // writers can be in the way, so block like EncodeNativeVideoFrame.
+    try {
+        if (m_video) m_writer.EncodeNativeVideoFrame(m_frame);
+        else m_writer.EncodeNativeAudioFrame(m_frame);
+    } catch (...) {
+        m_error = std::current_exception();
+    }
+    return false;
+}
+
+void WriterSubmitAwaitable::await_resume() {
+    if (m_error) std::rethrow_exception(m_error);
+}
+
+bool WriterCloseAwaitable::await_ready() {
+    if (m_writer.IsAsync() && m_resume) return false;
+    Close();
+    return true;
+}
+
+void WriterCloseAwaitable::await_suspend(std::coroutine_handle<> handle) {
+    m_writer.NotifyWhenFlushed([this, handle] {
+        Resume(m_resume, [this, handle] {
+            Close();
+            handle.resume();
+        });
+    });
+}
+
+void WriterCloseAwaitable::await_resume() {
+    if (m_error) std::rethrow_exception(m_error);
+}
+
+void WriterCloseAwaitable::Close() {
+    try {
+        m_writer.Close();
+    } catch (...) {
+        m_error = std::current_exception();
+    }
+}
+
+void MediaWriter::SetResumeExecutor(ResumeExecutor executor) {
+    if (IsAsync()) throw std::logic_error("Resume executor must be set before StartAsync");
+    m_data->resumeExecutor = std::move(executor);
+}
+
+WriterSubmitAwaitable MediaWriter::EncodeVideoFrameAsync(VideoFrame* frame, int64_t pts) {
+    AVFrame* view = frame ? ReferenceFrame(frame->NativePointer(), pts) : nullptr;
+    return WriterSubmitAwaitable(*this, view, true, m_data->resumeExecutor);
+}
+
+WriterSubmitAwaitable MediaWriter::EncodeAudioFrameAsync(AudioFrame* frame, int64_t pts) {
+    AVFrame* view = frame ? ReferenceFrame(frame->NativePointer(), pts) : nullptr;
+    return WriterSubmitAwaitable(*this, view, false, m_data->resumeExecutor);
+}
+
+WriterCloseAwaitable MediaWriter::CloseAsync() {
+    return WriterCloseAwaitable(*this, m_data->resumeExecutor);
+}
+
+} // namespace MediaEncoder
+
+#endif // MEDIAENCODER_COROUTINES
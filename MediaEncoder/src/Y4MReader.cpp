@@ -0,0 +1,153 @@
+#include "Y4MReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+namespace MediaEncoder {
+
+namespace {
+
+constexpr char kSignature[] = "YUV4MPEG2 ";
+constexpr char kFrameTag[] = "FRAME";
+constexpr size_t kMaxHeaderLine = 4096;
+
+struct ColorspaceEntry {
+    const char* name;
+    AVPixelFormat format;
+};
+
+// Exact matches on the C tag value; the 420 variants only differ in chroma siting.
+const ColorspaceEntry kColorspaces[] = {
+    {"420jpeg", AV_PIX_FMT_YUV420P},
+    {"420paldv", AV_PIX_FMT_YUV420P},
+    {"420mpeg2", AV_PIX_FMT_YUV420P},
+    {"420p10", AV_PIX_FMT_YUV420P10LE},
+    {"422p10", AV_PIX_FMT_YUV422P10LE},
+    {"444p10", AV_PIX_FMT_YUV444P10LE},
+    {"420p12", AV_PIX_FMT_YUV420P12LE},
+    {"422p12", AV_PIX_FMT_YUV422P12LE},
+    {"444p12", AV_PIX_FMT_YUV444P12LE},
+    {"420p16", AV_PIX_FMT_YUV420P16LE},
+    {"422p16", AV_PIX_FMT_YUV422P16LE},
+    {"444p16", AV_PIX_FMT_YUV444P16LE},
+    {"444alpha", AV_PIX_FMT_YUVA444P},
+    {"mono16", AV_PIX_FMT_GRAY16LE},
+    {"mono", AV_PIX_FMT_GRAY8},
+    {"420", AV_PIX_FMT_YUV420P},
+    {"422", AV_PIX_FMT_YUV422P},
+    {"444", AV_PIX_FMT_YUV444P},
+    {"411", AV_PIX_FMT_YUV411P},
+};
+
+AVPixelFormat ParseColorspace(const std::string& value) {
+    for (const auto& entry : kColorspaces) {
+        if (value == entry.name) return entry.format;
+    }
+    throw std::invalid_argument("Unsupported Y4M colorspace C" + value);
+}
+
+AVRational ParseRatio(const std::string& value) {
+    int num = 0;
+    int den = 0;
+    if (std::sscanf(value.c_str(), "%d:%d", &num, &den) != 2) throw std::invalid_argument("Malformed Y4M ratio " + value);
+    return AVRational{num, den};
+}
+
+} // namespace
+
+Y4MReader::Y4MReader(const std::string& path)
+    : m_file(MappedFile::Open(path))
+{
+    ParseHeader();
+    m_file->WillNeed(m_offset, m_frameBytes * static_cast<size_t>(m_readahead));
+}
+
+void Y4MReader::ParseHeader() {
+    const char* data = reinterpret_cast<const char*>(m_file->Data());
+    const size_t size = m_file->Size();
+    const size_t signatureLength = sizeof(kSignature) - 1;
+    if (size < signatureLength || std::memcmp(data, kSignature, signatureLength) != 0)
+        throw std::invalid_argument(m_file->Path() + " is not a YUV4MPEG2 file");
+
+    const void* newline = std::memchr(data, '\n', std::min(size, kMaxHeaderLine));
+    if (!newline) throw std::invalid_argument("Y4M header of " + m_file->Path() + " is not terminated");
+    const size_t headerLength = static_cast<const char*>(newline) - data;
+
+    // Parameters are single-letter tags followed by their value, space separated.
+    size_t pos = signatureLength;
+    while (pos < headerLength) {
+        size_t end = pos;
+        while (end < headerLength && data[end] != ' ') ++end;
+        if (end > pos) {
+            const char tag = data[pos];
+            const std::string value(data + pos + 1, end - pos - 1);
+            switch (tag) {
+            case 'W': m_width = std::atoi(value.c_str()); break;
+            case 'H': m_height = std::atoi(value.c_str()); break;
+            case 'F': m_frameRate = ParseRatio(value); break;
+            case 'A': m_sampleAspect = ParseRatio(value); break;
+            case 'C': m_pixelFormat = ParseColorspace(value); break;
+            case 'I':
+                if (value != "p" && value != "?") throw std::invalid_argument("Interlaced Y4M input is not supported");
+                break;
+            default: break;    // X comments and unknown tags
+            }
+        }
+        pos = end + 1;
+    }
+
+    if (m_width <= 0 || m_height <= 0) throw std::invalid_argument("Y4M header lacks frame dimensions");
+    if (m_frameRate.num <= 0 || m_frameRate.den <= 0) throw std::invalid_argument("Y4M header has an invalid frame rate");
+
+    int frameBytes = av_image_get_buffer_size(m_pixelFormat, m_width, m_height, 1);
+    if (frameBytes <= 0) throw std::invalid_argument("Y4M frame size overflows");
+    m_frameBytes = static_cast<size_t>(frameBytes);
+    m_offset = headerLength + 1;
+}
+
+bool Y4MReader::ReadFrame(std::shared_ptr<VideoFrame>& frame) {
+    const char* data = reinterpret_cast<const char*>(m_file->Data());
+    const size_t size = m_file->Size();
+    if (m_offset >= size) return false;
+
+    const size_t tagLength = sizeof(kFrameTag) - 1;
+    if (size - m_offset < tagLength || std::memcmp(data + m_offset, kFrameTag, tagLength) != 0)
+        throw std::runtime_error("Missing FRAME marker in " + m_file->Path());
+    const void* newline = std::memchr(data + m_offset, '\n', std::min(size - m_offset, kMaxHeaderLine));
+    if (!newline) throw std::runtime_error("Unterminated FRAME header in " + m_file->Path());
+
+    const size_t pixels = static_cast<const char*>(newline) - data + 1;
+    if (size - pixels < m_frameBytes) throw std::runtime_error("Truncated frame in " + m_file->Path());
+
+    AVFrame* view = av_frame_alloc();
+    if (!view) throw std::bad_alloc();
+    try {
+        view->format = m_pixelFormat;
+        view->width = m_width;
+        view->height = m_height;
+        view->sample_aspect_ratio = m_sampleAspect;
+        view->pts = m_framesRead;
+        view->buf[0] = m_file->Reference(pixels, m_frameBytes);
+        av_image_fill_arrays(view->data, view->linesize, view->buf[0]->data, m_pixelFormat, m_width, m_height, 1);
+        frame = VideoFrame::Wrap(view);
+    } catch (...) {
+        av_frame_free(&view);
+        throw;
+    }
+    av_frame_free(&view);
+
+    m_offset = pixels + m_frameBytes;
+    ++m_framesRead;
+    // Frame headers are a few bytes, so the next frames start roughly here.
+    m_file->WillNeed(m_offset, m_frameBytes * static_cast<size_t>(m_readahead));
+    return true;
+}
+
+} // namespace MediaEncoder
@@ -0,0 +1,238 @@
+// writer-awaitables-stress: many coroutine producers against tiny async queues.
+//
+//   writer-awaitables-stress [-w writers] [-f frames] [-q capacity] [-t threads]
+//
+// Starts one producer coroutine per writer from a few launcher threads. Each
+// co_awaits EncodeVideoFrameAsync for every frame and then CloseAsync, with
+// encoding and resumption sharing one small Executor. The queues are kept
+// tiny so nearly every await suspends and is woken through
+// NotifyWhenWritable/NotifyWhenFlushed. Each producer destroys its writer as
+// soon as CloseAsync resumes it, while the writer's last pump task may still
+// be unwinding. Fails if a producer is never resumed (lost wakeup), resumed
+// more often than it suspended, or if a writer did not encode every frame.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Executor.h"
+#include "MediaWriter.h"
+#include "VideoFrame.h"
+
+using namespace MediaEncoder;
+
+namespace {
+
+struct Options {
+    int writers = 2000;
+    int frames = 32;
+    int capacity = 1;
+    int threads = 4;
+    int timeoutSeconds = 120;
+};
+
+void PrintUsage() {
+    std::fprintf(stderr, "usage: writer-awaitables-stress [-w writers] [-f frames] [-q capacity] [-t threads]\n");
+}
+
+// Fire-and-forget coroutine; completion is reported through Producer.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+struct Producer {
+    std::unique_ptr<MediaWriter> writer;
+    std::atomic<uint32_t> suspended{0};
+    std::atomic<uint32_t> resumed{0};
+    std::atomic<uint32_t> awaited{0};
+    std::atomic<uint32_t> completed{0};
+    uint64_t encoded = 0;
+    std::string error;
+};
+
+// Counts suspensions and resumptions of one co_await.
+template <typename Awaitable>
+struct Counted {
+    Awaitable& inner;
+    Producer& producer;
+    bool suspended = false;
+
+    bool await_ready() { return inner.await_ready(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        // Counted before handing over: the resumption may run before this returns.
+        suspended = true;
+        producer.suspended.fetch_add(1);
+        if constexpr (std::is_void_v<decltype(inner.await_suspend(handle))>) {
+            inner.await_suspend(handle);
+            return true;
+        } else {
+            if (inner.await_suspend(handle)) return true;
+            suspended = false;
+            producer.suspended.fetch_sub(1);
+            return false;
+        }
+    }
+
+    void await_resume() {
+        if (suspended) producer.resumed.fetch_add(1);
+        producer.awaited.fetch_add(1);
+        inner.await_resume();
+    }
+};
+
+class Completion {
+public:
+    explicit Completion(int count) : m_remaining(count) {}
+
+    void Done() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_remaining == 0) m_cv.notify_all();
+    }
+
+    bool Wait(std::chrono::seconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_for(lock, timeout, [this] { return m_remaining <= 0; });
+    }
+
+    int Remaining() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_remaining;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    int m_remaining;
+};
+
+Detached Produce(Producer& producer, VideoFrame& frame, int frames, Completion& completion) {
+    try {
+        for (int i = 0; i < frames; ++i) {
+            auto submit = producer.writer->EncodeVideoFrameAsync(&frame, i);
+            co_await Counted<WriterSubmitAwaitable>{submit, producer};
+        }
+        auto close = producer.writer->CloseAsync();
+        co_await Counted<WriterCloseAwaitable>{close, producer};
+        producer.encoded = producer.writer->GetStats().videoFramesEncoded;
+    } catch (const std::exception& e) {
+        producer.error = e.what();
+    }
+    producer.writer.reset();
+    producer.completed.fetch_add(1);
+    completion.Done();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "-w" || arg == "-f" || arg == "-q" || arg == "-t") && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value <= 0) {
+                PrintUsage();
+                return 2;
+            }
+            if (arg == "-w") options.writers = value;
+            else if (arg == "-f") options.frames = value;
+            else if (arg == "-q") options.capacity = value;
+            else options.threads = value;
+        } else if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    Executor executor(static_cast<size_t>(options.threads));
+    VideoFrame frame(16, 16, AV_PIX_FMT_YUV420P);
+    frame.ClearFrame();
+
+    std::vector<std::unique_ptr<Producer>> producers;
+    producers.reserve(options.writers);
+    for (int i = 0; i < options.writers; ++i) {
+        auto producer = std::make_unique<Producer>();
+        const std::string name = "writer-" + std::to_string(i);
+        producer->writer = std::make_unique<MediaWriter>(16, 16, 25, 1, "rawvideo", 0, "", 0);
+        producer->writer->AttachExecutor(executor, name);
+        producer->writer->Open(name, "null");
+        producer->writer->SetResumeExecutor(ResumeOn(executor.CreateClient(name + "-resume")));
+        producer->writer->StartAsync(static_cast<size_t>(options.capacity));
+        producers.push_back(std::move(producer));
+    }
+
+    // Producers start on a few threads and continue wherever they are resumed.
+    Completion completion(options.writers);
+    std::vector<std::thread> launchers;
+    for (int t = 0; t < options.threads; ++t) {
+        launchers.emplace_back([&, t] {
+            for (int i = t; i < options.writers; i += options.threads) {
+                Produce(*producers[i], frame, options.frames, completion);
+            }
+        });
+    }
+    for (auto& launcher : launchers) launcher.join();
+
+    if (!completion.Wait(std::chrono::seconds(options.timeoutSeconds))) {
+        int stuck = 0;
+        for (int i = 0; i < options.writers; ++i) {
+            const Producer& p = *producers[i];
+            if (p.completed.load() != 0) continue;
+            if (stuck++ < 10) {
+                std::fprintf(stderr, "writer-%d never resumed: %u/%d awaits, %u suspended, %u resumed\n", i,
+                             p.awaited.load(), options.frames + 1, p.suspended.load(), p.resumed.load());
+            }
+        }
+        std::fprintf(stderr, "FAIL: %d of %d producers lost a wakeup\n", completion.Remaining(), options.writers);
+        // Suspended coroutines still reference the writers; do not unwind.
+        std::_Exit(1);
+    }
+
+    int failures = 0;
+    uint64_t suspensions = 0;
+    for (int i = 0; i < options.writers; ++i) {
+        const Producer& p = *producers[i];
+        suspensions += p.suspended.load();
+        std::string problem;
+        if (!p.error.empty()) problem = p.error;
+        else if (p.completed.load() != 1) problem = "completed " + std::to_string(p.completed.load()) + " times";
+        else if (p.resumed.load() != p.suspended.load())
+            problem = "resumed " + std::to_string(p.resumed.load()) + " times after " +
+                      std::to_string(p.suspended.load()) + " suspensions";
+        else if (p.awaited.load() != static_cast<uint32_t>(options.frames) + 1)
+            problem = std::to_string(p.awaited.load()) + " awaits completed";
+        else if (p.encoded != static_cast<uint64_t>(options.frames))
+            problem = std::to_string(p.encoded) + " frames encoded";
+        if (!problem.empty() && failures++ < 10) std::fprintf(stderr, "writer-%d: %s\n", i, problem.c_str());
+    }
+
+    std::printf("%d writers x %d frames, queue capacity %d, %d threads: %llu suspensions\n",
+                options.writers, options.frames, options.capacity, options.threads,
+                static_cast<unsigned long long>(suspensions));
+    if (failures) {
+        std::fprintf(stderr, "FAIL: %d writers\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,369 @@
+// mediaencoder-cli: encodes a manifest of jobs concurrently.
+//
+//   mediaencoder-cli [-j jobs] [-t encoder-threads] manifest
+//
+// The manifest has one job per line as whitespace-separated key=value pairs;
+// blank lines and lines starting with '#' are ignored:
+//
+//   video=in.y4m audio=in.wav output=out.mp4 vcodec=libx264 vbitrate=4000000 acodec=aac abitrate=128000
+//
+// Keys: video (Y4M), audio (WAV), output (required), format (muxer name,
+// guessed from output otherwise), vcodec/acodec (default libx264/aac),
+// vbitrate/abitrate, threads (encoder threads for this job).
+//
+// Inputs are memory mapped and handed to MediaWriter as zero-copy frames;
+// pixel and sample formats are only converted when they differ from the
+// encoder's. Each writer runs in async mode so reading and conversion
+// overlap with encoding.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+#include "AudioFrame.h"
+#include "MediaWriter.h"
+#include "Scaler.h"
+#include "VideoFrame.h"
+#include "WavReader.h"
+#include "Y4MReader.h"
+
+using namespace MediaEncoder;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Job {
+    int line = 0;
+    std::string video;
+    std::string audio;
+    std::string output;
+    std::string format;
+    std::string videoCodec = "libx264";
+    std::string audioCodec = "aac";
+    int videoBitrate = 4000000;
+    int audioBitrate = 128000;
+    int threads = -1;
+};
+
+struct JobResult {
+    std::atomic<uint64_t> videoFrames{0};
+    std::atomic<uint64_t> audioFrames{0};
+    double mediaSeconds = 0;
+    double wallSeconds = 0;
+    std::string error;
+};
+
+int ParseInt(const std::string& value, const std::string& key, int line) {
+    char* end = nullptr;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed < 0 || parsed > INT32_MAX)
+        throw std::invalid_argument("line " + std::to_string(line) + ": invalid " + key + " '" + value + "'");
+    return static_cast<int>(parsed);
+}
+
+std::vector<Job> ReadManifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot open manifest " + path);
+
+    std::vector<Job> jobs;
+    std::string text;
+    for (int line = 1; std::getline(in, text); ++line) {
+        std::istringstream fields(text);
+        std::string field;
+        Job job;
+        job.line = line;
+        bool any = false;
+        while (fields >> field) {
+            if (field[0] == '#') break;
+            const size_t eq = field.find('=');
+            if (eq == std::string::npos)
+                throw std::invalid_argument("line " + std::to_string(line) + ": expected key=value, got '" + field + "'");
+            const std::string key = field.substr(0, eq);
+            const std::string value = field.substr(eq + 1);
+            any = true;
+            if (key == "video") job.video = value;
+            else if (key == "audio") job.audio = value;
+            else if (key == "output") job.output = value;
+            else if (key == "format") job.format = value;
+            else if (key == "vcodec") job.videoCodec = value;
+            else if (key == "acodec") job.audioCodec = value;
+            else if (key == "vbitrate") job.videoBitrate = ParseInt(value, key, line);
+            else if (key == "abitrate") job.audioBitrate = ParseInt(value, key, line);
+            else if (key == "threads") job.threads = ParseInt(value, key, line);
+            else throw std::invalid_argument("line " + std::to_string(line) + ": unknown key '" + key + "'");
+        }
+        if (!any) continue;
+        if (job.output.empty()) throw std::invalid_argument("line " + std::to_string(line) + ": output is required");
+        if (job.video.empty() && job.audio.empty())
+            throw std::invalid_argument("line " + std::to_string(line) + ": video or audio input is required");
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+// Packed-to-encoder sample format conversion at an unchanged rate, so one
+// input frame always yields one output frame of the same length.
+class SampleConverter {
+public:
+    SampleConverter(int sampleRate, int channels, AVSampleFormat from, AVSampleFormat to, int samples)
+        : m_frame(sampleRate, channels, to, samples)
+    {
+        AVChannelLayout layout;
+        av_channel_layout_default(&layout, channels);
+        int ret = swr_alloc_set_opts2(&m_swr, &layout, to, sampleRate, &layout, from, sampleRate, 0, nullptr);
+        av_channel_layout_uninit(&layout);
+        if (ret < 0 || swr_init(m_swr) < 0) {
+            swr_free(&m_swr);
+            throw std::runtime_error("Failed to set up sample format conversion");
+        }
+    }
+
+    ~SampleConverter() { swr_free(&m_swr); }
+
+    AudioFrame* Convert(const AudioFrame& input) {
+        // The encoder may still reference the previous output; write into a fresh buffer then.
+        m_frame.MakeWritable();
+        AVFrame* src = input.NativePointer();
+        AVFrame* dst = m_frame.NativePointer();
+        if (swr_convert(m_swr, dst->extended_data, src->nb_samples,
+                        const_cast<const uint8_t**>(src->extended_data), src->nb_samples) != src->nb_samples) {
+            throw std::runtime_error("Sample format conversion failed");
+        }
+        dst->nb_samples = src->nb_samples;
+        return &m_frame;
+    }
+
+private:
+    SwrContext* m_swr = nullptr;
+    AudioFrame m_frame;
+};
+
+void RunJob(const Job& job, int defaultThreads, JobResult& result) {
+    std::unique_ptr<Y4MReader> video;
+    std::unique_ptr<WavReader> audio;
+    if (!job.video.empty()) video = std::make_unique<Y4MReader>(job.video);
+    if (!job.audio.empty()) audio = std::make_unique<WavReader>(job.audio);
+
+    const AVRational rate = video ? video->FrameRate() : AVRational{25, 1};
+    MediaWriter writer(video ? video->Width() : 0, video ? video->Height() : 0, rate.num, rate.den,
+                       video ? job.videoCodec : "", job.videoBitrate,
+                       audio ? job.audioCodec : "", job.audioBitrate);
+    if (audio) writer.SetAudioParameters(audio->SampleRate(), audio->Channels());
+    const int threads = job.threads >= 0 ? job.threads : defaultThreads;
+    if (threads >= 0) writer.SetEncoderThreads(threads);
+
+    writer.Open(job.output, job.format);
+    writer.StartAsync(16);
+
+    // Conversions only when the input does not already match the encoder.
+    std::unique_ptr<Scaler> scaler;
+    std::unique_ptr<VideoFrame> scaled;
+    if (video && video->PixelFormat() != writer.GetVideoPixelFormat()) {
+        scaler = std::make_unique<Scaler>();
+        scaled = std::make_unique<VideoFrame>(video->Width(), video->Height(), writer.GetVideoPixelFormat());
+    }
+    std::unique_ptr<SampleConverter> converter;
+    if (audio) {
+        const int frameSize = writer.GetAudioFrameSize() > 0 ? writer.GetAudioFrameSize() : 1024;
+        audio->SetSamplesPerFrame(frameSize);
+        if (audio->SampleFormat() != writer.GetAudioSampleFormat()) {
+            converter = std::make_unique<SampleConverter>(audio->SampleRate(), audio->Channels(),
+                                                          audio->SampleFormat(), writer.GetAudioSampleFormat(), frameSize);
+        }
+    }
+
+    const auto start = Clock::now();
+    bool videoDone = !video;
+    bool audioDone = !audio;
+    std::shared_ptr<VideoFrame> videoFrame;
+    std::shared_ptr<AudioFrame> audioFrame;
+
+    // Feed whichever stream is behind so the muxer's interleaving buffer stays small.
+    while (!videoDone || !audioDone) {
+        const double videoTime = video ? static_cast<double>(video->FramesRead()) * rate.den / rate.num : 0;
+        const double audioTime = audio ? static_cast<double>(audio->SamplesRead()) / audio->SampleRate() : 0;
+
+        if (!videoDone && (audioDone || videoTime <= audioTime)) {
+            if (!video->ReadFrame(videoFrame)) {
+                videoDone = true;
+                continue;
+            }
+            VideoFrame* input = videoFrame.get();
+            if (scaler) {
+                scaled->MakeWritable();
+                AVFrame* src = videoFrame->NativePointer();
+                AVFrame* dst = scaled->NativePointer();
+                if (!scaler->Convert(src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                                     dst->width, dst->height, static_cast<AVPixelFormat>(dst->format),
+                                     src->data, src->linesize, dst->data, dst->linesize)) {
+                    throw std::runtime_error("Pixel format conversion failed");
+                }
+                input = scaled.get();
+            }
+            writer.EncodeVideoFrame(input);
+            result.videoFrames.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            if (!audio->ReadFrame(audioFrame)) {
+                audioDone = true;
+                continue;
+            }
+            writer.EncodeAudioFrame(converter ? converter->Convert(*audioFrame) : audioFrame.get());
+            result.audioFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    writer.Close();
+    result.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double videoSeconds = video ? static_cast<double>(video->FramesRead()) * rate.den / rate.num : 0;
+    const double audioSeconds = audio ? static_cast<double>(audio->SamplesRead()) / audio->SampleRate() : 0;
+    result.mediaSeconds = std::max(videoSeconds, audioSeconds);
+}
+
+void PrintUsage() {
+    std::fprintf(stderr,
+                 "usage: mediaencoder-cli [-j jobs] [-t encoder-threads] manifest\n"
+                 "  -j  jobs run at once (default: number of cores)\n"
+                 "  -t  codec threads per job, 0 = codec decides (default: cores / jobs)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    int jobCount = 0;
+    int encoderThreads = -1;
+    std::string manifest;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "-j" || arg == "-t") && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 0 || (arg == "-j" && value == 0)) {
+                PrintUsage();
+                return 2;
+            }
+            if (arg == "-j") jobCount = value;
+            else encoderThreads = value;
+        } else if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        } else if (manifest.empty() && arg[0] != '-') {
+            manifest = arg;
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (manifest.empty()) {
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    try {
+        jobs = ReadManifest(manifest);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s: %s\n", manifest.c_str(), e.what());
+        return 2;
+    }
+    if (jobs.empty()) return 0;
+
+    if (jobCount == 0) jobCount = cores;
+    jobCount = std::min<int>(jobCount, static_cast<int>(jobs.size()));
+    // Split the cores between concurrent jobs rather than oversubscribing them.
+    if (encoderThreads < 0) encoderThreads = std::max(1, cores / jobCount);
+
+    std::vector<std::unique_ptr<JobResult>> results;
+    for (size_t i = 0; i < jobs.size(); ++i) results.push_back(std::make_unique<JobResult>());
+
+    std::atomic<size_t> nextJob{0};
+    std::atomic<size_t> finished{0};
+    std::mutex doneMutex;
+    std::condition_variable doneCv;
+    const auto start = Clock::now();
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < jobCount; ++w) {
+        workers.emplace_back([&] {
+            while (true) {
+                const size_t i = nextJob.fetch_add(1);
+                if (i >= jobs.size()) break;
+                JobResult& result = *results[i];
+                try {
+                    RunJob(jobs[i], encoderThreads, result);
+                } catch (const std::exception& e) {
+                    result.error = e.what();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    ++finished;
+                }
+                doneCv.notify_all();
+            }
+        });
+    }
+
+    // Progress once a second on stderr; results are printed to stdout at the end.
+    uint64_t lastFrames = 0;
+    auto lastTime = start;
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        while (finished < jobs.size()) {
+            doneCv.wait_for(lock, std::chrono::seconds(1));
+            uint64_t frames = 0;
+            for (const auto& result : results) frames += result->videoFrames.load(std::memory_order_relaxed);
+            const auto now = Clock::now();
+            const double interval = std::chrono::duration<double>(now - lastTime).count();
+            if (interval < 0.5 && finished < jobs.size()) continue;
+            std::fprintf(stderr, "\r[%zu/%zu jobs] %llu frames, %.1f fps   ", finished.load(), jobs.size(),
+                         static_cast<unsigned long long>(frames), interval > 0 ? (frames - lastFrames) / interval : 0.0);
+            lastFrames = frames;
+            lastTime = now;
+        }
+    }
+    std::fprintf(stderr, "\n");
+    for (auto& worker : workers) worker.join();
+    const double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+    int failures = 0;
+    uint64_t totalFrames = 0;
+    double totalMedia = 0;
+    std::printf("%-40s %10s %10s %10s %10s\n", "output", "frames", "seconds", "fps", "realtime");
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const JobResult& result = *results[i];
+        if (!result.error.empty()) {
+            ++failures;
+            std::printf("%-40s FAILED (manifest line %d): %s\n", jobs[i].output.c_str(), jobs[i].line, result.error.c_str());
+            continue;
+        }
+        const uint64_t frames = result.videoFrames.load();
+        const double seconds = result.wallSeconds > 0 ? result.wallSeconds : 1e-9;
+        totalFrames += frames;
+        totalMedia += result.mediaSeconds;
+        std::printf("%-40s %10llu %10.2f %10.1f %9.2fx\n", jobs[i].output.c_str(),
+                    static_cast<unsigned long long>(frames), result.wallSeconds,
+                    frames / seconds, result.mediaSeconds / seconds);
+    }
+    std::printf("total: %zu jobs (%d failed), %d at a time, %d encoder threads each: "
+                "%llu frames in %.2f s, %.1f fps, %.2fx realtime\n",
+                jobs.size(), failures, jobCount, encoderThreads, static_cast<unsigned long long>(totalFrames),
+                wall, totalFrames / wall, totalMedia / wall);
+    return failures ? 1 : 0;
+}